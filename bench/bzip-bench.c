@@ -0,0 +1,186 @@
+/* decodes every bzip2 stream in the bundled archives and reports throughput.
+ *
+ * build with `make bzip-bench` and run from the repository root, or pass the
+ * archives to decode: ./bzip-bench [-n rounds] [archive.jag ...] */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/lib/bzip.h"
+
+#define BENCH_ROUNDS 10
+
+static const char *default_archives[] = {
+    "cache/config85.jag", "cache/entity24.jag",  "cache/entity24.mem",
+    "cache/entity8.jag",  "cache/filter2.jag",   "cache/jagex.jag",
+    "cache/land63.jag",   "cache/land63.mem",    "cache/maps63.jag",
+    "cache/maps63.mem",   "cache/media58.jag",   "cache/models36.jag",
+    "cache/sounds1.mem",  "cache/textures17.jag", NULL};
+
+typedef struct BzipStream {
+    int8_t *packed;
+    int packed_size;
+    int size;
+} BzipStream;
+
+static BzipStream *streams = NULL;
+static int stream_count = 0;
+static int stream_capacity = 0;
+
+static int read_u24(uint8_t *data) {
+    return (data[0] << 16) | (data[1] << 8) | data[2];
+}
+
+static void add_stream(int8_t *packed, int packed_size, int size) {
+    if (stream_count == stream_capacity) {
+        stream_capacity = stream_capacity ? stream_capacity * 2 : 64;
+        streams = realloc(streams, stream_capacity * sizeof(BzipStream));
+    }
+
+    streams[stream_count].packed = packed;
+    streams[stream_count].packed_size = packed_size;
+    streams[stream_count].size = size;
+    stream_count++;
+}
+
+static int8_t *read_file(const char *path, long *length) {
+    FILE *file = fopen(path, "rb");
+
+    if (!file) {
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    *length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    int8_t *data = malloc(*length);
+
+    if (fread(data, 1, *length, file) != (size_t)*length) {
+        free(data);
+        data = NULL;
+    }
+
+    fclose(file);
+
+    return data;
+}
+
+/* the layout is the same one unpack_data walks: a 6 byte header with the
+ * unpacked and packed sizes, then either one stream for the whole archive or
+ * a table of entries that may each be a stream of their own */
+static void add_archive(const char *path) {
+    long length = 0;
+    int8_t *file = read_file(path, &length);
+
+    if (!file || length < 6) {
+        fprintf(stderr, "skipping %s\n", path);
+        free(file);
+        return;
+    }
+
+    uint8_t *header = (uint8_t *)file;
+    int archive_size = read_u24(header);
+    int archive_size_packed = read_u24(header + 3);
+    int8_t *archive = file + 6;
+
+    if (archive_size != archive_size_packed) {
+        add_stream(archive, archive_size_packed, archive_size);
+
+        archive = malloc(archive_size);
+        bzip_decompress(archive, file, archive_size_packed, 6);
+    }
+
+    uint8_t *table = (uint8_t *)archive;
+    int entry_count = (table[0] << 8) | table[1];
+    int offset = 2 + entry_count * 10;
+
+    for (int i = 0; i < entry_count; i++) {
+        uint8_t *entry = table + 2 + i * 10;
+        int size = read_u24(entry + 4);
+        int packed_size = read_u24(entry + 7);
+
+        if (size != packed_size) {
+            add_stream(archive + offset, packed_size, size);
+        }
+
+        offset += packed_size;
+    }
+
+    printf("%-24s %8ld bytes, %4d entries\n", path, length, entry_count);
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+    int rounds = BENCH_ROUNDS;
+    int arg = 1;
+
+    if (argc > 2 && strcmp(argv[1], "-n") == 0) {
+        rounds = atoi(argv[2]);
+        arg = 3;
+    }
+
+    if (arg < argc) {
+        for (; arg < argc; arg++) {
+            add_archive(argv[arg]);
+        }
+    } else {
+        for (int i = 0; default_archives[i] != NULL; i++) {
+            add_archive(default_archives[i]);
+        }
+    }
+
+    if (stream_count == 0) {
+        fprintf(stderr, "no bzip2 streams found\n");
+        return 1;
+    }
+
+    int max_size = 0;
+    long total_packed = 0;
+    long total_size = 0;
+
+    for (int i = 0; i < stream_count; i++) {
+        if (streams[i].size > max_size) {
+            max_size = streams[i].size;
+        }
+
+        total_packed += streams[i].packed_size;
+        total_size += streams[i].size;
+    }
+
+    int8_t *output = malloc(max_size);
+    double best = 0;
+
+    for (int round = 0; round < rounds; round++) {
+        double start = now();
+
+        for (int i = 0; i < stream_count; i++) {
+            bzip_decompress(output, streams[i].packed, streams[i].packed_size,
+                            0);
+        }
+
+        double elapsed = now() - start;
+
+        if (round == 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+
+    printf("%d streams, %ld bytes packed, %ld bytes unpacked\n", stream_count,
+           total_packed, total_size);
+
+    printf("best of %d: %.2f ms, %.2f MB/s\n", rounds, best * 1000,
+           total_size / best / (1024 * 1024));
+
+    free(output);
+
+    return 0;
+}
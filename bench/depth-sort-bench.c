@@ -0,0 +1,148 @@
+/* compares the scene's polygon depth sort against the qsort it replaced.
+ *
+ * build with `make depth-sort-bench`. each frame stands in for a camera
+ * position: zoomed in views see fewer polygons over a shallow depth range,
+ * zoomed out views (e.g. Varrock or Falador squares) see thousands spread
+ * over the whole view distance, with models adding runs of similar depths */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/polygon.h"
+
+#define BENCH_FRAMES 64
+#define BENCH_ROUNDS 20
+
+static int qsort_depth_compare(const void *a, const void *b) {
+    GamePolygon *polygon_a = (*(GamePolygon **)a);
+    GamePolygon *polygon_b = (*(GamePolygon **)b);
+
+    if (polygon_a->depth == 0) {
+        return -1;
+    }
+
+    if (polygon_a->depth == polygon_b->depth) {
+        return 0;
+    }
+
+    return polygon_a->depth < polygon_b->depth ? 1 : -1;
+}
+
+typedef struct BenchFrame {
+    int count;
+    int16_t *depths;
+} BenchFrame;
+
+static void bench_frame_new(BenchFrame *frame, int zoom) {
+    frame->count = 500 + zoom * 6 + rand() % 1000;
+    frame->depths = malloc(frame->count * sizeof(int16_t));
+
+    int near = zoom / 2;
+    int far = zoom * 3;
+    int i = 0;
+
+    while (i < frame->count) {
+        if (rand() % 4 == 0) {
+            /* a model: a run of faces around the same depth */
+            int centre = near + rand() % (far - near);
+            int faces = 20 + rand() % 180;
+
+            for (int j = 0; j < faces && i < frame->count; j++) {
+                frame->depths[i++] = centre + rand() % 64 - 32;
+            }
+        } else {
+            /* terrain */
+            frame->depths[i++] = near + rand() % (far - near);
+        }
+    }
+}
+
+static void bench_frame_load(BenchFrame *frame, GamePolygon *polygons,
+                             GamePolygon **visible) {
+    for (int i = 0; i < frame->count; i++) {
+        polygons[i].depth = frame->depths[i];
+        visible[i] = &polygons[i];
+    }
+}
+
+static int bench_is_sorted(GamePolygon **visible, int count) {
+    for (int i = 1; i < count; i++) {
+        if (visible[i - 1]->depth < visible[i]->depth) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+
+    BenchFrame frames[BENCH_FRAMES];
+    int max_count = 0;
+    long total_count = 0;
+
+    srand(2003);
+
+    for (int i = 0; i < BENCH_FRAMES; i++) {
+        bench_frame_new(&frames[i], 550 + (i * 700) / BENCH_FRAMES);
+
+        if (frames[i].count > max_count) {
+            max_count = frames[i].count;
+        }
+
+        total_count += frames[i].count;
+    }
+
+    GamePolygon *polygons = calloc(max_count, sizeof(GamePolygon));
+    GamePolygon **visible = calloc(max_count, sizeof(GamePolygon *));
+    GamePolygon **scratch = calloc(max_count, sizeof(GamePolygon *));
+    uint32_t *keys = calloc(max_count * 2, sizeof(uint32_t));
+
+    double qsort_time = 0;
+    double radix_time = 0;
+
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        for (int i = 0; i < BENCH_FRAMES; i++) {
+            BenchFrame *frame = &frames[i];
+
+            bench_frame_load(frame, polygons, visible);
+
+            double start = now();
+            qsort(visible, frame->count, sizeof(GamePolygon *),
+                  qsort_depth_compare);
+            qsort_time += now() - start;
+
+            bench_frame_load(frame, polygons, visible);
+
+            start = now();
+            polygon_depth_sort(visible, frame->count, keys, scratch);
+            radix_time += now() - start;
+
+            if (!bench_is_sorted(visible, frame->count)) {
+                fprintf(stderr, "frame %d not sorted\n", i);
+                return 1;
+            }
+        }
+    }
+
+    int frame_count = BENCH_FRAMES * BENCH_ROUNDS;
+
+    printf("%d frames, %ld polygons per frame on average\n", BENCH_FRAMES,
+           total_count / BENCH_FRAMES);
+
+    printf("qsort: %.1f us per frame\n", qsort_time * 1e6 / frame_count);
+    printf("radix: %.1f us per frame\n", radix_time * 1e6 / frame_count);
+
+    return 0;
+}
@@ -0,0 +1,197 @@
+/* plays a packet capture back through the client with no window and reports
+ * how long each part of the frame takes.
+ *
+ * build with `make replay-bench` and record a capture by setting
+ * record_packets = 1 in options.ini before logging in. every frame runs one
+ * game tick, which handles the packets recorded on that tick, and the camera
+ * follows a fixed script, so the same capture always draws the same frames.
+ *
+ * usage: replay-bench capture.bin [frames]
+ *
+ * without frames the replay stops when the capture runs out, otherwise it
+ * keeps drawing the last state until that many frames have been drawn */
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../src/mudclient.h"
+
+/* frames for the camera to turn all the way around */
+#define BENCH_ROTATION_FRAMES 128
+
+/* frames to zoom from indoors to all the way out and back */
+#define BENCH_ZOOM_FRAMES 512
+
+static void bench_move_camera(mudclient *mud, int frame) {
+    mud->settings_camera_auto = 0;
+    mud->camera_rotation = (frame * 256 / BENCH_ROTATION_FRAMES) & 0xff;
+
+    int zoom_range = ZOOM_MAX - ZOOM_INDOORS;
+    int step = frame % BENCH_ZOOM_FRAMES;
+
+    if (step >= BENCH_ZOOM_FRAMES / 2) {
+        step = BENCH_ZOOM_FRAMES - step;
+    }
+
+    mud->camera_zoom =
+        ZOOM_INDOORS + (zoom_range * step) / (BENCH_ZOOM_FRAMES / 2);
+}
+
+/* scene statistics added up over every frame */
+typedef struct BenchSceneTotals {
+    int64_t models_tested;
+    int64_t models_culled;
+    int64_t models_projected;
+    int64_t cells_culled;
+    int64_t models_lit;
+    int64_t textures_hit;
+    int64_t textures_missed;
+    int64_t textures_evicted;
+} BenchSceneTotals;
+
+static void bench_add_scene_stats(BenchSceneTotals *totals,
+                                  SceneStats *stats) {
+    totals->models_tested += stats->models_tested;
+    totals->models_culled += stats->models_culled;
+    totals->models_projected += stats->models_projected;
+    totals->cells_culled += stats->cells_culled;
+    totals->models_lit += stats->models_lit;
+    totals->textures_hit += stats->textures_hit;
+    totals->textures_missed += stats->textures_missed;
+    totals->textures_evicted += stats->textures_evicted;
+}
+
+static int bench_replaying(mudclient *mud) {
+    PacketStream *packet_stream = mud->packet_stream;
+
+    return packet_stream->replay_offset < packet_stream->replay_length;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s capture.bin [frames]\n", argv[0]);
+        return 1;
+    }
+
+    int max_frames = argc > 2 ? atoi(argv[2]) : 0;
+
+    srand(0);
+
+    init_utility_global();
+    init_surface_global();
+    init_scanline_global();
+    init_world_global();
+    init_stats_tab_global();
+
+    mudclient *mud = malloc(sizeof(mudclient));
+    mudclient_new(mud);
+
+    /* handle all the packets of a tick however long they take, so they
+     * apply on the same tick as when they were recorded */
+    mud->options->packet_batch_ms = INT_MAX;
+    mud->options->network_thread = 0;
+    mud->options->record_packets = 0;
+    mud->options->zoom_camera = 1;
+
+    mudclient_start_application(mud, "replay-bench");
+    mudclient_start_application_common(mud);
+
+    /* what mudclient_run does before its first frame */
+    mudclient_queue_data_files(mud);
+    mudclient_load_jagex(mud);
+    mudclient_start_game(mud);
+    mudclient_free_data_files(mud);
+    mud->loading_step = 0;
+
+    if (mud->error_loading_data) {
+        fprintf(stderr, "unable to load the game data\n");
+        return 1;
+    }
+
+    free(mud->packet_stream);
+    mud->packet_stream = malloc(sizeof(PacketStream));
+
+    if (!packet_stream_new_replay(mud->packet_stream, argv[1])) {
+        return 1;
+    }
+
+    mudclient_reset_game(mud);
+
+    int64_t totals[PROFILE_SCOPE_COUNT] = {0};
+    BenchSceneTotals scene_totals = {0};
+    int64_t packets = 0;
+    int frames = 0;
+
+    /* scopes are only timed from the frame after the overlay is turned on */
+    profiler_end_frame(1);
+
+    int64_t start = get_ticks_us();
+
+    while (max_frames > 0 ? frames < max_frames : bench_replaying(mud)) {
+        mudclient_handle_inputs(mud);
+
+        /* after the game has had a chance to move the camera itself */
+        bench_move_camera(mud, frames);
+
+        mudclient_draw(mud);
+
+        profiler_end_frame(1);
+
+        int index = (profiler.frame_index + PROFILER_FRAMES - 1) %
+                    PROFILER_FRAMES;
+
+        for (int i = 0; i < PROFILE_SCOPE_COUNT; i++) {
+            totals[i] += profiler.history[index][i];
+        }
+
+        bench_add_scene_stats(&scene_totals, &mud->scene->stats);
+
+        packets += mud->packets_per_frame;
+        frames++;
+
+        if (!mud->logged_in) {
+            /* the capture ended with a logout */
+            break;
+        }
+    }
+
+    double elapsed = (get_ticks_us() - start) / 1e6;
+
+    if (frames == 0) {
+        fprintf(stderr, "no frames drawn\n");
+        return 1;
+    }
+
+    printf("%d frames, %lld packets in %.2f s, %.1f frames/s\n", frames,
+           (long long)packets, elapsed, frames / elapsed);
+
+    for (int i = 0; i < PROFILE_SCOPE_COUNT; i++) {
+        double per_frame = totals[i] / (double)frames / 1000.0;
+
+        printf("  %-14s %8.3f ms/frame %6.1f%%\n", profile_scope_names[i],
+               per_frame,
+               totals[PROFILE_FRAME] > 0
+                   ? (totals[i] * 100.0) / totals[PROFILE_FRAME]
+                   : 0);
+    }
+
+    printf("  models %.1f tested, %.1f culled, %.1f projected per frame\n",
+           scene_totals.models_tested / (double)frames,
+           scene_totals.models_culled / (double)frames,
+           scene_totals.models_projected / (double)frames);
+
+    printf("  cells  %.1f culled per frame\n",
+           scene_totals.cells_culled / (double)frames);
+
+    printf("  models %.1f lit per frame\n",
+           scene_totals.models_lit / (double)frames);
+
+    printf("  textures %lld hit, %lld missed, %lld evicted\n",
+           (long long)scene_totals.textures_hit,
+           (long long)scene_totals.textures_missed,
+           (long long)scene_totals.textures_evicted);
+
+    return 0;
+}
@@ -0,0 +1,240 @@
+/* compares the simd scanline kernels against the scalar ones.
+ *
+ * build with `make scanline-bench`. every kernel set this cpu supports draws
+ * the same random spans as the scalar kernels; the output has to match
+ * exactly, then each kernel is timed on its own in pixels per second */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/scanline.h"
+
+#define BENCH_SPANS 4096
+#define BENCH_ROUNDS 50
+#define BENCH_WIDTH 512
+
+/* textures keep 4 brightness levels after each other */
+#define BENCH_TEXTURE64_LENGTH (64 * 64 * 4)
+#define BENCH_TEXTURE128_LENGTH (128 * 128 * 4)
+
+typedef enum {
+    BENCH_TEXTURE128 = 0,
+    BENCH_TEXTURE128_ALPHAKEY = 1,
+    BENCH_TEXTURE64 = 2,
+    BENCH_TEXTURE64_ALPHAKEY = 3,
+    BENCH_COLOUR_TRANSLUCENT = 4,
+    BENCH_COLOUR = 5
+} BENCH_KERNEL;
+
+#define BENCH_KERNEL_COUNT 6
+
+static const char *kernel_names[BENCH_KERNEL_COUNT] = {
+    "texture128",         "texture128_alphakey", "texture64",
+    "texture64_alphakey", "colour_translucent",  "colour"};
+
+/* arguments for one call, in the order the kernel takes them */
+typedef struct BenchSpan {
+    int x;
+    int length;
+    int args[9];
+} BenchSpan;
+
+static int32_t texture64[BENCH_TEXTURE64_LENGTH];
+static int32_t texture128[BENCH_TEXTURE128_LENGTH];
+static int32_t ramp[RAMP_SIZE];
+
+static BenchSpan spans[BENCH_KERNEL_COUNT][BENCH_SPANS];
+
+/* one row per span, with a pixel spare for the translucent kernel to read */
+static int32_t background[BENCH_SPANS][BENCH_WIDTH + 1];
+static int32_t expected[BENCH_SPANS][BENCH_WIDTH + 1];
+static int32_t raster[BENCH_SPANS][BENCH_WIDTH + 1];
+
+static int random_range(int min, int max) {
+    return min + rand() % (max - min + 1);
+}
+
+static void bench_textures_new(void) {
+    for (int i = 0; i < BENCH_TEXTURE64_LENGTH; i++) {
+        texture64[i] = rand() % 6 == 0 ? 0 : (rand() & 0xf8f8ff) | 1;
+    }
+
+    for (int i = 0; i < BENCH_TEXTURE128_LENGTH; i++) {
+        texture128[i] = rand() % 6 == 0 ? 0 : (rand() & 0xf8f8ff) | 1;
+    }
+
+    for (int i = 0; i < RAMP_SIZE; i++) {
+        ramp[i] = rand() & 0xffffff;
+    }
+}
+
+/* perspective texture coordinates are passed as numerators over a shared
+ * divisor, each stepped once every 16 pixels like the scene does */
+static void bench_texture_span(BenchSpan *span, int texture_size,
+                               int brightness_bits, int alphakey) {
+    int divisor = random_range(1 << 14, 1 << 16);
+    int blocks = span->length / 16 + 1;
+
+    int u_start = random_range(0, texture_size - 1);
+    int v_start = random_range(0, texture_size * 4);
+    int u_end = random_range(0, texture_size - 1);
+    int v_end = random_range(0, texture_size * 4);
+
+    int u = u_start * divisor;
+    int v = v_start * divisor;
+    int u_step = ((u_end - u_start) * divisor) / blocks;
+    int v_step = ((v_end - v_start) * divisor) / blocks;
+    int divisor_step = random_range(-16, 16);
+
+    /* brightness drifts by up to one of the 4 levels along the span */
+    int brightness = random_range(1, 2) << brightness_bits;
+    int brightness_step =
+        random_range(-(1 << brightness_bits), 1 << brightness_bits) /
+        (span->length * 4 + 4);
+
+    /* the opaque kernels step brightness once per 4 pixels, the alphakey
+     * ones multiply it by 4 themselves */
+    if (!alphakey) {
+        brightness_step *= 4;
+    }
+
+    int args[] = {u,           v,            divisor,    u_step,         v_step,
+                  divisor_step, span->length, brightness, brightness_step};
+
+    memcpy(span->args, args, sizeof(args));
+}
+
+static void bench_spans_new(void) {
+    for (int kernel = 0; kernel < BENCH_KERNEL_COUNT; kernel++) {
+        for (int i = 0; i < BENCH_SPANS; i++) {
+            BenchSpan *span = &spans[kernel][i];
+
+            span->length = random_range(1, 200);
+            span->x = random_range(0, BENCH_WIDTH - span->length);
+
+            switch (kernel) {
+            case BENCH_TEXTURE128:
+            case BENCH_TEXTURE128_ALPHAKEY:
+                bench_texture_span(span, 128, 23,
+                                   kernel == BENCH_TEXTURE128_ALPHAKEY);
+                break;
+            case BENCH_TEXTURE64:
+            case BENCH_TEXTURE64_ALPHAKEY:
+                bench_texture_span(span, 64, 20,
+                                   kernel == BENCH_TEXTURE64_ALPHAKEY);
+                break;
+            default:
+                span->args[0] = -span->length;
+                span->args[1] = random_range(0, 255 * RAMP_SIZE);
+                span->args[2] =
+                    random_range(-RAMP_SIZE * 8, RAMP_SIZE * 8) /
+                    (span->length + 1);
+                break;
+            }
+        }
+    }
+}
+
+static void bench_draw(ScanlineKernels *kernels, BENCH_KERNEL kernel) {
+    for (int i = 0; i < BENCH_SPANS; i++) {
+        BenchSpan *span = &spans[kernel][i];
+        int32_t *row = raster[i] + span->x;
+        int *a = span->args;
+
+        switch (kernel) {
+        case BENCH_TEXTURE128:
+            kernels->texture128(row, texture128, a[0], a[1], a[2], a[3], a[4],
+                                a[5], a[6], a[7], a[8]);
+            break;
+        case BENCH_TEXTURE128_ALPHAKEY:
+            kernels->texture128_alphakey(row, texture128, a[0], a[1], a[2],
+                                         a[3], a[4], a[5], a[6], a[7], a[8]);
+            break;
+        case BENCH_TEXTURE64:
+            kernels->texture64(row, texture64, a[0], a[1], a[2], a[3], a[4],
+                               a[5], a[6], a[7], a[8]);
+            break;
+        case BENCH_TEXTURE64_ALPHAKEY:
+            kernels->texture64_alphakey(row, texture64, a[0], a[1], a[2], a[3],
+                                        a[4], a[5], a[6], a[7], a[8]);
+            break;
+        case BENCH_COLOUR_TRANSLUCENT:
+            kernels->colour_translucent(row, a[0], ramp, a[1], a[2]);
+            break;
+        case BENCH_COLOUR:
+            kernels->colour(row, a[0], ramp, a[1], a[2]);
+            break;
+        }
+    }
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+
+    srand(2003);
+
+    bench_textures_new();
+    bench_spans_new();
+
+    for (int i = 0; i < BENCH_SPANS; i++) {
+        for (int j = 0; j < BENCH_WIDTH + 1; j++) {
+            background[i][j] = rand() & 0xffffff;
+        }
+    }
+
+    ScanlineKernels scalar = scanline_kernels;
+    int failed = 0;
+
+    for (int type = 0; type < SCANLINE_KERNELS_COUNT; type++) {
+        if (!scanline_set_kernels(type)) {
+            continue;
+        }
+
+        ScanlineKernels kernels = scanline_kernels;
+
+        printf("%s:\n", kernels.name);
+
+        for (int kernel = 0; kernel < BENCH_KERNEL_COUNT; kernel++) {
+            long pixels = 0;
+
+            for (int i = 0; i < BENCH_SPANS; i++) {
+                pixels += spans[kernel][i].length;
+            }
+
+            memcpy(raster, background, sizeof(background));
+            bench_draw(&scalar, kernel);
+            memcpy(expected, raster, sizeof(raster));
+
+            memcpy(raster, background, sizeof(background));
+            bench_draw(&kernels, kernel);
+
+            int mismatch = memcmp(expected, raster, sizeof(raster)) != 0;
+
+            double start = now();
+
+            for (int round = 0; round < BENCH_ROUNDS; round++) {
+                bench_draw(&kernels, kernel);
+            }
+
+            double elapsed = now() - start;
+
+            printf("  %-20s %8.1f Mpixels/s%s\n", kernel_names[kernel],
+                   (pixels * BENCH_ROUNDS) / elapsed / 1e6,
+                   mismatch ? "  MISMATCH" : "");
+
+            failed |= mismatch;
+        }
+    }
+
+    return failed;
+}
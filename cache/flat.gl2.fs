@@ -3,6 +3,7 @@
 varying vec4 vertex_colour;
 varying vec2 vertex_texture_position;
 varying vec2 vertex_base_texture_position;
+varying vec3 vertex_skin_colour;
 
 uniform sampler2D sprite_texture;
 uniform sampler2D sprite_base_texture;
@@ -13,6 +14,13 @@ void main() {
     vec4 base_texture_colour =
         texture2D(sprite_base_texture, vertex_base_texture_position);
 
+    /* half transparent base pixels are skin, tinted like the software
+     * renderer does */
+    if (abs(base_texture_colour.a - 0.5) < 0.25) {
+        base_texture_colour =
+            vec4(base_texture_colour.rgb * vertex_skin_colour, 1.0);
+    }
+
     gl_FragColor = (texture_colour * vertex_colour) + base_texture_colour;
 
     if (gl_FragColor.a <= 0.0) {
@@ -7,6 +7,7 @@ out vec4 fragment_colour;
 in vec4 vertex_colour;
 in vec2 vertex_texture_position;
 in vec2 vertex_base_texture_position;
+in vec3 vertex_skin_colour;
 
 uniform sampler2D sprite_texture;
 uniform sampler2D sprite_base_texture;
@@ -17,6 +18,13 @@ void main() {
     vec4 base_texture_colour =
         texture(sprite_base_texture, vertex_base_texture_position);
 
+    /* half transparent base pixels are skin, tinted like the software
+     * renderer does */
+    if (abs(base_texture_colour.a - 0.5) < 0.25) {
+        base_texture_colour =
+            vec4(base_texture_colour.rgb * vertex_skin_colour, 1.0);
+    }
+
     fragment_colour = (texture_colour * vertex_colour) + base_texture_colour;
 
     if (fragment_colour.w <= 0.0) {
@@ -0,0 +1,508 @@
+#include "archive-loader.h"
+
+static char ARCHIVE_SIDECAR_MAGIC[] = {'R', 'S', 'C', 'U'};
+
+/* only touched from the main thread */
+static ArchiveMapping archive_mappings[ARCHIVE_LOADER_JOBS_MAX] = {0};
+
+#ifdef ARCHIVE_SIDECARS
+static int archive_has_packed_entries(int8_t *archive_data) {
+    int entry_count = get_unsigned_short(archive_data, 0, SIZE_MAX);
+
+    for (int i = 0; i < entry_count; i++) {
+        uint8_t *entry = (uint8_t *)archive_data + 2 + i * 10;
+        uint32_t size = (entry[4] << 16) | (entry[5] << 8) | entry[6];
+        uint32_t packed_size = (entry[7] << 16) | (entry[8] << 8) | entry[9];
+
+        if (size != packed_size) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* rebuild an archive with every entry stored uncompressed, so unpack_data
+ * only has to copy them */
+static int8_t *archive_unpack_entries(int8_t *archive_data, uint32_t *size) {
+    int entry_count = get_unsigned_short(archive_data, 0, SIZE_MAX);
+    uint32_t header_size = 2 + entry_count * 10;
+    uint32_t unpacked_size = header_size;
+
+    for (int i = 0; i < entry_count; i++) {
+        uint8_t *entry = (uint8_t *)archive_data + 2 + i * 10;
+        unpacked_size += (entry[4] << 16) | (entry[5] << 8) | entry[6];
+    }
+
+    int8_t *unpacked = malloc(unpacked_size);
+
+    if (unpacked == NULL) {
+        return NULL;
+    }
+
+    memcpy(unpacked, archive_data, header_size);
+
+    uint32_t offset = header_size;
+    uint32_t unpacked_offset = header_size;
+
+    for (int i = 0; i < entry_count; i++) {
+        uint8_t *entry = (uint8_t *)unpacked + 2 + i * 10;
+        uint32_t entry_size = (entry[4] << 16) | (entry[5] << 8) | entry[6];
+        uint32_t packed_size = (entry[7] << 16) | (entry[8] << 8) | entry[9];
+
+        if (entry_size != packed_size) {
+            bzip_decompress(unpacked + unpacked_offset, archive_data,
+                            packed_size, offset);
+        } else {
+            memcpy(unpacked + unpacked_offset, archive_data + offset,
+                   entry_size);
+        }
+
+        /* stored size now matches the unpacked size */
+        memcpy(entry + 7, entry + 4, 3);
+
+        offset += packed_size;
+        unpacked_offset += entry_size;
+    }
+
+    *size = unpacked_size;
+
+    return unpacked;
+}
+
+static void archive_sidecar_path(const char *file, char *path) {
+    char sidecar_file[PATH_MAX];
+    snprintf(sidecar_file, sizeof(sidecar_file), "%s.unpacked", file);
+    get_cache_path(sidecar_file, path);
+}
+
+/* map a previously unpacked copy of the archive, if it was made from the same
+ * packed file */
+static int8_t *archive_sidecar_map(const char *file, struct stat *source_stat,
+                                   size_t *mapped_length) {
+    char path[PATH_MAX];
+    archive_sidecar_path(file, path);
+
+    FILE *sidecar_stream = fopen(path, "rb");
+
+    if (sidecar_stream == NULL) {
+        return NULL;
+    }
+
+    ArchiveSidecarHeader header = {0};
+    struct stat sidecar_stat = {0};
+
+    if (fread(&header, sizeof(header), 1, sidecar_stream) != 1 ||
+        fstat(fileno(sidecar_stream), &sidecar_stat) != 0 ||
+        memcmp(header.magic, ARCHIVE_SIDECAR_MAGIC, 4) != 0 ||
+        header.version != ARCHIVE_SIDECAR_VERSION ||
+        header.source_size != (uint32_t)source_stat->st_size ||
+        header.source_mtime != (int64_t)source_stat->st_mtime ||
+        (size_t)sidecar_stat.st_size !=
+            ARCHIVE_SIDECAR_ALIGN + (size_t)header.size) {
+        fclose(sidecar_stream);
+        return NULL;
+    }
+
+    size_t length = sidecar_stat.st_size;
+
+    /* private and writable so nothing reading the archive in place has to
+     * care where it came from. pages are only read in when touched */
+    void *base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                      fileno(sidecar_stream), 0);
+
+    fclose(sidecar_stream);
+
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+
+    *mapped_length = length;
+
+    return (int8_t *)base + ARCHIVE_SIDECAR_ALIGN;
+}
+
+static void archive_sidecar_write(const char *file, struct stat *source_stat,
+                                  int8_t *archive_data, uint32_t size) {
+    char path[PATH_MAX];
+    archive_sidecar_path(file, path);
+
+    /* write to a temporary file first so a partial sidecar is never mapped */
+    char temp_path[PATH_MAX + 4];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+
+    FILE *sidecar_stream = fopen(temp_path, "wb");
+
+    if (sidecar_stream == NULL) {
+        return;
+    }
+
+    ArchiveSidecarHeader header = {0};
+    memcpy(header.magic, ARCHIVE_SIDECAR_MAGIC, 4);
+    header.version = ARCHIVE_SIDECAR_VERSION;
+    header.source_size = (uint32_t)source_stat->st_size;
+    header.source_mtime = (int64_t)source_stat->st_mtime;
+    header.size = size;
+
+    uint8_t page[ARCHIVE_SIDECAR_ALIGN] = {0};
+    memcpy(page, &header, sizeof(header));
+
+    int written = fwrite(page, sizeof(page), 1, sidecar_stream) == 1 &&
+                  fwrite(archive_data, size, 1, sidecar_stream) == 1;
+
+    if (fclose(sidecar_stream) != 0 || !written ||
+        rename(temp_path, path) != 0) {
+        mud_error("unable to write unpacked archive %s\n", path);
+        remove(temp_path);
+    }
+}
+#endif
+
+/* read a packed archive, returning its unpacked contents. with use_sidecars
+ * the unpacked data is cached on disk and mapped on later runs instead of
+ * decompressing it again, in which case mapped_length is set */
+int8_t *archive_loader_read(FILE *archive_stream, const char *file,
+                            int use_sidecars, size_t *mapped_length) {
+    *mapped_length = 0;
+
+#ifdef ARCHIVE_SIDECARS
+    struct stat archive_stat = {0};
+
+    /* an unpacked copy of this same file is mapped without reading any of the
+     * packed one */
+    if (use_sidecars) {
+        if (fstat(fileno(archive_stream), &archive_stat) != 0) {
+            use_sidecars = 0;
+        } else {
+            int8_t *mapped =
+                archive_sidecar_map(file, &archive_stat, mapped_length);
+
+            if (mapped != NULL) {
+                return mapped;
+            }
+        }
+    }
+#else
+    (void)file;
+    (void)use_sidecars;
+#endif
+
+    uint8_t header[6];
+
+    if (fread(header, sizeof(header), 1, archive_stream) != 1) {
+        return NULL;
+    }
+
+    int archive_size = (header[0] << 16) + (header[1] << 8) + header[2];
+    int archive_size_compressed =
+        (header[3] << 16) + (header[4] << 8) + header[5];
+
+    int8_t *archive_data = malloc(archive_size_compressed);
+
+    if (archive_data == NULL) {
+        return NULL;
+    }
+
+    if (fread(archive_data, archive_size_compressed, 1, archive_stream) != 1) {
+        free(archive_data);
+        return NULL;
+    }
+
+#ifdef ARCHIVE_SIDECARS
+    /* archives are either compressed as a whole or entry by entry, only the
+     * former is worth an unpacked copy unless sidecars are on */
+    if (archive_size_compressed == archive_size &&
+        (!use_sidecars || !archive_has_packed_entries(archive_data))) {
+        return archive_data;
+    }
+#else
+    if (archive_size_compressed == archive_size) {
+        return archive_data;
+    }
+#endif
+
+    int8_t *decompressed = NULL;
+
+    if (archive_size_compressed != archive_size) {
+        decompressed = malloc(archive_size);
+
+        if (decompressed != NULL) {
+            bzip_decompress(decompressed, archive_data,
+                            archive_size_compressed, 0);
+        }
+
+        free(archive_data);
+    } else {
+        decompressed = archive_data;
+    }
+
+#ifdef ARCHIVE_SIDECARS
+    if (decompressed != NULL && use_sidecars) {
+        uint32_t unpacked_size = archive_size;
+
+        if (archive_has_packed_entries(decompressed)) {
+            int8_t *unpacked =
+                archive_unpack_entries(decompressed, &unpacked_size);
+
+            if (unpacked != NULL) {
+                free(decompressed);
+                decompressed = unpacked;
+            }
+        }
+
+        archive_sidecar_write(file, &archive_stat, decompressed,
+                              unpacked_size);
+    }
+#endif
+
+    return decompressed;
+}
+
+static void archive_loader_track(int8_t *archive_data, size_t mapped_length) {
+    if (archive_data == NULL || mapped_length == 0) {
+        return;
+    }
+
+    for (int i = 0; i < ARCHIVE_LOADER_JOBS_MAX; i++) {
+        if (archive_mappings[i].data == NULL) {
+            archive_mappings[i].data = archive_data;
+            archive_mappings[i].base = archive_data - ARCHIVE_SIDECAR_ALIGN;
+            archive_mappings[i].length = mapped_length;
+            return;
+        }
+    }
+
+    /* can't happen while there are at most as many mappings as jobs, but
+     * leaking the mapping beats freeing it */
+    mud_error("too many mapped archives\n");
+}
+
+/* read an archive on the calling thread, which must be the main one */
+int8_t *archive_loader_load(FILE *archive_stream, const char *file,
+                            int use_sidecars) {
+    size_t mapped_length = 0;
+
+    int8_t *archive_data = archive_loader_read(archive_stream, file,
+                                               use_sidecars, &mapped_length);
+
+    archive_loader_track(archive_data, mapped_length);
+
+    return archive_data;
+}
+
+/* free an archive returned by archive_loader_load or archive_loader_take,
+ * and drop its name index */
+void archive_loader_release(int8_t *archive_data) {
+    if (archive_data == NULL) {
+        return;
+    }
+
+    jag_archive_release(archive_data);
+
+    for (int i = 0; i < ARCHIVE_LOADER_JOBS_MAX; i++) {
+        if (archive_mappings[i].data == archive_data) {
+#ifdef ARCHIVE_SIDECARS
+            munmap(archive_mappings[i].base, archive_mappings[i].length);
+#endif
+            memset(&archive_mappings[i], 0, sizeof(ArchiveMapping));
+            return;
+        }
+    }
+
+    free(archive_data);
+}
+
+#ifdef ARCHIVE_LOADER_THREADED
+static int archive_loader_thread(void *data) {
+    ArchiveLoader *loader = data;
+
+    SDL_LockMutex(loader->lock);
+
+    while (loader->next_job < loader->job_count) {
+        ArchiveLoaderJob *job = &loader->jobs[loader->next_job++];
+        job->state = ARCHIVE_JOB_READING;
+
+        SDL_UnlockMutex(loader->lock);
+
+        size_t mapped_length = 0;
+
+        int8_t *archive_data = archive_loader_read(
+            job->stream, job->file, loader->use_sidecars, &mapped_length);
+
+        fclose(job->stream);
+
+        SDL_LockMutex(loader->lock);
+
+        job->stream = NULL;
+        job->data = archive_data;
+        job->mapped_length = mapped_length;
+        job->state = ARCHIVE_JOB_DONE;
+
+        SDL_CondBroadcast(loader->job_done);
+    }
+
+    SDL_UnlockMutex(loader->lock);
+
+    return 0;
+}
+#endif
+
+void archive_loader_new(ArchiveLoader *loader, int thread_count,
+                        int use_sidecars) {
+    memset(loader, 0, sizeof(ArchiveLoader));
+
+    loader->use_sidecars = use_sidecars;
+
+#ifdef ARCHIVE_LOADER_THREADED
+    if (thread_count > ARCHIVE_LOADER_THREADS_MAX) {
+        thread_count = ARCHIVE_LOADER_THREADS_MAX;
+    }
+
+    loader->thread_count = thread_count;
+    loader->lock = SDL_CreateMutex();
+    loader->job_done = SDL_CreateCond();
+#else
+    (void)thread_count;
+#endif
+}
+
+int archive_loader_add(ArchiveLoader *loader, const char *file,
+                       FILE *archive_stream) {
+    if (loader->job_count >= ARCHIVE_LOADER_JOBS_MAX) {
+        return 0;
+    }
+
+    ArchiveLoaderJob *job = &loader->jobs[loader->job_count++];
+
+    snprintf(job->file, sizeof(job->file), "%s", file);
+    job->stream = archive_stream;
+    job->state = ARCHIVE_JOB_QUEUED;
+
+    return 1;
+}
+
+void archive_loader_start(ArchiveLoader *loader) {
+#ifdef ARCHIVE_LOADER_THREADED
+    int thread_count = loader->thread_count;
+
+    /* only count the threads that actually started, if none did then jobs
+     * are run on the main thread when waited on */
+    loader->thread_count = 0;
+
+    for (int i = 0; i < thread_count; i++) {
+#ifdef SDL12
+        SDL_Thread *thread = SDL_CreateThread(archive_loader_thread, loader);
+#else
+        SDL_Thread *thread =
+            SDL_CreateThread(archive_loader_thread, "archive_loader", loader);
+#endif
+
+        if (thread == NULL) {
+            mud_error("unable to create archive loader thread: %s\n",
+                      SDL_GetError());
+            break;
+        }
+
+        loader->threads[loader->thread_count++] = thread;
+    }
+#else
+    (void)loader;
+#endif
+}
+
+ArchiveLoaderJob *archive_loader_find(ArchiveLoader *loader, const char *file) {
+    for (int i = 0; i < loader->job_count; i++) {
+        if (strcmp(loader->jobs[i].file, file) == 0) {
+            return &loader->jobs[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* wait up to timeout milliseconds for job to finish, returning its state. if
+ * the pool has no threads the job is run here instead */
+ARCHIVE_JOB_STATE archive_loader_wait(ArchiveLoader *loader,
+                                      ArchiveLoaderJob *job, int timeout) {
+#ifdef ARCHIVE_LOADER_THREADED
+    if (loader->thread_count > 0) {
+        SDL_LockMutex(loader->lock);
+
+        if (job->state < ARCHIVE_JOB_DONE) {
+            SDL_CondWaitTimeout(loader->job_done, loader->lock, timeout);
+        }
+
+        ARCHIVE_JOB_STATE state = job->state;
+
+        SDL_UnlockMutex(loader->lock);
+
+        return state;
+    }
+#endif
+
+    (void)timeout;
+
+    if (job->state == ARCHIVE_JOB_QUEUED) {
+        job->data = archive_loader_read(job->stream, job->file,
+                                        loader->use_sidecars,
+                                        &job->mapped_length);
+        fclose(job->stream);
+        job->stream = NULL;
+        job->state = ARCHIVE_JOB_DONE;
+    }
+
+    return job->state;
+}
+
+/* hand ownership of a finished job's data to the caller, to be freed with
+ * archive_loader_release */
+int8_t *archive_loader_take(ArchiveLoader *loader, ArchiveLoaderJob *job) {
+    (void)loader;
+
+    int8_t *archive_data = job->data;
+
+    archive_loader_track(archive_data, job->mapped_length);
+
+    job->data = NULL;
+    job->state = ARCHIVE_JOB_TAKEN;
+
+    return archive_data;
+}
+
+void archive_loader_free(ArchiveLoader *loader) {
+#ifdef ARCHIVE_LOADER_THREADED
+    if (loader->lock != NULL) {
+        /* stop workers picking up anything that wasn't started */
+        SDL_LockMutex(loader->lock);
+        loader->next_job = loader->job_count;
+        SDL_UnlockMutex(loader->lock);
+    }
+
+    for (int i = 0; i < loader->thread_count; i++) {
+        if (loader->threads[i] != NULL) {
+            SDL_WaitThread(loader->threads[i], NULL);
+        }
+    }
+
+    if (loader->job_done != NULL) {
+        SDL_DestroyCond(loader->job_done);
+    }
+
+    if (loader->lock != NULL) {
+        SDL_DestroyMutex(loader->lock);
+    }
+#endif
+
+    for (int i = 0; i < loader->job_count; i++) {
+        ArchiveLoaderJob *job = &loader->jobs[i];
+
+        if (job->stream != NULL) {
+            fclose(job->stream);
+        }
+
+        archive_loader_track(job->data, job->mapped_length);
+        archive_loader_release(job->data);
+    }
+
+    memset(loader, 0, sizeof(ArchiveLoader));
+}
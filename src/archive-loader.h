@@ -0,0 +1,119 @@
+#ifndef _H_ARCHIVE_LOADER
+#define _H_ARCHIVE_LOADER
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(WII) && !defined(_3DS)
+#define ARCHIVE_LOADER_THREADED
+#endif
+
+/* unpacked copies of archives are only written where they can be mapped */
+#if (defined(__unix__) || defined(__unix) ||                                   \
+     (defined(__APPLE__) && defined(__MACH__))) &&                             \
+    !defined(ANDROID) && !defined(EMSCRIPTEN)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define ARCHIVE_SIDECARS
+#endif
+
+/* unpacked archive data starts on its own page so it can be mapped */
+#define ARCHIVE_SIDECAR_ALIGN 4096
+#define ARCHIVE_SIDECAR_VERSION 2
+
+/* max number of archives that can be queued at startup */
+#define ARCHIVE_LOADER_JOBS_MAX 16
+
+/* max number of worker threads */
+#define ARCHIVE_LOADER_THREADS_MAX 8
+
+/* how long the main thread waits between redrawing the loading bar */
+#define ARCHIVE_LOADER_POLL_MS 50
+
+typedef enum {
+    ARCHIVE_JOB_QUEUED = 0,
+    ARCHIVE_JOB_READING = 1,
+    ARCHIVE_JOB_DONE = 2,
+    ARCHIVE_JOB_TAKEN = 3
+} ARCHIVE_JOB_STATE;
+
+/* written at the start of an unpacked archive (sidecar), which is only used
+ * while the packed archive it came from matches source_size and source_mtime,
+ * so a hit never has to read the packed file */
+typedef struct ArchiveSidecarHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t source_size;
+    uint32_t size;
+    int64_t source_mtime;
+} ArchiveSidecarHeader;
+
+/* an unpacked archive mapped from disk, which must be unmapped rather than
+ * freed */
+typedef struct ArchiveMapping {
+    int8_t *data;
+    void *base;
+    size_t length;
+} ArchiveMapping;
+
+typedef struct ArchiveLoaderJob {
+    char file[64];
+
+    /* opened by the main thread so path lookup and errors stay there */
+    FILE *stream;
+
+    int8_t *data;
+
+    /* non-zero if data is mapped from an unpacked archive */
+    size_t mapped_length;
+
+    ARCHIVE_JOB_STATE state;
+} ArchiveLoaderJob;
+
+typedef struct ArchiveLoader ArchiveLoader;
+
+#include "utility.h"
+
+/* reads and decompresses .jag/.mem archives on a small pool of worker threads
+ * so the bzip work for each one overlaps. jobs are started in the order they
+ * were added and the main thread takes the results back in that order */
+struct ArchiveLoader {
+    ArchiveLoaderJob jobs[ARCHIVE_LOADER_JOBS_MAX];
+    int job_count;
+
+    /* index of the next job for a worker to pick up */
+    int next_job;
+
+    int thread_count;
+
+    /* write and map unpacked copies of archives */
+    int use_sidecars;
+
+#ifdef ARCHIVE_LOADER_THREADED
+    SDL_Thread *threads[ARCHIVE_LOADER_THREADS_MAX];
+    SDL_mutex *lock;
+    SDL_cond *job_done;
+#endif
+};
+
+int8_t *archive_loader_read(FILE *archive_stream, const char *file,
+                            int use_sidecars, size_t *mapped_length);
+int8_t *archive_loader_load(FILE *archive_stream, const char *file,
+                            int use_sidecars);
+void archive_loader_release(int8_t *archive_data);
+
+void archive_loader_new(ArchiveLoader *loader, int thread_count,
+                        int use_sidecars);
+int archive_loader_add(ArchiveLoader *loader, const char *file,
+                       FILE *archive_stream);
+void archive_loader_start(ArchiveLoader *loader);
+ArchiveLoaderJob *archive_loader_find(ArchiveLoader *loader, const char *file);
+ARCHIVE_JOB_STATE archive_loader_wait(ArchiveLoader *loader,
+                                      ArchiveLoaderJob *job, int timeout);
+int8_t *archive_loader_take(ArchiveLoader *loader, ArchiveLoaderJob *job);
+void archive_loader_free(ArchiveLoader *loader);
+
+#endif
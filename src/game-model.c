@@ -1,5 +1,12 @@
 #include "game-model.h"
 
+static void game_model_vertex_hash_rebuild(GameModel *game_model);
+
+int game_model_lit_count = 0;
+
+/* used by models lit on the main thread */
+static GameModelLightScratch light_scratch = {0};
+
 #if defined(RENDER_GL) || defined(RENDER_3DS_GL)
 float gl_tri_face_us[] = {0.0f, 1.0f, 0.0f};
 float gl_tri_face_vs[] = {1.0f, 1.0f, 0.0f};
@@ -14,6 +21,7 @@ void game_model_new(GameModel *game_model) {
     game_model->transform_state = GAME_MODEL_TRANSFORM_BEGIN;
     game_model->visible = 1;
     game_model->key = -1;
+    game_model->scene_index = -1;
     game_model->light_ambience = 32; /* 256 is the maximum */
     game_model->light_diffuse = 512;
     game_model->light_direction_x = 180;
@@ -243,6 +251,10 @@ void game_model_projection_prepare(GameModel *game_model) {
 void game_model_clear(GameModel *game_model) {
     game_model->face_count = 0;
     game_model->vertex_count = 0;
+
+    if (game_model->vertex_hash != NULL) {
+        game_model_vertex_hash_rebuild(game_model);
+    }
 }
 
 void game_model_reduce(GameModel *game_model, int delta_faces,
@@ -262,6 +274,10 @@ void game_model_reduce(GameModel *game_model, int delta_faces,
     }
 
     game_model->vertex_count -= delta_vertices;
+
+    if (game_model->vertex_hash != NULL) {
+        game_model_vertex_hash_rebuild(game_model);
+    }
 }
 
 void game_model_merge(GameModel *game_model, GameModel **pieces, int count) {
@@ -315,7 +331,85 @@ void game_model_merge(GameModel *game_model, GameModel **pieces, int count) {
     game_model->transform_state = GAME_MODEL_TRANSFORM_BEGIN;
 }
 
+/* the slot holding the first vertex at (x, y, z), or the empty slot it would
+ * go in. positions are hashed as stored, so out of range coordinates behave
+ * like they do in the linear search */
+static int game_model_vertex_hash_slot(GameModel *game_model, int x, int y,
+                                       int z) {
+    uint32_t hash = ((uint16_t)x * 73856093u) ^ ((uint16_t)y * 19349663u) ^
+                    ((uint16_t)z * 83492791u);
+
+    int slot = (hash ^ (hash >> 16)) & game_model->vertex_hash_mask;
+
+    for (;;) {
+        int index = game_model->vertex_hash[slot] - 1;
+
+        if (index < 0 || (game_model->vertex_x[index] == x &&
+                          game_model->vertex_y[index] == y &&
+                          game_model->vertex_z[index] == z)) {
+            return slot;
+        }
+
+        slot = (slot + 1) & game_model->vertex_hash_mask;
+    }
+}
+
+static void game_model_vertex_hash_add(GameModel *game_model, int index) {
+    int slot = game_model_vertex_hash_slot(
+        game_model, game_model->vertex_x[index], game_model->vertex_y[index],
+        game_model->vertex_z[index]);
+
+    if (game_model->vertex_hash[slot] == 0) {
+        game_model->vertex_hash[slot] = index + 1;
+    }
+}
+
+static void game_model_vertex_hash_rebuild(GameModel *game_model) {
+    memset(game_model->vertex_hash, 0,
+           (game_model->vertex_hash_mask + 1) * sizeof(uint16_t));
+
+    for (int i = 0; i < game_model->vertex_count; i++) {
+        game_model_vertex_hash_add(game_model, i);
+    }
+}
+
+/* index vertices by position until game_model_vertex_hash_end. the table is
+ * at most half full */
+void game_model_vertex_hash_begin(GameModel *game_model) {
+    if (game_model->vertex_hash != NULL || game_model->max_vertices == 0 ||
+        game_model->max_vertices >= UINT16_MAX) {
+        return;
+    }
+
+    int size = 1;
+
+    while (size < game_model->max_vertices * 2) {
+        size <<= 1;
+    }
+
+    game_model->vertex_hash = calloc(size, sizeof(uint16_t));
+    game_model->vertex_hash_mask = size - 1;
+
+    game_model_vertex_hash_rebuild(game_model);
+}
+
+void game_model_vertex_hash_end(GameModel *game_model) {
+    free(game_model->vertex_hash);
+    game_model->vertex_hash = NULL;
+    game_model->vertex_hash_mask = 0;
+}
+
 int game_model_vertex_at(GameModel *game_model, int x, int y, int z) {
+    if (game_model->vertex_hash != NULL) {
+        int slot = game_model_vertex_hash_slot(game_model, x, y, z);
+
+        if (game_model->vertex_hash[slot] != 0) {
+            return game_model->vertex_hash[slot] - 1;
+        }
+
+        return game_model_create_vertex(game_model, x, y, z);
+    }
+
     for (int i = 0; i < game_model->vertex_count; i++) {
         if (game_model->vertex_x[i] == x && game_model->vertex_y[i] == y &&
             game_model->vertex_z[i] == z) {
@@ -335,6 +429,12 @@ int game_model_create_vertex(GameModel *game_model, int x, int y, int z) {
     game_model->vertex_y[game_model->vertex_count] = y;
     game_model->vertex_z[game_model->vertex_count] = z;
 
+    if (game_model->vertex_hash != NULL) {
+        game_model_vertex_hash_add(game_model, game_model->vertex_count);
+    }
+
+    game_model->lit_divisor = 0;
+
     return game_model->vertex_count++;
 }
 
@@ -350,6 +450,7 @@ int game_model_create_face(GameModel *game_model, int number,
     game_model->face_fill_back[game_model->face_count] = fill_back;
 
     game_model->transform_state = GAME_MODEL_TRANSFORM_BEGIN;
+    game_model->lit_divisor = 0;
 
     return game_model->face_count++;
 }
@@ -486,6 +587,8 @@ void game_model_set_light(GameModel *game_model, int gouraud, int ambience,
         game_model->face_intensity[i] = gouraud ? GAME_MODEL_USE_GOURAUD : 0;
     }
 
+    game_model->lit_divisor = 0;
+
     game_model_set_light_intensity(game_model, ambience, diffuse, x, y, z);
 }
 
@@ -701,10 +804,13 @@ void game_model_compute_bounds(GameModel *game_model) {
     }
 }
 
-void game_model_get_face_normals(GameModel *game_model, int16_t *vertex_x,
-                                 int16_t *vertex_y, int16_t *vertex_z,
-                                 int16_t *face_normal_x, int16_t *face_normal_y,
-                                 int16_t *face_normal_z, int reset_scale) {
+/* returns whether any of the face normals changed */
+int game_model_get_face_normals(GameModel *game_model, int16_t *vertex_x,
+                                int16_t *vertex_y, int16_t *vertex_z,
+                                int16_t *face_normal_x, int16_t *face_normal_y,
+                                int16_t *face_normal_z, int reset_scale) {
+    int changed = 0;
+
     for (int i = 0; i < game_model->face_count; i++) {
         uint16_t *face_vertices = game_model->face_vertices[i];
 
@@ -744,14 +850,24 @@ void game_model_get_face_normals(GameModel *game_model, int16_t *vertex_x,
         }
 
         // << 16
-        face_normal_x[i] = (normal_x * 65536) / normal_magnitude;
-        face_normal_y[i] = (normal_y * 65536) / normal_magnitude;
-        face_normal_z[i] = (normal_z * 65535) / normal_magnitude;
+        int16_t face_x = (normal_x * 65536) / normal_magnitude;
+        int16_t face_y = (normal_y * 65536) / normal_magnitude;
+        int16_t face_z = (normal_z * 65535) / normal_magnitude;
+
+        if (face_x != face_normal_x[i] || face_y != face_normal_y[i] ||
+            face_z != face_normal_z[i]) {
+            face_normal_x[i] = face_x;
+            face_normal_y[i] = face_y;
+            face_normal_z[i] = face_z;
+            changed = 1;
+        }
 
         if (reset_scale) {
             game_model->normal_scale[i] = -1;
         }
     }
+
+    return changed;
 }
 
 void game_model_get_vertex_normals(GameModel *game_model,
@@ -775,6 +891,51 @@ void game_model_get_vertex_normals(GameModel *game_model,
     }
 }
 
+static int game_model_light_normals(GameModelLightScratch *scratch,
+                                    int vertex_count) {
+    if (vertex_count > scratch->length) {
+        int length = vertex_count < 1024 ? 1024 : vertex_count;
+
+        game_model_light_scratch_free(scratch);
+
+        scratch->normal_x = malloc(length * sizeof(int16_t));
+        scratch->normal_y = malloc(length * sizeof(int16_t));
+        scratch->normal_z = malloc(length * sizeof(int16_t));
+        scratch->normal_magnitude = malloc(length * sizeof(int32_t));
+
+        scratch->length = length;
+
+        if (scratch->normal_x == NULL || scratch->normal_y == NULL ||
+            scratch->normal_z == NULL || scratch->normal_magnitude == NULL) {
+            scratch->length = 0;
+            return 0;
+        }
+    }
+
+    memset(scratch->normal_x, 0, vertex_count * sizeof(int16_t));
+    memset(scratch->normal_y, 0, vertex_count * sizeof(int16_t));
+    memset(scratch->normal_z, 0, vertex_count * sizeof(int16_t));
+    memset(scratch->normal_magnitude, 0, vertex_count * sizeof(int32_t));
+
+    return 1;
+}
+
+void game_model_light_scratch_free(GameModelLightScratch *scratch) {
+    free(scratch->normal_x);
+    scratch->normal_x = NULL;
+
+    free(scratch->normal_y);
+    scratch->normal_y = NULL;
+
+    free(scratch->normal_z);
+    scratch->normal_z = NULL;
+
+    free(scratch->normal_magnitude);
+    scratch->normal_magnitude = NULL;
+
+    scratch->length = 0;
+}
+
 void game_model_light(GameModel *game_model) {
     if (game_model->unlit) {
         return;
@@ -784,6 +945,15 @@ void game_model_light(GameModel *game_model) {
         (game_model->light_diffuse * game_model->light_direction_magnitude) >>
         8; // >> 8 is / 256
 
+    /* static models keep their intensities until the light changes (or
+     * flickers) */
+    if (divisor == game_model->lit_divisor &&
+        game_model->light_direction_x == game_model->lit_direction_x &&
+        game_model->light_direction_y == game_model->lit_direction_y &&
+        game_model->light_direction_z == game_model->lit_direction_z) {
+        return;
+    }
+
     for (int i = 0; i < game_model->face_count; i++) {
         if (game_model->face_intensity[i] != GAME_MODEL_USE_GOURAUD) {
             game_model->face_intensity[i] =
@@ -794,34 +964,37 @@ void game_model_light(GameModel *game_model) {
         }
     }
 
-    // TODO we could probably re-use a global variable for this instead of
-    // allocating and freeing so many arrays
-    int16_t *normal_x = calloc(game_model->vertex_count, sizeof(int16_t));
-    int16_t *normal_y = calloc(game_model->vertex_count, sizeof(int16_t));
-    int16_t *normal_z = calloc(game_model->vertex_count, sizeof(int16_t));
+    GameModelLightScratch *scratch = game_model->light_scratch != NULL
+                                         ? game_model->light_scratch
+                                         : &light_scratch;
 
-    int32_t *normal_magnitude =
-        calloc(game_model->vertex_count, sizeof(int32_t));
+    if (!game_model_light_normals(scratch, game_model->vertex_count)) {
+        return;
+    }
 
-    game_model_get_vertex_normals(game_model, game_model->face_normal_x,
-                                  game_model->face_normal_y,
-                                  game_model->face_normal_z, normal_x, normal_y,
-                                  normal_z, normal_magnitude);
+    game_model_get_vertex_normals(
+        game_model, game_model->face_normal_x, game_model->face_normal_y,
+        game_model->face_normal_z, scratch->normal_x, scratch->normal_y,
+        scratch->normal_z, scratch->normal_magnitude);
 
     for (int i = 0; i < game_model->vertex_count; i++) {
-        if (normal_magnitude[i] > 0) {
+        if (scratch->normal_magnitude[i] > 0) {
             game_model->vertex_intensity[i] =
-                (normal_x[i] * game_model->light_direction_x +
-                 normal_y[i] * game_model->light_direction_y +
-                 normal_z[i] * game_model->light_direction_z) /
-                (divisor * normal_magnitude[i]);
+                (scratch->normal_x[i] * game_model->light_direction_x +
+                 scratch->normal_y[i] * game_model->light_direction_y +
+                 scratch->normal_z[i] * game_model->light_direction_z) /
+                (divisor * scratch->normal_magnitude[i]);
         }
     }
 
-    free(normal_x);
-    free(normal_y);
-    free(normal_z);
-    free(normal_magnitude);
+    game_model->lit_divisor = divisor;
+    game_model->lit_direction_x = game_model->light_direction_x;
+    game_model->lit_direction_y = game_model->light_direction_y;
+    game_model->lit_direction_z = game_model->light_direction_z;
+
+    if (scratch == &light_scratch) {
+        game_model_lit_count++;
+    }
 }
 
 void game_model_relight(GameModel *game_model) {
@@ -835,11 +1008,14 @@ void game_model_relight(GameModel *game_model) {
     }
 #endif
 
-    game_model_get_face_normals(
-        game_model, game_model->vertex_transformed_x,
-        game_model->vertex_transformed_y, game_model->vertex_transformed_z,
-        game_model->face_normal_x, game_model->face_normal_y,
-        game_model->face_normal_z, 1);
+    /* a model that was only moved keeps its intensities */
+    if (game_model_get_face_normals(
+            game_model, game_model->vertex_transformed_x,
+            game_model->vertex_transformed_y, game_model->vertex_transformed_z,
+            game_model->face_normal_x, game_model->face_normal_y,
+            game_model->face_normal_z, 1)) {
+        game_model->lit_divisor = 0;
+    }
 
     game_model_light(game_model);
 }
@@ -1050,6 +1226,9 @@ GameModel *game_model_copy(GameModel *game_model) {
     GameModel *copy = calloc(1, sizeof(GameModel));
 
 #if defined(RENDER_GL) || defined(RENDER_3DS_GL)
+    /* not in a scene until scene_add_model, as with game_model_new */
+    copy->scene_index = -1;
+
     copy->vertex_count = game_model->vertex_count;
     copy->face_count = game_model->face_count;
 
@@ -1148,6 +1327,8 @@ void game_model_destroy(GameModel *game_model) {
         return;
     }
 
+    game_model_vertex_hash_end(game_model);
+
     game_model->vertex_count = 0;
 
     for (int i = 0; i < game_model->face_count; i++) {
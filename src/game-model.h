@@ -33,6 +33,9 @@ typedef struct gl_face_fill {
 } gl_face_fill;
 #endif
 
+/* models lit with the shared scratch since scene_render last counted them */
+extern int game_model_lit_count;
+
 #ifdef RENDER_GL
 #ifdef GLAD
 #include <glad/glad.h>
@@ -67,6 +70,16 @@ typedef struct gl_pick_vertex {
 
 typedef struct GameModel GameModel;
 
+/* vertex normals for game_model_light, grown to fit the biggest model lit
+ * with it rather than allocated for every model */
+typedef struct GameModelLightScratch {
+    int16_t *normal_x;
+    int16_t *normal_y;
+    int16_t *normal_z;
+    int32_t *normal_magnitude;
+    int length;
+} GameModelLightScratch;
+
 #include "scene.h"
 #include "utility.h"
 
@@ -112,6 +125,10 @@ struct GameModel {
     /* used to identify the model in mouse picking. stores entity index */
     int key;
 
+    /* position in scene->models, only valid while the scene's entry there
+     * still points back at this model */
+    int scene_index;
+
     /* used to determine which face is selected for mouse picking. used with
      * world->local_x and world->local_y */
     int *face_tag;
@@ -128,6 +145,11 @@ struct GameModel {
     int16_t *vertex_transformed_y;
     int16_t *vertex_transformed_z;
 
+    /* index + 1 of each vertex by position, so game_model_vertex_at doesn't
+     * have to scan every vertex. only kept while world models are built */
+    uint16_t *vertex_hash;
+    int vertex_hash_mask;
+
     int8_t unlit;
     int light_ambience;
     int light_diffuse;
@@ -136,6 +158,16 @@ struct GameModel {
     int light_direction_z;
     int light_direction_magnitude;
 
+    /* the light the face and vertex intensities were last worked out for, so
+     * they aren't again until it or the model changes. 0 if never lit */
+    int lit_divisor;
+    int lit_direction_x;
+    int lit_direction_y;
+    int lit_direction_z;
+
+    /* scratch to light with off the main thread. NULL uses the shared one */
+    GameModelLightScratch *light_scratch;
+
     /* treat vertex_ arrays as vertex_transformed_. used for geneated terrain,
      * wall and roof models */
     int8_t autocommit;
@@ -187,6 +219,8 @@ void game_model_clear(GameModel *game_model);
 void game_model_reduce(GameModel *game_model, int delta_faces,
                        int delta_vertices);
 void game_model_merge(GameModel *game_model, GameModel **pieces, int count);
+void game_model_vertex_hash_begin(GameModel *game_model);
+void game_model_vertex_hash_end(GameModel *game_model);
 int game_model_vertex_at(GameModel *game_model, int x, int y, int z);
 int game_model_create_vertex(GameModel *game_model, int x, int y, int z);
 int game_model_create_face(GameModel *game_model, int number,
@@ -214,7 +248,7 @@ void game_model_apply_rotation(GameModel *game_model, int yaw, int roll,
                                int pitch);
 
 void game_model_compute_bounds(GameModel *game_model);
-void game_model_get_face_normals(GameModel *game_model, int16_t *vertex_x,
+int game_model_get_face_normals(GameModel *game_model, int16_t *vertex_x,
                                  int16_t *vertex_y, int16_t *vertex_z,
                                  int16_t *face_normal_x, int16_t *face_normal_y,
                                  int16_t *face_normal_z, int reset_scale);
@@ -240,6 +274,7 @@ GameModel *game_model_copy_flags(GameModel *game_model, int autocommit,
                                  int isolated, int unlit, int pickable);
 void game_model_copy_position(GameModel *game_model, GameModel *source);
 void game_model_destroy(GameModel *game_model);
+void game_model_light_scratch_free(GameModelLightScratch *scratch);
 void game_model_dump(GameModel *game_model, char *file_name);
 void game_model_mask_faces(GameModel *game_model, int16_t *face_fill,
                            int mask_colour);
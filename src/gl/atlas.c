@@ -0,0 +1,226 @@
+#include "atlas.h"
+
+static void atlas_gl_page_new(gl_atlas_page *page) {
+    page->pixels = calloc(GL_ATLAS_SIZE * GL_ATLAS_SIZE * 4, sizeof(uint8_t));
+
+    /* the transparent pixel at (2, GL_ATLAS_SIZE - 1) is left as it is */
+    uint8_t *white = page->pixels + ((GL_ATLAS_SIZE - 1) * GL_ATLAS_SIZE * 4);
+    memset(white, 255, 2 * 4);
+
+    page->skyline_x[0] = 0;
+    page->skyline_y[0] = 0;
+    page->skyline_width[0] = GL_ATLAS_SIZE;
+    page->skyline_length = 1;
+    page->dirty = 1;
+}
+
+void atlas_gl_new(gl_atlas *atlas) {
+    memset(atlas, 0, sizeof(gl_atlas));
+    atlas_gl_page_new(&atlas->pages[0]);
+    atlas->page_count = 1;
+}
+
+/* the lowest row a rectangle starting at the left of skyline segment index
+ * can go, or -1 if it goes off the page */
+static int atlas_gl_page_fit(gl_atlas_page *page, int index, int width,
+                             int height) {
+    int x = page->skyline_x[index];
+
+    if (x + width > GL_ATLAS_SIZE) {
+        return -1;
+    }
+
+    int y = 0;
+    int width_left = width;
+
+    while (width_left > 0) {
+        if (page->skyline_y[index] > y) {
+            y = page->skyline_y[index];
+        }
+
+        if (y + height > GL_ATLAS_PACK_HEIGHT) {
+            return -1;
+        }
+
+        width_left -= page->skyline_width[index];
+        index++;
+    }
+
+    return y;
+}
+
+static void atlas_gl_page_remove_segment(gl_atlas_page *page, int index) {
+    int length = page->skyline_length - index - 1;
+
+    memmove(page->skyline_x + index, page->skyline_x + index + 1,
+            length * sizeof(int16_t));
+
+    memmove(page->skyline_y + index, page->skyline_y + index + 1,
+            length * sizeof(int16_t));
+
+    memmove(page->skyline_width + index, page->skyline_width + index + 1,
+            length * sizeof(int16_t));
+
+    page->skyline_length--;
+}
+
+static void atlas_gl_page_place(gl_atlas_page *page, int index, int x, int y,
+                                int width) {
+    int length = page->skyline_length - index;
+
+    memmove(page->skyline_x + index + 1, page->skyline_x + index,
+            length * sizeof(int16_t));
+
+    memmove(page->skyline_y + index + 1, page->skyline_y + index,
+            length * sizeof(int16_t));
+
+    memmove(page->skyline_width + index + 1, page->skyline_width + index,
+            length * sizeof(int16_t));
+
+    page->skyline_x[index] = x;
+    page->skyline_y[index] = y;
+    page->skyline_width[index] = width;
+    page->skyline_length++;
+
+    /* cut the segments the new one now covers */
+    int i = index + 1;
+
+    while (i < page->skyline_length) {
+        int right = page->skyline_x[i - 1] + page->skyline_width[i - 1];
+        int overlap = right - page->skyline_x[i];
+
+        if (overlap <= 0) {
+            break;
+        }
+
+        if (overlap < page->skyline_width[i]) {
+            page->skyline_x[i] += overlap;
+            page->skyline_width[i] -= overlap;
+            break;
+        }
+
+        atlas_gl_page_remove_segment(page, i);
+    }
+
+    /* join neighbours at the same height */
+    for (i = 0; i < page->skyline_length - 1; i++) {
+        if (page->skyline_y[i] == page->skyline_y[i + 1]) {
+            page->skyline_width[i] += page->skyline_width[i + 1];
+            atlas_gl_page_remove_segment(page, i + 1);
+            i--;
+        }
+    }
+}
+
+static int atlas_gl_page_add(gl_atlas_page *page, int width, int height,
+                             int *x, int *y) {
+    if (page->pixels == NULL) {
+        return 0;
+    }
+
+    int best_index = -1;
+    int best_bottom = GL_ATLAS_SIZE;
+    int best_width = GL_ATLAS_SIZE;
+
+    for (int i = 0; i < page->skyline_length; i++) {
+        int fit_y = atlas_gl_page_fit(page, i, width, height);
+
+        if (fit_y < 0) {
+            continue;
+        }
+
+        int bottom = fit_y + height;
+
+        if (bottom < best_bottom ||
+            (bottom == best_bottom && page->skyline_width[i] < best_width)) {
+            best_index = i;
+            best_bottom = bottom;
+            best_width = page->skyline_width[i];
+            *y = fit_y;
+        }
+    }
+
+    if (best_index < 0) {
+        return 0;
+    }
+
+    *x = page->skyline_x[best_index];
+
+    atlas_gl_page_place(page, best_index, *x, *y + height, width);
+
+    return 1;
+}
+
+/* copies a width by height rectangle of RGBA pixels into the first page it
+ * fits on, starting a new page if none have room. returns 0 when the
+ * rectangle can't fit on an empty page or every page is full */
+int atlas_gl_add(gl_atlas *atlas, uint8_t *pixels, int width, int height,
+                 int *page_index, int *x, int *y) {
+    if (width <= 0 || height <= 0) {
+        return 0;
+    }
+
+    int index = 0;
+
+    for (; index < atlas->page_count; index++) {
+        if (atlas_gl_page_add(&atlas->pages[index], width, height, x, y)) {
+            break;
+        }
+    }
+
+    if (index == atlas->page_count) {
+        if (atlas->page_count == GL_ATLAS_PAGES) {
+            return 0;
+        }
+
+        atlas_gl_page_new(&atlas->pages[index]);
+        atlas->page_count++;
+
+        if (!atlas_gl_page_add(&atlas->pages[index], width, height, x, y)) {
+            return 0;
+        }
+    }
+
+    gl_atlas_page *page = &atlas->pages[index];
+
+    for (int row = 0; row < height; row++) {
+        memcpy(page->pixels + (((*y + row) * GL_ATLAS_SIZE + *x) * 4),
+               pixels + (row * width * 4), width * 4);
+    }
+
+    page->dirty = 1;
+    *page_index = index;
+
+    return 1;
+}
+
+#ifdef RENDER_GL
+void atlas_gl_upload(gl_atlas *atlas) {
+    for (int i = 0; i < atlas->page_count; i++) {
+        gl_atlas_page *page = &atlas->pages[i];
+
+        if (!page->dirty || page->pixels == NULL) {
+            continue;
+        }
+
+        if (page->texture == 0) {
+            gl_create_texture(&page->texture);
+        } else {
+            glBindTexture(GL_TEXTURE_2D, page->texture);
+        }
+
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, GL_ATLAS_SIZE, GL_ATLAS_SIZE,
+                     0, GL_RGBA, GL_UNSIGNED_BYTE, page->pixels);
+
+        page->dirty = 0;
+    }
+}
+#endif
+
+/* once everything has been added and uploaded */
+void atlas_gl_free_pixels(gl_atlas *atlas) {
+    for (int i = 0; i < atlas->page_count; i++) {
+        free(atlas->pages[i].pixels);
+        atlas->pages[i].pixels = NULL;
+    }
+}
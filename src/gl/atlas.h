@@ -0,0 +1,60 @@
+#ifndef _H_ATLAS
+#define _H_ATLAS
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../utility.h"
+
+#ifdef RENDER_GL
+#ifdef GLAD
+#include <glad/glad.h>
+#else
+#include <GL/glew.h>
+#include <GL/glu.h>
+#endif
+#endif
+
+/* width and height of each page */
+#define GL_ATLAS_SIZE 1024
+
+/* a little over six pages are used with the members entities */
+#define GL_ATLAS_PAGES 12
+
+/* the last row of every page is kept for the white and transparent pixels
+ * that untextured quads sample */
+#define GL_ATLAS_PACK_HEIGHT (GL_ATLAS_SIZE - 1)
+
+typedef struct gl_atlas_page {
+#ifdef RENDER_GL
+    GLuint texture;
+#endif
+
+    /* RGBA, kept until atlas_gl_free_pixels */
+    uint8_t *pixels;
+    int dirty;
+
+    /* the lowest free row above each run of columns, left to right. one
+     * extra for while a new segment is being placed */
+    int16_t skyline_x[GL_ATLAS_SIZE + 1];
+    int16_t skyline_y[GL_ATLAS_SIZE + 1];
+    int16_t skyline_width[GL_ATLAS_SIZE + 1];
+    int skyline_length;
+} gl_atlas_page;
+
+/* packs rectangles of RGBA pixels into as few pages as it can, placing each
+ * one as low as it fits along the skyline of the page */
+typedef struct gl_atlas {
+    gl_atlas_page pages[GL_ATLAS_PAGES];
+    int page_count;
+} gl_atlas;
+
+void atlas_gl_new(gl_atlas *atlas);
+int atlas_gl_add(gl_atlas *atlas, uint8_t *pixels, int width, int height,
+                 int *page, int *x, int *y);
+#ifdef RENDER_GL
+void atlas_gl_upload(gl_atlas *atlas);
+#endif
+void atlas_gl_free_pixels(gl_atlas *atlas);
+#endif
@@ -73,6 +73,7 @@ void shader_new(Shader *shader, char *vertex_path, char *fragment_path) {
     glBindAttribLocationARB(id, 1, "colour");
     glBindAttribLocationARB(id, 2, "texture_position");
     glBindAttribLocationARB(id, 3, "base_texture_position");
+    glBindAttribLocationARB(id, 4, "skin_colour");
 
     /* game_models */
     glBindAttribLocationARB(id, 1, "normal");
@@ -133,6 +134,7 @@ void shader_new(Shader *shader, char *vertex_path, char *fragment_path) {
     glBindAttribLocation(id, 1, "colour");
     glBindAttribLocation(id, 2, "texture_position");
     glBindAttribLocation(id, 3, "base_texture_position");
+    glBindAttribLocation(id, 4, "skin_colour");
 
     /* game_models */
     glBindAttribLocation(id, 1, "normal");
@@ -187,8 +187,8 @@ static int get_next_block(bunzip_data *bd) {
     symCount = symTotal + 2;
 
     for (j = 0; j < groupCount; j++) {
-        uint8_t length[MAX_SYMBOLS], temp[MAX_HUFCODE_BITS + 1];
-        uint32_t minLen, maxLen, pp;
+        uint8_t length[MAX_SYMBOLS];
+        uint32_t temp[MAX_HUFCODE_BITS + 1], minLen, maxLen, pp, code;
 
         /* Read huffman code lengths for each symbol.  They're stored in
            a way similar to mtf; record a starting value for the first symbol,
@@ -292,16 +292,55 @@ static int get_next_block(bunzip_data *bd) {
         limit[maxLen + 1] = INT_MAX; /* Sentinal value for reading next sym. */
         limit[maxLen] = pp + temp[maxLen] - 1;
         base[minLen] = 0;
+
+        /* Build lookup[] from the canonical codes, which are handed out in
+           order of length and then symbol (the same order as permute[]).
+           Every entry whose leading bits are a code gets that code's symbol;
+           entries that only start a longer code are left 0 and decoded with
+           limit[] instead.  Stop if the lengths are oversubscribed and let
+           the limit[] path report the error. */
+        hufGroup->lookupBits =
+            maxLen < HUFF_LOOKUP_BITS ? maxLen : HUFF_LOOKUP_BITS;
+
+        memset(hufGroup->lookup, 0, sizeof(hufGroup->lookup));
+
+        code = pp = 0;
+
+        for (i = minLen; i <= hufGroup->lookupBits; i++) {
+            uint32_t span = 1 << (hufGroup->lookupBits - i);
+
+            for (t = 0; t < temp[i]; t++) {
+                uint32_t first = code++ * span;
+                uint16_t entry = (i << HUFF_LOOKUP_LENGTH_SHIFT) |
+                                 hufGroup->permute[pp++];
+
+                if (first + span > (1u << hufGroup->lookupBits)) {
+                    goto lookup_done;
+                }
+
+                for (k = first; k < first + span; k++) {
+                    hufGroup->lookup[k] = entry;
+                }
+            }
+
+            code <<= 1;
+        }
+    lookup_done:;
     }
 
     /* We've finished reading and digesting the block header.  Now read this
        block's huffman coded symbols from the file and undo the huffman coding
        and run length encoding, saving the result into dbuf[dbufCount++]=uc */
 
-    /* Initialize symbol occurrence counters and symbol Move To Front table */
+    /* Initialize symbol occurrence counters and symbol Move To Front table.
+       The MTF table holds the bytes each symbol stands for directly, which
+       saves a symToByte[] lookup per literal. */
     for (i = 0; i < 256; i++) {
         byteCount[i] = 0;
-        mtfSymbol[i] = (uint8_t)i;
+    }
+
+    for (i = 0; i < symTotal; i++) {
+        mtfSymbol[i] = symToByte[i];
     }
 
     /* Loop through compressed symbols. */
@@ -346,24 +385,34 @@ static int get_next_block(bunzip_data *bd) {
         j = (bd->inbufBits >> bd->inbufBitCount) &
             ((1 << hufGroup->maxLen) - 1);
     got_huff_bits:
-        /* Figure how how many bits are in next symbol and unget extras */
-        i = hufGroup->minLen;
+        /* Most codes are short enough to decode with one table lookup on
+           their leading bits. Otherwise figure out how many bits are in the
+           next symbol the slow way. Either way, unget the extras. */
+        k = hufGroup->lookup[j >> (hufGroup->maxLen - hufGroup->lookupBits)];
+
+        if (k) {
+            i = k >> HUFF_LOOKUP_LENGTH_SHIFT;
+            nextSym = k & HUFF_LOOKUP_SYMBOL_MASK;
+            bd->inbufBitCount += (hufGroup->maxLen - i);
+        } else {
+            i = hufGroup->minLen;
+
+            while (j > limit[i]) {
+                ++i;
+            }
 
-        while (j > limit[i]) {
-            ++i;
-        }
+            bd->inbufBitCount += (hufGroup->maxLen - i);
 
-        bd->inbufBitCount += (hufGroup->maxLen - i);
+            /* Huffman decode value to get nextSym (with bounds checking) */
+            if ((i > hufGroup->maxLen) ||
+                (((unsigned)(j = (j >> (hufGroup->maxLen - i)) - base[i])) >=
+                 MAX_SYMBOLS)) {
+                return RETVAL_DATA_ERROR;
+            }
 
-        /* Huffman decode value to get nextSym (with bounds checking) */
-        if ((i > hufGroup->maxLen) ||
-            (((unsigned)(j = (j >> (hufGroup->maxLen - i)) - base[i])) >=
-             MAX_SYMBOLS)) {
-            return RETVAL_DATA_ERROR;
+            nextSym = hufGroup->permute[j];
         }
 
-        nextSym = hufGroup->permute[j];
-
         /* We have now decoded the symbol, which indicates either a new literal
            byte, or a repeated run of the most recent literal byte.  First,
            check if nextSym indicates a repeated run, and if so loop collecting
@@ -398,7 +447,7 @@ static int get_next_block(bunzip_data *bd) {
                 return RETVAL_DATA_ERROR;
             }
 
-            uc = symToByte[mtfSymbol[0]];
+            uc = mtfSymbol[0];
             byteCount[uc] += t;
 
             while (t--) {
@@ -428,13 +477,22 @@ static int get_next_block(bunzip_data *bd) {
         /* Adjust the MTF array.  Since we typically expect to move only a
          * small number of symbols, and are bound by 256 in any case, using
          * memmove here would typically be bigger and slower due to function
-         * call overhead and other assorted setup costs. */
-        do {
+         * call overhead and other assorted setup costs.  Shift four at a
+         * time for the occasional symbol from further back. */
+        while (i >= 4) {
             mtfSymbol[i] = mtfSymbol[i - 1];
-        } while (--i);
+            mtfSymbol[i - 1] = mtfSymbol[i - 2];
+            mtfSymbol[i - 2] = mtfSymbol[i - 3];
+            mtfSymbol[i - 3] = mtfSymbol[i - 4];
+            i -= 4;
+        }
+
+        while (i) {
+            mtfSymbol[i] = mtfSymbol[i - 1];
+            i--;
+        }
 
         mtfSymbol[0] = uc;
-        uc = symToByte[uc];
 
         /* We have our literal byte.  Save it into dbuf. */
         byteCount[uc]++;
@@ -491,8 +549,9 @@ static int get_next_block(bunzip_data *bd) {
 */
 
 static int read_bunzip(bunzip_data *bd, int8_t *outbuf, int len) {
-    const uint32_t *dbuf;
-    int pos, current, previous, gotcount;
+    const uint32_t *dbuf, *crcTable;
+    uint32_t crc;
+    int pos, current, previous, gotcount, count, copies, countdown;
 
     /* If last read was short due to end of file, return last block now */
     if (bd->writeCount < 0) {
@@ -501,16 +560,24 @@ static int read_bunzip(bunzip_data *bd, int8_t *outbuf, int len) {
 
     gotcount = 0;
     dbuf = bd->dbuf;
+    crcTable = bd->crc32Table;
     pos = bd->writePos;
     current = bd->writeCurrent;
 
+    /* The loop state lives in locals rather than bd so it can stay in
+       registers, and is written back whenever the loop is left. */
+    crc = bd->writeCRC;
+    count = bd->writeCount;
+    copies = bd->writeCopies;
+    countdown = bd->writeRunCountdown;
+
     /* We will always have pending decoded data to write into the output
        buffer unless this is the very first call (in which case we haven't
        huffman-decoded a block into the intermediate buffer yet). */
 
-    if (bd->writeCopies) {
-        /* Inside the loop, writeCopies means extra copies (beyond 1) */
-        --bd->writeCopies;
+    if (copies) {
+        /* Inside the loop, copies means extra copies (beyond 1) */
+        --copies;
 
         /* Loop outputting bytes */
         for (;;) {
@@ -518,23 +585,25 @@ static int read_bunzip(bunzip_data *bd, int8_t *outbuf, int len) {
             if (gotcount >= len) {
                 bd->writePos = pos;
                 bd->writeCurrent = current;
-                bd->writeCopies++;
+                bd->writeCRC = crc;
+                bd->writeCount = count;
+                bd->writeCopies = copies + 1;
+                bd->writeRunCountdown = countdown;
                 return len;
             }
 
             /* Write next byte into output buffer, updating CRC */
             outbuf[gotcount++] = current;
 
-            bd->writeCRC = (((bd->writeCRC) << 8) ^
-                            bd->crc32Table[((bd->writeCRC) >> 24) ^ current]);
+            crc = (crc << 8) ^ crcTable[(crc >> 24) ^ current];
 
             /* Loop now if we're outputting multiple copies of this byte */
-            if (bd->writeCopies) {
-                --bd->writeCopies;
+            if (copies) {
+                --copies;
                 continue;
             }
         decode_next_byte:
-            if (!bd->writeCount--) {
+            if (!count--) {
                 break;
             }
 
@@ -547,28 +616,32 @@ static int read_bunzip(bunzip_data *bd, int8_t *outbuf, int len) {
             /* After 3 consecutive copies of the same byte, the 4th is a repeat
                count.  We count down from 4 instead
              * of counting up because testing for non-zero is faster */
-            if (--bd->writeRunCountdown) {
+            if (--countdown) {
                 if (current != previous) {
-                    bd->writeRunCountdown = 4;
+                    countdown = 4;
                 }
             } else {
                 /* We have a repeated run, this byte indicates the count */
-                bd->writeCopies = current;
+                copies = current;
                 current = previous;
-                bd->writeRunCountdown = 5;
+                countdown = 5;
 
                 /* Sometimes there are just 3 bytes (run length 0) */
-                if (!bd->writeCopies) {
+                if (!copies) {
                     goto decode_next_byte;
                 }
 
                 /* Subtract the 1 copy we'd output anyway to get extras */
-                --bd->writeCopies;
+                --copies;
             }
         }
 
+        bd->writeCount = count;
+        bd->writeCopies = copies;
+        bd->writeRunCountdown = countdown;
+
         /* Decompression of this block completed successfully */
-        bd->writeCRC = ~bd->writeCRC;
+        bd->writeCRC = ~crc;
 
         bd->totalCRC =
             ((bd->totalCRC << 1) | (bd->totalCRC >> 31)) ^ bd->writeCRC;
@@ -589,9 +662,12 @@ static int read_bunzip(bunzip_data *bd, int8_t *outbuf, int len) {
         return (previous != RETVAL_LAST_BLOCK) ? previous : gotcount;
     }
 
-    bd->writeCRC = 0xffffffffUL;
+    crc = 0xffffffffUL;
     pos = bd->writePos;
     current = bd->writeCurrent;
+    count = bd->writeCount;
+    copies = 0;
+    countdown = bd->writeRunCountdown;
 
     goto decode_next_byte;
 }
@@ -688,7 +764,9 @@ void bzip_decompress(int8_t *file_data, int8_t *archive_data, int archive_size,
     int write_offset = 0;
 
     while (1) {
-        retval = read_bunzip(bd, file_data + write_offset, IOBUF_SIZE);
+        /* the caller sized file_data for the whole entry, so let each call
+         * run through as many blocks as it can */
+        retval = read_bunzip(bd, file_data + write_offset, INT_MAX);
 
         /* finished */
         if (retval == -1) {
@@ -707,6 +785,6 @@ void bzip_decompress(int8_t *file_data, int8_t *archive_data, int archive_size,
             return;
         }
 
-        write_offset += IOBUF_SIZE;
+        write_offset += retval;
     }
 }
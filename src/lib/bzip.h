@@ -30,13 +30,23 @@
 /* Other housekeeping constants */
 #define IOBUF_SIZE 4096
 
+/* Codes up to this many bits are decoded with a single table lookup */
+#define HUFF_LOOKUP_BITS 10
+#define HUFF_LOOKUP_SYMBOL_MASK 0x1ff
+#define HUFF_LOOKUP_LENGTH_SHIFT 9
+
 /* This is what we know about each huffman coding group */
 struct group_data {
     /* We have an extra slot at the end of limit[] for a sentinal value. */
     uint32_t limit[MAX_HUFCODE_BITS + 1], base[MAX_HUFCODE_BITS],
         permute[MAX_SYMBOLS];
 
-    size_t minLen, maxLen;
+    /* Indexed by the next lookupBits bits of input, each entry is the code
+       length shifted by HUFF_LOOKUP_LENGTH_SHIFT or'd with the decoded
+       symbol, or 0 if the code is longer than lookupBits. */
+    uint16_t lookup[1 << HUFF_LOOKUP_BITS];
+
+    size_t minLen, maxLen, lookupBits;
 };
 
 /* Structure holding all the housekeeping data, including IO buffers and
@@ -44,6 +44,12 @@ void mudclient_poll_events(mudclient *mud) {
             if (event.key.keysym.sym == SDLK_F2) {
                 mud->options->display_fps = !mud->options->display_fps;
             }
+
+            // Toggle frame time overlay
+            if (event.key.keysym.sym == SDLK_F3) {
+                mud->options->display_profiler =
+                    !mud->options->display_profiler;
+            }
             break;
         }
 
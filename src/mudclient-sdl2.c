@@ -61,6 +61,19 @@ void get_sdl_keycodes(SDL_Keysym *keysym, char *char_code, int *code) {
 }
 
 void mudclient_start_application(mudclient *mud, char *title) {
+#ifdef HEADLESS
+    /* no window, frames are only drawn into mud->surface */
+    (void)mud;
+    (void)title;
+
+    if (SDL_Init(SDL_INIT_TIMER) < 0) {
+        mud_error("SDL_Init(): %s\n", SDL_GetError());
+        exit(1);
+    }
+
+    return;
+#endif
+
 #ifdef __SWITCH__
     Result romfs_res = romfsInit();
 
@@ -1,4 +1,8 @@
 #include "mudclient.h"
+#include <ctype.h>
+
+/* the rest of the platforms and replay-bench don't have these */
+#ifdef _arch_dreamcast
 #include <kos.h>
 #include <kos/net.h>
 #include <dc/maple.h>
@@ -9,12 +13,12 @@
 #include <dc/video.h>
 #include <dc/sound/stream.h>
 #include <SDL/SDL.h>
-#include <ctype.h>
 #include <kos/dbglog.h>
 
 
 
 KOS_INIT_FLAGS(INIT_DEFAULT | INIT_NET);
+#endif
 
 int mudclient_finger_1_x = 0;
 int mudclient_finger_1_y = 0;
@@ -272,7 +276,7 @@ void mudclient_resize(mudclient *mud) {
 #endif
 }
 
-static void mudclient_start_application_common(struct mudclient *mud) {
+void mudclient_start_application_common(struct mudclient *mud) {
 #ifdef RENDER_GL
 
 #ifdef GLAD
@@ -323,11 +327,12 @@ static void mudclient_start_application_common(struct mudclient *mud) {
     surface_new(mud->surface, mud->game_width, mud->game_height, SPRITE_LIMIT,
                 mud);
 
+    surface_set_tint_cache(mud->surface, mud->options->tint_cache_kb);
+    surface_set_rle_sprites(mud->surface, mud->options->rle_sprites);
+
     surface_set_bounds(mud->surface, 0, 0, mud->game_width, mud->game_height);
 
     mud_log("Started application\n");
-
-    mudclient_run(mud);
 }
 
 void mudclient_handle_key_press(mudclient *mud, int key_code) {
@@ -841,17 +846,8 @@ void mudclient_draw_loading_progress(mudclient *mud, int percent, char *text) {
 #endif
 }
 
-int8_t *mudclient_read_data_file(mudclient *mud, char *file, char *description,
-                                 int percent) {
-    char loading_text[35] = {0}; /* max description is 19 */
-
-    sprintf(loading_text, "Loading %s - 0%%", description);
-    mudclient_draw_loading_progress(mud, percent, loading_text);
-
-    int8_t header[6];
-
-    char prefixed_file[PATH_MAX];
-    snprintf(prefixed_file, sizeof(prefixed_file), "/cd/cache/%s", file);
+static FILE *mudclient_open_data_file(char *file, char *prefixed_file) {
+    snprintf(prefixed_file, PATH_MAX, "/cd/cache/%s", file);
 
     /* attempt to read cache from the current working directory first */
     printf("INFO: Loading %s\n", prefixed_file);
@@ -865,11 +861,10 @@ int8_t *mudclient_read_data_file(mudclient *mud, char *file, char *description,
             if (home == NULL) {
                 home = "";
             }
-            snprintf(prefixed_file, sizeof(prefixed_file),
-                     "%s/local/share/rsc-c/%s", home, file);
+            snprintf(prefixed_file, PATH_MAX, "%s/local/share/rsc-c/%s", home,
+                     file);
         } else {
-            snprintf(prefixed_file, sizeof(prefixed_file), "%s/cache/%s",
-                     xdg_home, file);
+            snprintf(prefixed_file, PATH_MAX, "%s/cache/%s", xdg_home, file);
         }
 
         printf("INFO: Loading %s\n", prefixed_file);
@@ -877,63 +872,165 @@ int8_t *mudclient_read_data_file(mudclient *mud, char *file, char *description,
 
         /* XDG failed, now try the global prefix... */
         if (archive_stream == NULL) {
-            snprintf(prefixed_file, sizeof(prefixed_file), "%s/%s", MUD_DATADIR,
-                     file);
+            snprintf(prefixed_file, PATH_MAX, "%s/%s", MUD_DATADIR, file);
 
             printf("INFO: Loading %s\n", prefixed_file);
             archive_stream = fopen(prefixed_file, "rb");
         }
     }
 
+    return archive_stream;
+}
+
+static void mudclient_queue_data_file(mudclient *mud, char *file) {
+    char prefixed_file[PATH_MAX];
+    FILE *archive_stream = mudclient_open_data_file(file, prefixed_file);
+
+    /* missing files are reported when they're read */
     if (archive_stream == NULL) {
-        mud_error("Unable to read file: %s\n", prefixed_file);
-        exit(1);
+        return;
     }
 
-    fread(header, sizeof(header), 1, archive_stream);
+    if (!archive_loader_add(mud->archive_loader, file, archive_stream)) {
+        fclose(archive_stream);
+    }
+}
 
-    int archive_size = ((header[0] & 0xff) << 16) + ((header[1] & 0xff) << 8) +
-                       (header[2] & 0xff);
+/* start unpacking every archive mudclient_start_game needs in the background,
+ * queued in the order they're read so the earliest are ready first */
+void mudclient_queue_data_files(mudclient *mud) {
+    if (mud->options->loader_threads == 0) {
+        return;
+    }
 
-    int archive_size_compressed = ((header[3] & 0xff) << 16) +
-                                  ((header[4] & 0xff) << 8) +
-                                  (header[5] & 0xff);
+    mud->archive_loader = malloc(sizeof(ArchiveLoader));
+    archive_loader_new(mud->archive_loader, mud->options->loader_threads,
+                       mud->options->unpacked_cache);
 
-    sprintf(loading_text, "Loading %s - 5%%", description);
-    mudclient_draw_loading_progress(mud, percent, loading_text);
+    mudclient_queue_data_file(mud, "jagex.jag");
+    mudclient_queue_data_file(mud,
+                              "config" VERSION_STR(VERSION_CONFIG) ".jag");
+    mudclient_queue_data_file(mud, "media" VERSION_STR(VERSION_MEDIA) ".jag");
+    mudclient_queue_data_file(mud,
+                              "entity" VERSION_STR(VERSION_ENTITY) ".jag");
 
-    int read = 0;
-    int8_t *archive_data = malloc(archive_size_compressed);
+#if !defined(RENDER_GL) && !defined(RENDER_3DS_GL)
+    if (mud->options->tga_sprites) {
+        mudclient_queue_data_file(mud, "entity8.jag");
+    }
+#endif
 
-    while (read < archive_size_compressed) {
-        int length = archive_size_compressed - read;
+    if (mud->options->members && !ENTITY_IS_TGA) {
+        mudclient_queue_data_file(mud,
+                                  "entity" VERSION_STR(VERSION_ENTITY) ".mem");
+    }
+
+#ifdef RENDER_SW
+    mudclient_queue_data_file(
+        mud, "textures" VERSION_STR(VERSION_TEXTURES) ".jag");
+#endif
 
-        fread(archive_data + read, length, 1, archive_stream);
+    mudclient_queue_data_file(mud,
+                              "models" VERSION_STR(VERSION_MODELS) ".jag");
+    mudclient_queue_data_file(mud, "maps" VERSION_STR(VERSION_MAPS) ".jag");
 
-        read += length;
+    if (mud->options->members) {
+        mudclient_queue_data_file(mud, "maps" VERSION_STR(VERSION_MAPS) ".mem");
+    }
 
-        sprintf(loading_text, "Loading %s - %d%%", description,
-                5 + (read * 95) / archive_size_compressed);
+#if HAS_SEPARATE_LAND
+    mudclient_queue_data_file(mud, "land" VERSION_STR(VERSION_MAPS) ".jag");
 
-        mudclient_draw_loading_progress(mud, percent, loading_text);
+    if (mud->options->members) {
+        mudclient_queue_data_file(mud, "land" VERSION_STR(VERSION_MAPS) ".mem");
     }
+#endif
 
-    fclose(archive_stream);
+    if (mud->options->members && !mud->options->lowmem) {
+        mudclient_queue_data_file(mud,
+                                  "sounds" VERSION_STR(VERSION_SOUNDS) ".mem");
+    }
+
+    archive_loader_start(mud->archive_loader);
+}
+
+void mudclient_free_data_files(mudclient *mud) {
+    if (mud->archive_loader == NULL) {
+        return;
+    }
+
+    archive_loader_free(mud->archive_loader);
+    free(mud->archive_loader);
+    mud->archive_loader = NULL;
+}
+
+/* wait for a queued archive, keeping the loading bar up to date */
+static int8_t *mudclient_take_data_file(mudclient *mud, ArchiveLoaderJob *job,
+                                        char *description, int percent) {
+    char loading_text[35] = {0}; /* max description is 19 */
+    ARCHIVE_JOB_STATE last_state = ARCHIVE_JOB_QUEUED;
+    ARCHIVE_JOB_STATE state = ARCHIVE_JOB_QUEUED;
+
+    while ((state = archive_loader_wait(mud->archive_loader, job,
+                                        ARCHIVE_LOADER_POLL_MS)) <
+           ARCHIVE_JOB_DONE) {
+        if (state != last_state) {
+            sprintf(loading_text, "Unpacking %s", description);
+            mudclient_draw_loading_progress(mud, percent, loading_text);
+            last_state = state;
+        }
+    }
+
+    int8_t *archive_data = archive_loader_take(mud->archive_loader, job);
+
+    if (archive_data == NULL) {
+        mud_error("Unable to read file: %s\n", job->file);
+        exit(1);
+    }
+
+    jag_archive_index(archive_data);
+
+    return archive_data;
+}
+
+int8_t *mudclient_read_data_file(mudclient *mud, char *file, char *description,
+                                 int percent) {
+    char loading_text[35] = {0}; /* max description is 19 */
+
+    sprintf(loading_text, "Loading %s - 0%%", description);
+    mudclient_draw_loading_progress(mud, percent, loading_text);
+
+    if (mud->archive_loader != NULL) {
+        ArchiveLoaderJob *job = archive_loader_find(mud->archive_loader, file);
+
+        if (job != NULL && job->state != ARCHIVE_JOB_TAKEN) {
+            return mudclient_take_data_file(mud, job, description, percent);
+        }
+    }
+
+    char prefixed_file[PATH_MAX];
+    FILE *archive_stream = mudclient_open_data_file(file, prefixed_file);
+
+    if (archive_stream == NULL) {
+        mud_error("Unable to read file: %s\n", prefixed_file);
+        exit(1);
+    }
 
     sprintf(loading_text, "Unpacking %s", description);
     mudclient_draw_loading_progress(mud, percent, loading_text);
 
-    if (archive_size_compressed != archive_size) {
-        int8_t *decompressed = malloc(archive_size);
-        bzip_decompress(decompressed, archive_data, archive_size_compressed, 0);
+    int8_t *archive_data = archive_loader_load(archive_stream, file,
+                                               mud->options->unpacked_cache);
 
-#ifndef WII
-        free(archive_data);
-#endif
+    fclose(archive_stream);
 
-        return decompressed;
+    if (archive_data == NULL) {
+        mud_error("Unable to read file: %s\n", prefixed_file);
+        exit(1);
     }
 
+    jag_archive_index(archive_data);
+
     return archive_data;
 }
 
@@ -942,7 +1039,7 @@ void mudclient_load_jagex(mudclient *mud) {
         mudclient_read_data_file(mud, "jagex.jag", "Jagex library", 0);
 
     if (jagex_jag != NULL) {
-#ifdef RENDER_SW
+#if defined(RENDER_SW) || defined(RENDER_GL)
         if (!mud->options->lowmem) {
             size_t len = 0;
             int8_t *logo_tga = load_data("logo.tga", 0, jagex_jag, &len);
@@ -961,11 +1058,16 @@ void mudclient_load_jagex(mudclient *mud) {
             create_font(font, i);
         }
 
+#ifdef RENDER_GL
+        surface_gl_pack_fonts(mud->surface);
+        surface_gl_pack_sprites(mud->surface, SPRITE_LIMIT - 1, SPRITE_LIMIT);
+#endif
+
 #ifndef WII
-        free(jagex_jag);
+        archive_loader_release(jagex_jag);
 #endif
     }
-#if defined(RENDER_GL) || defined(RENDER_3DS_GL)
+#ifdef RENDER_3DS_GL
     int logo_sprite_id = SPRITE_LIMIT - 1;
 
     mud->surface->sprite_width[logo_sprite_id] = 281;
@@ -983,7 +1085,7 @@ void mudclient_load_game_config(mudclient *mud) {
     }
 
     game_data_load_data(config_jag, mud->options->members);
-    free(config_jag);
+    archive_loader_release(config_jag);
 
     /*int8_t *filter_jag = mudclient_read_data_file(
         mud, "filter" VERSION_STR(VERSION_FILTER) ".jag", "Chat system", 15);
@@ -1256,7 +1358,7 @@ void mudclient_load_media(mudclient *mud) {
 #endif
 
 #ifndef WII
-    free(media_jag);
+    archive_loader_release(media_jag);
 #endif
 #endif
 }
@@ -1440,11 +1542,11 @@ fallthrough:
     mud_log("Loaded: %d frames of animation\n", frame_count);
 
 #ifndef WII
-    free(entity_jag);
+    archive_loader_release(entity_jag);
     if (entity_jag_legacy != entity_jag) {
-        free(entity_jag_legacy);
+        archive_loader_release(entity_jag_legacy);
     }
-    free(entity_jag_mem);
+    archive_loader_release(entity_jag_mem);
 #endif
 
     free(index_dat);
@@ -1464,7 +1566,9 @@ void mudclient_load_textures(mudclient *mud) {
 
     int8_t *index_dat = load_data("index.dat", 0, textures_jag, NULL);
 
-    scene_allocate_textures(mud->scene, game_data.texture_count, 7, 11);
+    scene_allocate_textures(mud->scene, game_data.texture_count,
+                            mud->options->texture_slots_64,
+                            mud->options->texture_slots_128);
 
     char file_name[255] = {0};
 
@@ -1493,6 +1597,7 @@ void mudclient_load_textures(mudclient *mud) {
 
         free(surface->sprite_colours[mud->sprite_texture]);
         surface->sprite_colours[mud->sprite_texture] = NULL;
+        surface_free_spans(surface, mud->sprite_texture);
 
         int texture_size = surface->sprite_width_full[mud->sprite_texture];
         char *name_sub = game_data.textures[i].subtype_name;
@@ -1518,6 +1623,7 @@ void mudclient_load_textures(mudclient *mud) {
 
                 free(surface->sprite_colours[mud->sprite_texture]);
                 surface->sprite_colours[mud->sprite_texture] = NULL;
+                surface_free_spans(surface, mud->sprite_texture);
             }
         }
 
@@ -1548,7 +1654,7 @@ void mudclient_load_textures(mudclient *mud) {
     free(index_dat);
 
 #ifndef WII
-    free(textures_jag);
+    archive_loader_release(textures_jag);
 #endif
 #else
     (void)mud;
@@ -1663,7 +1769,7 @@ void mudclient_load_models(mudclient *mud) {
 #endif
     }
 
-    free(models_jag);
+    archive_loader_release(models_jag);
 
 #ifdef RENDER_GL
     int models_length = game_data.model_count - 1;
@@ -1900,11 +2006,16 @@ void mudclient_login(mudclient *mud, char *username, char *password,
                                            "Connecting to server");
     }
 
+    if (mud->packet_stream != NULL) {
+        packet_stream_stop_thread(mud->packet_stream);
+        packet_stream_stop_capture(mud->packet_stream);
+    }
+
     free(mud->packet_stream);
     mud->packet_stream = malloc(sizeof(PacketStream));
     packet_stream_new(mud->packet_stream, mud);
 
-    if (mud->packet_stream->closed) {
+    if (__atomic_load_n(&mud->packet_stream->closed, __ATOMIC_ACQUIRE)) {
         goto login_fail;
     }
 
@@ -2001,6 +2112,14 @@ void mudclient_login(mudclient *mud, char *username, char *password,
             options_save(mud->options);
         }
 
+        if (mud->options->network_thread) {
+            packet_stream_start_thread(mud->packet_stream);
+        }
+
+        if (mud->options->record_packets) {
+            mudclient_start_capture(mud);
+        }
+
         mudclient_reset_game(mud);
         return;
     }
@@ -2182,11 +2301,16 @@ void mudclient_register(mudclient *mud, char *username, char *password) {
     mudclient_show_login_screen_status(mud, "Please wait...",
                                        "Connecting to server");
 
+    if (mud->packet_stream != NULL) {
+        packet_stream_stop_thread(mud->packet_stream);
+        packet_stream_stop_capture(mud->packet_stream);
+    }
+
     free(mud->packet_stream);
     mud->packet_stream = malloc(sizeof(PacketStream));
     packet_stream_new(mud->packet_stream, mud);
 
-    if (mud->packet_stream->closed) {
+    if (__atomic_load_n(&mud->packet_stream->closed, __ATOMIC_ACQUIRE)) {
         goto register_fail;
     }
 
@@ -2440,6 +2564,11 @@ void mudclient_start_game(mudclient *mud) {
         return;
     }
 
+#ifdef RENDER_GL
+    surface_gl_pack_sprites(mud->surface, 0, mud->sprite_texture);
+    surface_gl_finish_atlas(mud->surface);
+#endif
+
     mud->scene = malloc(sizeof(Scene));
     if (mud->options->lowmem) {
         scene_new(mud->scene, mud->surface, 7500, 7500, 1000);
@@ -2449,6 +2578,10 @@ void mudclient_start_game(mudclient *mud) {
 
     scene_set_bounds(mud->scene, mud->game_width, mud->game_height - 12);
 
+#ifdef RENDER_SW
+    scene_set_raster_threads(mud->scene, mud->options->render_threads);
+#endif
+
     mud->scene->clip_far_3d = 2400;
     mud->scene->clip_far_2d = 2400;
     mud->scene->fog_z_distance = 2300;
@@ -2483,6 +2616,9 @@ void mudclient_start_game(mudclient *mud) {
         return;
     }
 
+    world_set_section_cache(mud->world, mud->options->section_cache_kb);
+    world_set_prefetch(mud->world, mud->options->region_prefetch);
+
     if (mud->options->members && !mud->options->lowmem) {
         mudclient_load_sounds(mud);
     }
@@ -2582,24 +2718,29 @@ int mudclient_load_next_region(mudclient *mud, int lx, int ly) {
         lx < mud->local_upper_x && ly > mud->local_lower_y &&
         ly < mud->local_upper_y) {
         mud->world->player_alive = 1;
+        world_prefetch(mud->world, lx, ly, mud->plane_index);
         return 0;
     }
 
-    surface_draw_string_centre(
-        mud->surface, "Loading... Please wait", mud->surface->width / 2,
-        mud->surface->height / 2 + 19, FONT_BOLD_12, WHITE);
+    /* there's no need to tell the player to wait if the region is only
+     * assembled from sections that were already decoded */
+    if (!world_is_prefetched(mud->world, lx, ly, mud->plane_index)) {
+        surface_draw_string_centre(
+            mud->surface, "Loading... Please wait", mud->surface->width / 2,
+            mud->surface->height / 2 + 19, FONT_BOLD_12, WHITE);
 
-    mudclient_draw_chat_message_tabs(mud);
+        mudclient_draw_chat_message_tabs(mud);
 
-    surface_draw(mud->surface);
+        surface_draw(mud->surface);
 
 #ifdef RENDER_GL
 #ifdef SDL12
-    SDL_GL_SwapBuffers();
+        SDL_GL_SwapBuffers();
 #else
-    SDL_GL_SwapWindow(mud->gl_window);
+        SDL_GL_SwapWindow(mud->gl_window);
 #endif
 #endif
+    }
 
     int ax = mud->region_x;
     int ay = mud->region_y;
@@ -2725,6 +2866,8 @@ int mudclient_load_next_region(mudclient *mud, int lx, int ly) {
 
     mud->world->player_alive = 1;
 
+    world_prefetch(mud->world, lx, ly, mud->plane_index);
+
     return 1;
 }
 
@@ -3094,7 +3237,9 @@ void mudclient_handle_game_input(mudclient *mud) {
         }
     }
 
+    profiler_begin(PROFILE_PACKET_TICK);
     mudclient_packet_tick(mud);
+    profiler_end(PROFILE_PACKET_TICK);
 
     if (mud->logout_timeout > 0) {
         mud->logout_timeout--;
@@ -3424,7 +3569,9 @@ void mudclient_handle_inputs(mudclient *mud) {
         }
 #endif
 
+        profiler_begin(PROFILE_GAME_INPUT);
         mudclient_handle_game_input(mud);
+        profiler_end(PROFILE_GAME_INPUT);
     }
 
     mud->last_mouse_button_down = 0;
@@ -3722,8 +3869,7 @@ void mudclient_draw_player(mudclient *mud, int x, int y, int width, int height,
             int sprite_id = j5 + game_data.animations[animation_id].file_id;
 
 #ifdef RENDER_SW
-            if (mud->surface->surface_pixels[sprite_id] == NULL &&
-                mud->surface->sprite_colours[sprite_id] == NULL) {
+            if (!surface_sprite_loaded(mud->surface, sprite_id)) {
                 /* sprite file was not loaded, probably on f2p version */
                 continue;
             }
@@ -3883,8 +4029,7 @@ void mudclient_draw_npc(mudclient *mud, int x, int y, int width, int height,
             int sprite_id = k4 + game_data.animations[animation_id].file_id;
 
 #ifdef RENDER_SW
-            if (mud->surface->surface_pixels[sprite_id] == NULL &&
-                mud->surface->sprite_colours[sprite_id] == NULL) {
+            if (!surface_sprite_loaded(mud->surface, sprite_id)) {
                 /* sprite file was not loaded, probably on f2p version */
                 continue;
             }
@@ -4450,6 +4595,87 @@ void mudclient_draw_entity_sprites(mudclient *mud) {
     }
 }
 
+void mudclient_draw_profiler(mudclient *mud) {
+    int y = 50;
+
+    for (int i = 0; i < PROFILE_SCOPE_COUNT; i++) {
+        int average = profiler_average(i);
+
+        char formatted[48] = {0};
+
+        sprintf(formatted, "%s: %d.%02d ms", profile_scope_names[i],
+                average / 1000, (average % 1000) / 10);
+
+        surface_draw_string(mud->surface, formatted, 8, y, FONT_REGULAR_11,
+                            i == PROFILE_FRAME ? YELLOW : WHITE);
+
+        y += 12;
+    }
+
+    /* counted while the scene was drawn this frame */
+    SceneStats *stats = &mud->scene->stats;
+    char formatted[64] = {0};
+
+    sprintf(formatted, "models: %d tested, %d culled, %d projected",
+            stats->models_tested, stats->models_culled,
+            stats->models_projected);
+
+    surface_draw_string(mud->surface, formatted, 8, y, FONT_REGULAR_11, WHITE);
+    y += 12;
+
+    sprintf(formatted, "cells culled: %d", stats->cells_culled);
+    surface_draw_string(mud->surface, formatted, 8, y, FONT_REGULAR_11, WHITE);
+    y += 12;
+
+    sprintf(formatted, "models lit: %d", stats->models_lit);
+    surface_draw_string(mud->surface, formatted, 8, y, FONT_REGULAR_11, WHITE);
+    y += 12;
+
+    sprintf(formatted, "textures: %d hit, %d missed, %d evicted",
+            stats->textures_hit, stats->textures_missed,
+            stats->textures_evicted);
+
+    surface_draw_string(mud->surface, formatted, 8, y, FONT_REGULAR_11, WHITE);
+}
+
+/* start writing frame timings to a trace file, or finish the one being
+ * written */
+void mudclient_toggle_trace(mudclient *mud) {
+    char message[PATH_MAX + 32] = {0};
+
+    if (profiler.trace != NULL) {
+        profiler_stop_trace();
+
+        mudclient_show_message(mud, "@yel@Frame trace saved",
+                               MESSAGE_TYPE_GAME);
+        return;
+    }
+
+    char file_name[32] = {0};
+    sprintf(file_name, "trace-%ld.json", (long)time(NULL));
+
+    char path[PATH_MAX] = {0};
+    get_config_path(file_name, path);
+
+    if (profiler_start_trace(path)) {
+        sprintf(message, "@yel@Writing frame trace to %s", path);
+        mudclient_show_message(mud, message, MESSAGE_TYPE_GAME);
+    }
+}
+
+/* record the packets of this session for replay-bench */
+void mudclient_start_capture(mudclient *mud) {
+    char file_name[32] = {0};
+    sprintf(file_name, "capture-%ld.bin", (long)time(NULL));
+
+    char path[PATH_MAX] = {0};
+    get_config_path(file_name, path);
+
+    if (packet_stream_start_capture(mud->packet_stream, path)) {
+        mud_log("Recording packets to %s\n", path);
+    }
+}
+
 void mudclient_draw_game(mudclient *mud) {
 
     if (mud->death_screen_timeout != 0) {
@@ -4479,34 +4705,39 @@ void mudclient_draw_game(mudclient *mud) {
         return;
     }
 
-    for (int i = 0; i < TERRAIN_COUNT; i++) {
-        // TODO this is really slow!
-        scene_remove_model(mud->scene,
-                           mud->world->roof_models[mud->last_plane_index][i]);
+    int show_roofs = 0;
 
-        if (mud->last_plane_index == 0) {
-            scene_remove_model(mud->scene, mud->world->wall_models[1][i]);
-            scene_remove_model(mud->scene, mud->world->roof_models[1][i]);
-            scene_remove_model(mud->scene, mud->world->wall_models[2][i]);
-            scene_remove_model(mud->scene, mud->world->roof_models[2][i]);
-        }
+    if (mud->options->show_roofs) {
+        mud->fog_of_war = 1;
 
-        if (mud->options->show_roofs) {
-            mud->fog_of_war = 1;
-
-            if (mud->last_plane_index == 0 &&
-                !world_is_under_roof(mud->world, mud->local_player->current_x,
-                                     mud->local_player->current_y)) {
-                scene_add_model(
-                    mud->scene,
-                    mud->world->roof_models[mud->last_plane_index][i]);
-
-                scene_add_model(mud->scene, mud->world->wall_models[1][i]);
-                scene_add_model(mud->scene, mud->world->roof_models[1][i]);
-                scene_add_model(mud->scene, mud->world->wall_models[2][i]);
-                scene_add_model(mud->scene, mud->world->roof_models[2][i]);
+        if (mud->last_plane_index == 0 &&
+            !world_is_under_roof(mud->world, mud->local_player->current_x,
+                                 mud->local_player->current_y)) {
+            show_roofs = 1;
+            mud->fog_of_war = 0;
+        }
+    }
 
-                mud->fog_of_war = 0;
+    /* adding and removing are no-ops unless the player walked under or out
+     * from a roof */
+    for (int i = 0; i < TERRAIN_COUNT; i++) {
+        if (show_roofs) {
+            scene_add_model(mud->scene,
+                            mud->world->roof_models[mud->last_plane_index][i]);
+
+            scene_add_model(mud->scene, mud->world->wall_models[1][i]);
+            scene_add_model(mud->scene, mud->world->roof_models[1][i]);
+            scene_add_model(mud->scene, mud->world->wall_models[2][i]);
+            scene_add_model(mud->scene, mud->world->roof_models[2][i]);
+        } else {
+            scene_remove_model(
+                mud->scene, mud->world->roof_models[mud->last_plane_index][i]);
+
+            if (mud->last_plane_index == 0) {
+                scene_remove_model(mud->scene, mud->world->wall_models[1][i]);
+                scene_remove_model(mud->scene, mud->world->roof_models[1][i]);
+                scene_remove_model(mud->scene, mud->world->wall_models[2][i]);
+                scene_remove_model(mud->scene, mud->world->roof_models[2][i]);
             }
         }
     }
@@ -4642,6 +4873,10 @@ void mudclient_draw_game(mudclient *mud) {
                             mud->surface->height - 22, FONT_BOLD_12, YELLOW);
     }
 
+    if (mud->options->display_profiler) {
+        mudclient_draw_profiler(mud);
+    }
+
 #ifndef REVISION_177
     if (mud->system_update != 0) {
         int seconds = mud->system_update / 50;
@@ -4696,7 +4931,10 @@ void mudclient_draw_game(mudclient *mud) {
     }
 
     mudclient_draw_chat_message_tabs_panel(mud);
+
+    profiler_begin(PROFILE_DRAW_UI);
     mudclient_draw_ui(mud);
+    profiler_end(PROFILE_DRAW_UI);
 
     mud->surface->draw_string_shadow = 0;
     mudclient_draw_chat_message_tabs(mud);
@@ -4710,6 +4948,8 @@ void mudclient_draw_game(mudclient *mud) {
     scene_gl_render_transparent_models(mud->scene);
 #endif
 
+    profiler_begin(PROFILE_SURFACE_DRAW);
+
 #if defined(RENDER_GL) || defined(RENDER_3DS_GL)
     surface_gl_draw(mud->surface, GL_DEPTH_ENABLED);
     surface_gl_reset_context(mud->surface);
@@ -4717,6 +4957,8 @@ void mudclient_draw_game(mudclient *mud) {
     surface_draw(mud->surface);
 #endif
 
+    profiler_end(PROFILE_SURFACE_DRAW);
+
 /*#if defined(_3DS) && defined(RENDER_SW)
     gfxFlushBuffers();
     gfxSwapBuffers();
@@ -4871,8 +5113,10 @@ void mudclient_run(mudclient *mud) {
 
     if (mud->loading_step == 1) {
         mud->loading_step = 2;
+        mudclient_queue_data_files(mud);
         mudclient_load_jagex(mud);
         mudclient_start_game(mud);
+        mudclient_free_data_files(mud);
         mud->loading_step = 0;
     }
 
@@ -4957,6 +5201,8 @@ void mudclient_run(mudclient *mud) {
 
         mudclient_draw(mud);
 
+        profiler_end_frame(mud->options->display_profiler);
+
         mud->fps = (j * 1000) / (mud->target_fps * 256);
 
         mud->mouse_scroll_delta = 0;
@@ -5309,6 +5555,8 @@ void mudclient_draw_item(mudclient *mud, int x, int y, int slot_width,
             game_data.items[certificate_item_id].mask, 0, 0, 0);
     }
 }
+/* replay-bench has its own main */
+#ifndef HEADLESS
 #ifdef WIN9X
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine,
                    int nCmdShow) {
@@ -5324,6 +5572,7 @@ int main(int argc, char **argv) {
 
     init_utility_global();
     init_surface_global();
+    init_scanline_global();
     init_world_global();
     /*init_packet_stream_global();*/
     init_stats_tab_global();
@@ -5368,6 +5617,7 @@ int main(int argc, char **argv) {
 
     mudclient_start_application(mud, "Runescape by Andrew Gower");
     mudclient_start_application_common(mud);
+    mudclient_run(mud);
 
 #ifdef DREAMCAST
     // Shutdown networking before exiting
@@ -5377,3 +5627,4 @@ int main(int argc, char **argv) {
 
     return 0;
 }
+#endif
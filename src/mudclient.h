@@ -277,6 +277,7 @@
 
 typedef struct mudclient mudclient;
 
+#include "archive-loader.h"
 #include "chat-message.h"
 #include "client-opcodes.h"
 #include "colours.h"
@@ -288,6 +289,7 @@ typedef struct mudclient mudclient;
 #include "packet-handler.h"
 #include "packet-stream.h"
 #include "panel.h"
+#include "profiler.h"
 #include "scene.h"
 #include "server-opcodes.h"
 #include "surface.h"
@@ -590,6 +592,9 @@ struct mudclient {
     char *loading_progess_text;
     int8_t error_loading_data;
 
+    /* unpacks archives in the background while loading, if enabled */
+    ArchiveLoader *archive_loader;
+
     int timings[10];
     int stop_timeout;
     int fps;
@@ -641,6 +646,10 @@ struct mudclient {
 
     PacketStream *packet_stream;
     uint64_t packet_last_read;
+
+    /* number of server packets handled in the last game tick */
+    int packets_per_frame;
+
     int8_t incoming_packet[PACKET_BUFFER_LENGTH];
 
     char username[USERNAME_LENGTH + 1];
@@ -1088,6 +1097,7 @@ struct mudclient {
 void mudclient_new(mudclient *mud);
 void mudclient_resize(mudclient *mud);
 void mudclient_start_application(mudclient *mud, char *title);
+void mudclient_start_application_common(mudclient *mud);
 
 void mudclient_handle_key_press(mudclient *mud, int key_code);
 void mudclient_key_pressed(mudclient *mud, int code, int char_code);
@@ -1103,6 +1113,8 @@ void mudclient_start(mudclient *mud);
 void mudclient_stop(mudclient *mud);
 
 void mudclient_draw_loading_progress(mudclient *mud, int percent, char *text);
+void mudclient_queue_data_files(mudclient *mud);
+void mudclient_free_data_files(mudclient *mud);
 int8_t *mudclient_read_data_file(mudclient *mud, char *file, char *description,
                                  int percent);
 void mudclient_load_jagex_tga_sprite(mudclient *mud, int8_t *buffer);
@@ -1161,6 +1173,9 @@ int mudclient_compare_text(const void *v1, const void *v2);
 void mudclient_draw_overhead(mudclient *mud);
 void mudclient_animate_objects(mudclient *mud);
 void mudclient_draw_entity_sprites(mudclient *mud);
+void mudclient_draw_profiler(mudclient *mud);
+void mudclient_toggle_trace(mudclient *mud);
+void mudclient_start_capture(mudclient *mud);
 void mudclient_draw_game(mudclient *mud);
 void mudclient_reset_game(mudclient *mud);
 void mudclient_login(mudclient *mud, char *username, char *password,
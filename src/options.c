@@ -24,6 +24,21 @@ void options_new(Options *options) {
     /* experimental */
     options->thick_walls = 0;
 
+    /* performance */
+    options->loader_threads = 4;
+    options->unpacked_cache = 1;
+    options->packet_batch_ms = 8;
+    options->network_thread = 0;
+    options->render_threads = 0;
+    options->region_prefetch = 1;
+    options->section_cache_kb = 1024;
+    options->tint_cache_kb = 2048;
+    options->rle_sprites = 1;
+    options->texture_slots_64 = 7;
+    options->texture_slots_128 = 11;
+    options->display_profiler = 0;
+    options->record_packets = 0;
+
 #ifdef VANILLA_IS_DEFAULT
     options_set_vanilla(options);
 #else
@@ -281,7 +296,20 @@ void options_save(Options *options) {
             options->bank_scroll,           //
             options->bank_menus,            //
             options->bank_inventory,        //
-            options->bank_maintain_slot     //
+            options->bank_maintain_slot,    //
+            options->loader_threads,        //
+            options->unpacked_cache,        //
+            options->packet_batch_ms,       //
+            options->network_thread,        //
+            options->render_threads,        //
+            options->region_prefetch,       //
+            options->section_cache_kb,      //
+            options->tint_cache_kb,         //
+            options->rle_sprites,           //
+            options->texture_slots_64,      //
+            options->texture_slots_128,     //
+            options->display_profiler,      //
+            options->record_packets         //
     );
 
 #ifdef ANDROID
@@ -391,5 +419,20 @@ void options_load(Options *options) {
     OPTION_INI_INT("bank_inventory", options->bank_inventory, 0, 1);
     OPTION_INI_INT("bank_maintain_slot", options->bank_maintain_slot, 0, 1);
 
+    /* performance */
+    OPTION_INI_INT("loader_threads", options->loader_threads, 0, 8);
+    OPTION_INI_INT("unpacked_cache", options->unpacked_cache, 0, 1);
+    OPTION_INI_INT("packet_batch_ms", options->packet_batch_ms, 0, 50);
+    OPTION_INI_INT("network_thread", options->network_thread, 0, 1);
+    OPTION_INI_INT("render_threads", options->render_threads, 0, 16);
+    OPTION_INI_INT("region_prefetch", options->region_prefetch, 0, 1);
+    OPTION_INI_INT("section_cache_kb", options->section_cache_kb, 0, 65536);
+    OPTION_INI_INT("tint_cache_kb", options->tint_cache_kb, 0, 65536);
+    OPTION_INI_INT("rle_sprites", options->rle_sprites, 0, 1);
+    OPTION_INI_INT("texture_slots_64", options->texture_slots_64, 1, 256);
+    OPTION_INI_INT("texture_slots_128", options->texture_slots_128, 1, 256);
+    OPTION_INI_INT("display_profiler", options->display_profiler, 0, 1);
+    OPTION_INI_INT("record_packets", options->record_packets, 0, 1);
+
     ini_free(options_ini);
 }
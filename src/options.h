@@ -146,7 +146,36 @@ typedef struct Options Options;
      "width\n"                                                                 \
      "bank_inventory = %d\n"                                                   \
      "; Maintain the selected bank slot when items change position\n"          \
-     "bank_maintain_slot = %d\n")
+     "bank_maintain_slot = %d\n\n"                                             \
+     "; Threads used to unpack cache archives at startup (0 to unpack them\n"  \
+     "; one at a time on the main thread)\n"                                   \
+     "loader_threads = %d\n"                                                   \
+     "; Keep unpacked copies of cache archives on disk to load faster\n"       \
+     "unpacked_cache = %d\n"                                                   \
+     "; Milliseconds per frame spent handling queued server packets (0 to\n"   \
+     "; handle one packet per frame)\n"                                        \
+     "packet_batch_ms = %d\n"                                                  \
+     "; Read the socket and decode packets on a separate thread\n"             \
+     "network_thread = %d\n"                                                   \
+     "; Extra threads used to draw the 3D scene with the software renderer\n"  \
+     "render_threads = %d\n"                                                   \
+     "; Decode the map sections ahead of the player on a separate thread\n"    \
+     "region_prefetch = %d\n"                                                  \
+     "; Kilobytes of decoded map sections to keep in memory\n"                 \
+     "section_cache_kb = %d\n"                                                 \
+     "; Kilobytes of recoloured player and NPC sprites to keep in memory\n"    \
+     "tint_cache_kb = %d\n"                                                    \
+     "; Store sprites as runs of their visible pixels to save memory\n"        \
+     "rle_sprites = %d\n"                                                      \
+     "; Number of 64x64 textures kept unpacked for drawing\n"                  \
+     "texture_slots_64 = %d\n"                                                 \
+     "; Number of 128x128 textures kept unpacked for drawing\n"                \
+     "texture_slots_128 = %d\n"                                                \
+     "; Show how long each part of the frame takes\n"                          \
+     "display_profiler = %d\n"                                                 \
+     "; Save the packets received after logging in to a capture file that\n"   \
+     "; make replay-bench can play back\n"                                     \
+     "record_packets = %d\n")
 
 #define OPTION_INI_STR(name, option, length)                                   \
     {                                                                          \
@@ -393,6 +422,48 @@ struct Options {
 
     /* move the keyboard button to the right */
     int touch_keyboard_right;
+
+    /* threads used to unpack cache archives at startup, 0 to unpack them one
+     * at a time on the main thread */
+    int loader_threads;
+
+    /* keep unpacked copies of cache archives on disk and map them on later
+     * runs */
+    int unpacked_cache;
+
+    /* milliseconds per frame spent handling queued server packets, 0 to handle
+     * one packet per frame */
+    int packet_batch_ms;
+
+    /* read the socket and decode packets on a separate thread */
+    int network_thread;
+
+    /* extra threads used to draw the 3d scene with the software renderer */
+    int render_threads;
+
+    /* decode the map sections ahead of the player on a separate thread */
+    int region_prefetch;
+
+    /* kilobytes of decoded map sections to keep in memory */
+    int section_cache_kb;
+
+    /* kilobytes of recoloured entity sprites to keep, 0 to disable */
+    int tint_cache_kb;
+
+    /* store sprites as runs of opaque pixels for the software renderer */
+    int rle_sprites;
+
+    /* 64x64 and 128x128 textures kept unpacked, the least recently drawn
+     * gives up its slot */
+    int texture_slots_64;
+    int texture_slots_128;
+
+    /* show the average time spent in each part of the frame */
+    int display_profiler;
+
+    /* write the packets received after logging in to a capture file for
+     * replay-bench */
+    int record_packets;
 };
 
 void options_new(Options *options);
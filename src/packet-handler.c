@@ -111,6 +111,8 @@ void mudclient_gl_update_wall_models(mudclient *mud) {
 void mudclient_packet_tick(mudclient *mud) {
     uint64_t timestamp = get_ticks();
 
+    packet_stream_next_tick(mud->packet_stream);
+
     if (packet_stream_has_packet(mud->packet_stream)) {
         mud->packet_last_read = timestamp;
     }
@@ -126,21 +128,33 @@ void mudclient_packet_tick(mudclient *mud) {
         return;
     }
 
-    int size =
-        packet_stream_read_packet(mud->packet_stream, mud->incoming_packet);
+    PacketStream *packet_stream = mud->packet_stream;
 
-    if (size <= 0) {
-        return;
-    }
+    mud->packets_per_frame = 0;
+
+    /* handle every packet that is already buffered, so bursts of updates
+     * (e.g. after a region load) apply together, until the time budget runs
+     * out. stop early if a packet logged us out or reconnected */
+    do {
+        int size =
+            packet_stream_read_packet(mud->packet_stream, mud->incoming_packet);
+
+        if (size <= 0) {
+            break;
+        }
 
+        mudclient_handle_packet(mud, size);
+        mud->packets_per_frame++;
+    } while (mud->options->packet_batch_ms > 0 && mud->logged_in &&
+             mud->packet_stream == packet_stream &&
+             (int)(get_ticks() - timestamp) < mud->options->packet_batch_ms);
+}
+
+void mudclient_handle_packet(mudclient *mud, int size) {
     int8_t *data = mud->incoming_packet;
-    ServerOpcode opcode = data[0] & 0xff;
 
-#ifndef NO_ISAAC
-    if (mud->packet_stream->isaac_ready) {
-        opcode = (opcode - isaac_next(&mud->packet_stream->isaac_in)) & 0xff;
-    }
-#endif
+    /* already decoded by packet_stream_frame_packet */
+    ServerOpcode opcode = data[0] & 0xff;
 
     switch (opcode) {
     case SERVER_WORLD_INFO:
@@ -15,5 +15,6 @@ void mudclient_update_ground_item_models(mudclient *mud);
 void mudclient_gl_update_wall_models(mudclient *mud);
 #endif
 void mudclient_packet_tick(mudclient *mud);
+void mudclient_handle_packet(mudclient *mud, int size);
 
 #endif
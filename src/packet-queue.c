@@ -0,0 +1,88 @@
+#include "packet-queue.h"
+
+static void packet_queue_write(PacketQueue *queue, uint32_t position,
+                               void *src, int length) {
+    int offset = position & (PACKET_QUEUE_LENGTH - 1);
+    int first_length = PACKET_QUEUE_LENGTH - offset;
+
+    if (first_length > length) {
+        first_length = length;
+    }
+
+    memcpy(queue->data + offset, src, first_length);
+
+    memcpy(queue->data, (int8_t *)src + first_length,
+           length - first_length);
+}
+
+static void packet_queue_read(PacketQueue *queue, uint32_t position,
+                              void *dest, int length) {
+    int offset = position & (PACKET_QUEUE_LENGTH - 1);
+    int first_length = PACKET_QUEUE_LENGTH - offset;
+
+    if (first_length > length) {
+        first_length = length;
+    }
+
+    memcpy(dest, queue->data + offset, first_length);
+
+    memcpy((int8_t *)dest + first_length, queue->data,
+           length - first_length);
+}
+
+void packet_queue_new(PacketQueue *queue) {
+    memset(queue, 0, sizeof(PacketQueue));
+}
+
+/* producer only */
+int packet_queue_free_length(PacketQueue *queue) {
+    uint32_t head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+
+    return PACKET_QUEUE_LENGTH - (int)(queue->tail - head);
+}
+
+/* producer only. returns 0 if there isn't room for the packet */
+int packet_queue_push(PacketQueue *queue, int8_t *packet, int length) {
+    if (packet_queue_free_length(queue) < length + PACKET_QUEUE_HEADER_LENGTH) {
+        return 0;
+    }
+
+    uint32_t tail = queue->tail;
+    int32_t header = length;
+
+    packet_queue_write(queue, tail, &header, PACKET_QUEUE_HEADER_LENGTH);
+    packet_queue_write(queue, tail + PACKET_QUEUE_HEADER_LENGTH, packet,
+                       length);
+
+    /* publish the packet only once its bytes are in place */
+    __atomic_store_n(&queue->tail, tail + PACKET_QUEUE_HEADER_LENGTH + length,
+                     __ATOMIC_RELEASE);
+
+    return 1;
+}
+
+/* consumer only. copies the next packet into buffer and returns its length,
+ * or 0 if the queue is empty. a packet longer than max_length is dropped
+ * rather than truncated and -1 is returned */
+int packet_queue_pop(PacketQueue *queue, int8_t *buffer, int max_length) {
+    uint32_t head = queue->head;
+    uint32_t tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+
+    if (head == tail) {
+        return 0;
+    }
+
+    int32_t length = 0;
+
+    packet_queue_read(queue, head, &length, PACKET_QUEUE_HEADER_LENGTH);
+
+    if (length <= max_length) {
+        packet_queue_read(queue, head + PACKET_QUEUE_HEADER_LENGTH, buffer,
+                          length);
+    }
+
+    __atomic_store_n(&queue->head, head + PACKET_QUEUE_HEADER_LENGTH + length,
+                     __ATOMIC_RELEASE);
+
+    return length <= max_length ? length : -1;
+}
@@ -0,0 +1,28 @@
+#ifndef _H_PACKET_QUEUE
+#define _H_PACKET_QUEUE
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* bytes of packet data a queue can hold. must be a power of two */
+#define PACKET_QUEUE_LENGTH 65536
+
+/* each packet is stored after a 4 byte length */
+#define PACKET_QUEUE_HEADER_LENGTH 4
+
+/* lock-free queue of packets between exactly one producer thread and one
+ * consumer thread. head is only written by the consumer and tail only by the
+ * producer, both count up forever and are masked when indexing data */
+typedef struct PacketQueue {
+    int8_t data[PACKET_QUEUE_LENGTH];
+    uint32_t head;
+    uint32_t tail;
+} PacketQueue;
+
+void packet_queue_new(PacketQueue *queue);
+int packet_queue_free_length(PacketQueue *queue);
+int packet_queue_push(PacketQueue *queue, int8_t *packet, int length);
+int packet_queue_pop(PacketQueue *queue, int8_t *buffer, int max_length);
+
+#endif
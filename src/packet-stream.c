@@ -282,104 +282,471 @@ void packet_stream_new(PacketStream *packet_stream, mudclient *mud) {
     packet_stream->packet_max_length = 5000;
 }
 
-int packet_stream_available_bytes(PacketStream *packet_stream, int length) {
-    if (packet_stream->available_length >= length) {
-        return 1;
+/* read packets from a file written by packet_stream_start_capture instead of
+ * a server. each one is handed out once packet_stream_next_tick reaches the
+ * tick it was recorded on, so a replay handles the same packets on the same
+ * game ticks regardless of how long the frames take */
+int packet_stream_new_replay(PacketStream *packet_stream, const char *path) {
+    memset(packet_stream, 0, sizeof(PacketStream));
+
+    packet_stream->socket = -1;
+    packet_stream->closed = 1;
+
+    FILE *replay_file = fopen(path, "rb");
+
+    if (replay_file == NULL) {
+        mud_error("unable to open %s\n", path);
+        return 0;
+    }
+
+    fseek(replay_file, 0, SEEK_END);
+    long length = ftell(replay_file);
+    fseek(replay_file, 0, SEEK_SET);
+
+    packet_stream->replay = malloc(length > 0 ? length : 1);
+
+    size_t read_length =
+        length > 0 ? fread(packet_stream->replay, 1, length, replay_file) : 0;
+
+    if (length < 0 || read_length != (size_t)length) {
+        mud_error("unable to read %s\n", path);
+
+        fclose(replay_file);
+        free(packet_stream->replay);
+        packet_stream->replay = NULL;
+
+        return 0;
     }
 
-    int bytes =
-        recv(packet_stream->socket,
-             packet_stream->available_buffer + packet_stream->available_offset +
-                 packet_stream->available_length,
-             length - packet_stream->available_length, 0);
+    fclose(replay_file);
+
+    packet_stream->replay_length = (int)length;
+
+    /* quiet stretches of a capture aren't a time-out */
+    packet_stream->max_read_tries = 0;
+
+    packet_stream->closed = 0;
+    packet_stream->packet_end = 3;
+    packet_stream->packet_max_length = 5000;
+
+    return 1;
+}
 
-    if (bytes < 0) {
-        bytes = 0;
+/* write every packet read from now on to path, for replaying later */
+int packet_stream_start_capture(PacketStream *packet_stream, const char *path) {
+    if (packet_stream->capture != NULL) {
+        return 0;
     }
 
-    packet_stream->available_length += bytes;
+    packet_stream->capture = fopen(path, "wb");
 
-    if (packet_stream->available_length < length) {
+    if (packet_stream->capture == NULL) {
+        mud_error("unable to open %s for writing\n", path);
         return 0;
     }
 
+    packet_stream->capture_tick = packet_stream->tick;
+
     return 1;
 }
 
-int packet_stream_read_bytes(PacketStream *packet_stream, int length,
-                             int8_t *buffer) {
-    if (packet_stream->closed) {
+void packet_stream_stop_capture(PacketStream *packet_stream) {
+    if (packet_stream->capture == NULL) {
+        return;
+    }
+
+    fclose(packet_stream->capture);
+    packet_stream->capture = NULL;
+}
+
+void packet_stream_next_tick(PacketStream *packet_stream) {
+    packet_stream->tick++;
+}
+
+static void packet_stream_capture_packet(PacketStream *packet_stream,
+                                         int8_t *buffer, int length) {
+    int8_t header[PACKET_CAPTURE_HEADER_LENGTH] = {0};
+
+    write_unsigned_int(header, 0,
+                       packet_stream->tick - packet_stream->capture_tick);
+
+    header[4] = (int8_t)(length >> 8);
+    header[5] = (int8_t)length;
+
+    if (fwrite(header, 1, sizeof(header), packet_stream->capture) !=
+            sizeof(header) ||
+        fwrite(buffer, 1, length, packet_stream->capture) != (size_t)length) {
+        mud_error("unable to write packet capture\n");
+        packet_stream_stop_capture(packet_stream);
+    }
+}
+
+static int packet_stream_replay_packet(PacketStream *packet_stream,
+                                       int8_t *buffer) {
+    int offset = packet_stream->replay_offset;
+    int remaining = packet_stream->replay_length - offset;
+
+    if (remaining < PACKET_CAPTURE_HEADER_LENGTH) {
+        return 0;
+    }
+
+    int8_t *header = packet_stream->replay + offset;
+
+    int tick = get_unsigned_int(header, 0, remaining);
+
+    if (tick > packet_stream->tick) {
+        return 0;
+    }
+
+    int length = get_unsigned_short(header, 4, remaining);
+
+    if (length == 0 || length > PACKET_BUFFER_LENGTH ||
+        length > remaining - PACKET_CAPTURE_HEADER_LENGTH) {
+        mud_error("truncated packet capture at offset %d\n", offset);
+        packet_stream->replay_offset = packet_stream->replay_length;
+        return 0;
+    }
+
+    memcpy(buffer, header + PACKET_CAPTURE_HEADER_LENGTH, length);
+
+    packet_stream->replay_offset += PACKET_CAPTURE_HEADER_LENGTH + length;
+
+    return length;
+}
+
+/* whether a failed socket call only had nothing to do yet. result is what
+ * the call returned */
+static int packet_stream_would_block(int result) {
+#ifdef WIN32
+    (void)result;
+
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#elif defined(WII)
+    /* net_ calls return the negated error rather than setting errno */
+    return result == -EAGAIN || result == -EWOULDBLOCK;
+#else
+    (void)result;
+
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+/* move everything the socket has ready into the receive buffer. this is
+ * normally a single recv, with a second one when the free space wraps
+ * around the end of the buffer */
+int packet_stream_receive(PacketStream *packet_stream) {
+    if (__atomic_load_n(&packet_stream->closed, __ATOMIC_ACQUIRE)) {
         return -1;
     }
 
-    if (packet_stream->available_length > 0) {
-        int copy_length;
+    while (packet_stream->receive_length < PACKET_RECEIVE_BUFFER_LENGTH) {
+        int end =
+            (packet_stream->receive_start + packet_stream->receive_length) &
+            (PACKET_RECEIVE_BUFFER_LENGTH - 1);
 
-        if (length > packet_stream->available_length) {
-            copy_length = packet_stream->available_length;
-        } else {
-            copy_length = length;
+        int free_length =
+            PACKET_RECEIVE_BUFFER_LENGTH - packet_stream->receive_length;
+
+        if (end + free_length > PACKET_RECEIVE_BUFFER_LENGTH) {
+            free_length = PACKET_RECEIVE_BUFFER_LENGTH - end;
         }
 
-        memcpy(buffer,
-               packet_stream->available_buffer +
-                   packet_stream->available_offset,
-               copy_length);
+        int bytes = recv(packet_stream->socket,
+                         packet_stream->receive_buffer + end, free_length, 0);
+
+        /* a hard error won't clear up, so don't wait out the read timeout */
+        if (bytes == 0 || (bytes < 0 && !packet_stream_would_block(bytes))) {
+            /* read by the game thread while the network thread receives */
+            __atomic_store_n(&packet_stream->closed, 1, __ATOMIC_RELEASE);
+            return -1;
+        }
 
-        length -= copy_length;
+        if (bytes < 0) {
+            /* nothing left to read */
+            break;
+        }
 
-        packet_stream->available_length -= copy_length;
+        packet_stream->receive_length += bytes;
 
-        if (packet_stream->available_length == 0) {
-            packet_stream->available_offset = 0;
-        } else {
-            packet_stream->available_offset += copy_length;
+        if (bytes < free_length) {
+            break;
         }
     }
 
-    /* how many ticks we've been waiting to read for */
-    int read_duration = 0;
+    return 0;
+}
+
+/* block until the socket is readable or timeout (ms) runs out */
+static void packet_stream_wait_readable(PacketStream *packet_stream,
+                                        int timeout) {
+#ifdef EMSCRIPTEN
+    (void)packet_stream;
+    (void)timeout;
 
-    int offset = 0;
+    delay_ticks(1);
+#else
+    struct timeval time = {0};
+    time.tv_sec = timeout / 1000;
+    time.tv_usec = (timeout % 1000) * 1000;
 
-    while (length > 0) {
-        int bytes = recv(packet_stream->socket, buffer + offset, length, 0);
-        if (bytes > 0) {
-            length -= bytes;
-            offset += bytes;
-        } else if (bytes == 0) {
-            packet_stream->closed = 1;
-            return -1;
-        } else {
-            read_duration += 1;
+    fd_set read_fds;
+    FD_ZERO(&read_fds);
+    FD_SET(packet_stream->socket, &read_fds);
+
+    select(packet_stream->socket + 1, &read_fds, NULL, NULL, &time);
+#endif
+}
+
+static int packet_stream_peek_byte(PacketStream *packet_stream, int offset) {
+    return (uint8_t)packet_stream->receive_buffer
+        [(packet_stream->receive_start + offset) &
+         (PACKET_RECEIVE_BUFFER_LENGTH - 1)];
+}
+
+/* copy length buffered bytes out of the receive buffer and discard them */
+static void packet_stream_take_bytes(PacketStream *packet_stream, int length,
+                                     int8_t *buffer) {
+    int first_length =
+        PACKET_RECEIVE_BUFFER_LENGTH - packet_stream->receive_start;
+
+    if (first_length > length) {
+        first_length = length;
+    }
+
+    memcpy(buffer, packet_stream->receive_buffer + packet_stream->receive_start,
+           first_length);
+
+    memcpy(buffer + first_length, packet_stream->receive_buffer,
+           length - first_length);
+
+    packet_stream->receive_start = (packet_stream->receive_start + length) &
+                                   (PACKET_RECEIVE_BUFFER_LENGTH - 1);
+
+    packet_stream->receive_length -= length;
+}
+
+int packet_stream_available_bytes(PacketStream *packet_stream, int length) {
+    if (packet_stream->receive_length >= length) {
+        return 1;
+    }
+
+    packet_stream_receive(packet_stream);
+
+    return packet_stream->receive_length >= length;
+}
+
+int packet_stream_read_bytes(PacketStream *packet_stream, int length,
+                             int8_t *buffer) {
+    if (packet_stream->receive_length < length) {
+        int start = get_ticks();
 
-            if (read_duration >= 5000) {
+        for (;;) {
+            if (packet_stream_receive(packet_stream) < 0) {
+                return -1;
+            }
+
+            if (packet_stream->receive_length >= length) {
+                break;
+            }
+
+            int remaining = PACKET_READ_TIMEOUT - (get_ticks() - start);
+
+            if (remaining <= 0) {
                 packet_stream_close(packet_stream);
                 return -1;
-            } else {
-                delay_ticks(1);
             }
+
+            packet_stream_wait_readable(packet_stream, remaining);
         }
     }
 
+    packet_stream_take_bytes(packet_stream, length, buffer);
+
     return 0;
 }
 
-int packet_stream_write_bytes(PacketStream *packet_stream, int8_t *buffer,
-                              int offset, int length) {
-    if (!packet_stream->closed) {
+static int packet_stream_send(PacketStream *packet_stream, int8_t *buffer,
+                              int length) {
 #if defined(WIN32) || defined(__SWITCH__)
-        return send(packet_stream->socket, buffer + offset, length, 0);
+    return send(packet_stream->socket, buffer, length, 0);
 #else
-        return write(packet_stream->socket, buffer + offset, length);
+    return write(packet_stream->socket, buffer, length);
 #endif
+}
+
+#ifdef PACKET_STREAM_THREADED
+/* write everything queued by the game thread to the socket */
+static int packet_stream_thread_send(PacketStream *packet_stream) {
+    int length = 0;
+
+    while ((length = packet_queue_pop(packet_stream->outgoing_queue,
+                                      packet_stream->thread_buffer,
+                                      PACKET_RECEIVE_BUFFER_LENGTH)) != 0) {
+        if (length < 0) {
+            mud_error("outgoing packet too long, closing connection\n");
+            return -1;
+        }
+
+        int offset = 0;
+
+        while (offset < length) {
+            int bytes = packet_stream_send(
+                packet_stream, packet_stream->thread_buffer + offset,
+                length - offset);
+
+            if (bytes > 0) {
+                offset += bytes;
+            } else if (bytes < 0 && packet_stream_would_block(bytes)) {
+                delay_ticks(1);
+            } else {
+                return -1;
+            }
+        }
     }
 
-    return -1;
+    return 0;
+}
+
+static int packet_stream_thread(void *data) {
+    PacketStream *packet_stream = data;
+
+    while (!__atomic_load_n(&packet_stream->thread_stop, __ATOMIC_ACQUIRE)) {
+        if (packet_stream_thread_send(packet_stream) < 0) {
+            break;
+        }
+
+        if (packet_queue_free_length(packet_stream->incoming_queue) <
+            PACKET_RECEIVE_BUFFER_LENGTH + PACKET_QUEUE_HEADER_LENGTH) {
+            delay_ticks(PACKET_THREAD_POLL_MS);
+        } else {
+            packet_stream_wait_readable(packet_stream, PACKET_THREAD_POLL_MS);
+        }
+
+        if (packet_stream_receive(packet_stream) < 0) {
+            break;
+        }
+
+        /* leave packets in the receive buffer while the game thread is
+         * behind, rather than dropping them */
+        while (packet_queue_free_length(packet_stream->incoming_queue) >=
+               PACKET_RECEIVE_BUFFER_LENGTH + PACKET_QUEUE_HEADER_LENGTH) {
+            int length = packet_stream_frame_packet(
+                packet_stream, packet_stream->thread_buffer);
+
+            if (length <= 0) {
+                break;
+            }
+
+            packet_queue_push(packet_stream->incoming_queue,
+                              packet_stream->thread_buffer, length);
+        }
+    }
+
+    /* send what the game thread queued before it asked to stop, such as the
+     * logout packet */
+    if (__atomic_load_n(&packet_stream->thread_stop, __ATOMIC_ACQUIRE) &&
+        !__atomic_load_n(&packet_stream->closed, __ATOMIC_ACQUIRE)) {
+        packet_stream_thread_send(packet_stream);
+    }
+
+    __atomic_store_n(&packet_stream->closed, 1, __ATOMIC_RELEASE);
+
+    return 0;
+}
+#endif
+
+/* hand the socket over to a network thread once logged in, so reading it no
+ * longer waits on the game loop */
+void packet_stream_start_thread(PacketStream *packet_stream) {
+#ifdef PACKET_STREAM_THREADED
+    if (packet_stream->thread != NULL ||
+        __atomic_load_n(&packet_stream->closed, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+
+    packet_stream->incoming_queue = malloc(sizeof(PacketQueue));
+    packet_stream->outgoing_queue = malloc(sizeof(PacketQueue));
+    packet_stream->thread_buffer = malloc(PACKET_RECEIVE_BUFFER_LENGTH);
+
+    packet_queue_new(packet_stream->incoming_queue);
+    packet_queue_new(packet_stream->outgoing_queue);
+
+    packet_stream->thread_stop = 0;
+
+#ifdef SDL12
+    packet_stream->thread =
+        SDL_CreateThread(packet_stream_thread, packet_stream);
+#else
+    packet_stream->thread =
+        SDL_CreateThread(packet_stream_thread, "packet_stream", packet_stream);
+#endif
+
+    if (packet_stream->thread == NULL) {
+        mud_error("unable to create network thread: %s\n", SDL_GetError());
+        packet_stream_stop_thread(packet_stream);
+    }
+#else
+    (void)packet_stream;
+#endif
+}
+
+/* must be called before the packet stream is freed */
+void packet_stream_stop_thread(PacketStream *packet_stream) {
+#ifdef PACKET_STREAM_THREADED
+    if (packet_stream->thread != NULL) {
+        __atomic_store_n(&packet_stream->thread_stop, 1, __ATOMIC_RELEASE);
+        SDL_WaitThread(packet_stream->thread, NULL);
+        packet_stream->thread = NULL;
+    }
+
+    free(packet_stream->incoming_queue);
+    packet_stream->incoming_queue = NULL;
+
+    free(packet_stream->outgoing_queue);
+    packet_stream->outgoing_queue = NULL;
+
+    free(packet_stream->thread_buffer);
+    packet_stream->thread_buffer = NULL;
+#else
+    (void)packet_stream;
+#endif
+}
+
+int packet_stream_write_bytes(PacketStream *packet_stream, int8_t *buffer,
+                              int offset, int length) {
+    if (__atomic_load_n(&packet_stream->closed, __ATOMIC_ACQUIRE)) {
+        return -1;
+    }
+
+    if (packet_stream->replay != NULL) {
+        return length;
+    }
+
+#ifdef PACKET_STREAM_THREADED
+    if (packet_stream->thread != NULL) {
+        /* the network thread drains the queue every few ms, so only a
+         * stalled socket keeps it full for long */
+        int start = get_ticks();
+
+        while (!packet_queue_push(packet_stream->outgoing_queue,
+                                  buffer + offset, length)) {
+            if (__atomic_load_n(&packet_stream->closed, __ATOMIC_ACQUIRE) ||
+                get_ticks() - start >= PACKET_READ_TIMEOUT) {
+                return -1;
+            }
+
+            delay_ticks(1);
+        }
+
+        return length;
+    }
+#endif
+
+    return packet_stream_send(packet_stream, buffer + offset, length);
 }
 
 int packet_stream_read_byte(PacketStream *packet_stream) {
-    if (packet_stream->closed) {
+    if (__atomic_load_n(&packet_stream->closed, __ATOMIC_ACQUIRE)) {
         return -1;
     }
 
@@ -408,39 +775,84 @@ int packet_stream_read_packet(PacketStream *packet_stream, int8_t *buffer) {
         return 0;
     }
 
+    int length = 0;
+
+    if (packet_stream->replay != NULL) {
+        length = packet_stream_replay_packet(packet_stream, buffer);
+#ifdef PACKET_STREAM_THREADED
+    } else if (packet_stream->thread != NULL) {
+        length = packet_queue_pop(packet_stream->incoming_queue, buffer,
+                                  PACKET_BUFFER_LENGTH);
+
+        if (length < 0) {
+            packet_stream->socket_exception = 1;
+            packet_stream->socket_exception_message = "packet too long";
+            return 0;
+        }
+#endif
+    } else {
+        length = packet_stream_frame_packet(packet_stream, buffer);
+    }
+
+    if (length > 0) {
+        packet_stream->read_tries = 0;
+
+        if (packet_stream->capture != NULL) {
+            packet_stream_capture_packet(packet_stream, buffer, length);
+        }
+    }
+
+    return length;
+}
+
+/* split the next complete packet off the receive buffer and decode its
+ * opcode. framing only looks at what is already buffered, so this never
+ * waits on the socket */
+int packet_stream_frame_packet(PacketStream *packet_stream, int8_t *buffer) {
     if (packet_stream->length == 0 &&
         packet_stream_available_bytes(packet_stream, 2)) {
-        packet_stream->length = packet_stream_read_byte(packet_stream);
+        int length = packet_stream_peek_byte(packet_stream, 0);
+        int header_length = 1;
 
-        if (packet_stream->length >= 160) {
-            packet_stream->length = (packet_stream->length - 160) * 256 +
-                                    (packet_stream_read_byte(packet_stream));
+        if (length >= 160) {
+            length = (length - 160) * 256 +
+                     packet_stream_peek_byte(packet_stream, 1);
+
+            header_length = 2;
         }
+
+        packet_stream->receive_start =
+            (packet_stream->receive_start + header_length) &
+            (PACKET_RECEIVE_BUFFER_LENGTH - 1);
+
+        packet_stream->receive_length -= header_length;
+        packet_stream->length = length;
     }
 
     if (packet_stream->length > 0 &&
         packet_stream_available_bytes(packet_stream, packet_stream->length)) {
         if (packet_stream->length >= 160) {
-            if (packet_stream_read_bytes(packet_stream, packet_stream->length,
-                                         buffer) < 0) {
-                return 0;
-            }
+            packet_stream_take_bytes(packet_stream, packet_stream->length,
+                                     buffer);
         } else {
-            buffer[packet_stream->length - 1] =
-                packet_stream_read_byte(packet_stream);
+            /* short packets send their last byte first */
+            packet_stream_take_bytes(packet_stream, 1,
+                                     buffer + packet_stream->length - 1);
 
-            if (packet_stream->length > 1) {
-                if (packet_stream_read_bytes(
-                        packet_stream, packet_stream->length - 1, buffer) < 0) {
-                    return 0;
-                }
-            }
+            packet_stream_take_bytes(packet_stream, packet_stream->length - 1,
+                                     buffer);
         }
 
+#ifndef NO_ISAAC
+        if (packet_stream->isaac_ready) {
+            buffer[0] = (buffer[0] - isaac_next(&packet_stream->isaac_in)) &
+                        0xff;
+        }
+#endif
+
         int i = packet_stream->length;
 
         packet_stream->length = 0;
-        packet_stream->read_tries = 0;
 
         return i;
     }
@@ -749,6 +1161,12 @@ int64_t packet_stream_get_long(PacketStream *packet_stream) {
 }
 
 void packet_stream_close(PacketStream *packet_stream) {
+    packet_stream_stop_thread(packet_stream);
+    packet_stream_stop_capture(packet_stream);
+
+    free(packet_stream->replay);
+    packet_stream->replay = NULL;
+
     if (packet_stream->socket > -1) {
         close(packet_stream->socket);
         packet_stream->socket = -1;
@@ -41,11 +41,30 @@
 #define HAVE_SIGNALS
 #endif
 
+#if !defined(WII) && !defined(_3DS) && !defined(EMSCRIPTEN)
+#define PACKET_STREAM_THREADED
+#endif
+
 #define USERNAME_LENGTH 20
 #define PASSWORD_LENGTH 20
 
 #define PACKET_BUFFER_LENGTH 5000
 
+/* incoming data is kept in a ring buffer, large enough to hold the biggest
+ * packet the two byte length header can describe. must be a power of two */
+#define PACKET_RECEIVE_BUFFER_LENGTH 32768
+
+/* how long a blocking read waits for data before closing the socket */
+#define PACKET_READ_TIMEOUT 5000
+
+/* longest the network thread waits on the socket before checking for
+ * outgoing data */
+#define PACKET_THREAD_POLL_MS 2
+
+/* each packet in a capture file is preceded by the tick it was handled on
+ * (4 bytes) and its length (2 bytes) */
+#define PACKET_CAPTURE_HEADER_LENGTH 6
+
 /*extern char *SPOOKY_THREAT;
 extern int THREAT_LENGTH;
 
@@ -56,6 +75,7 @@ int get_client_opcode_friend(int opcode);*/
 typedef struct PacketStream PacketStream;
 
 #include "mudclient.h"
+#include "packet-queue.h"
 #include "utility.h"
 
 #ifdef REVISION_177
@@ -75,9 +95,11 @@ struct PacketStream {
     int read_tries;
     int socket_exception;
     char *socket_exception_message;
-    int8_t available_buffer[PACKET_BUFFER_LENGTH];
-    int available_length;
-    int available_offset;
+
+    /* bytes received but not yet read, starting at receive_start */
+    int8_t receive_buffer[PACKET_RECEIVE_BUFFER_LENGTH];
+    int receive_start;
+    int receive_length;
 
 #ifndef NO_RSA
     struct rsa rsa;
@@ -89,6 +111,31 @@ struct PacketStream {
     int isaac_ready;
 #endif
 
+#ifdef PACKET_STREAM_THREADED
+    /* while running, the network thread owns the socket and the receive
+     * buffer. it frames incoming packets into incoming_queue and writes
+     * whatever is pushed onto outgoing_queue */
+    SDL_Thread *thread;
+    int thread_stop;
+    PacketQueue *incoming_queue;
+    PacketQueue *outgoing_queue;
+    int8_t *thread_buffer;
+#endif
+
+    /* counts calls to packet_stream_next_tick, once per game tick */
+    int tick;
+
+    /* decoded packets are written here as they're read, stamped with the
+     * tick relative to capture_tick */
+    FILE *capture;
+    int capture_tick;
+
+    /* when set, packets are read from a capture instead of the socket and
+     * anything written is dropped */
+    int8_t *replay;
+    int replay_length;
+    int replay_offset;
+
 #ifdef REVISION_177
     /*int decode_key;
     int decode_threat_index;
@@ -101,6 +148,13 @@ struct PacketStream {
 };
 
 void packet_stream_new(PacketStream *packet_stream, mudclient *mud);
+int packet_stream_new_replay(PacketStream *packet_stream, const char *path);
+int packet_stream_start_capture(PacketStream *packet_stream, const char *path);
+void packet_stream_stop_capture(PacketStream *packet_stream);
+void packet_stream_next_tick(PacketStream *packet_stream);
+void packet_stream_start_thread(PacketStream *packet_stream);
+void packet_stream_stop_thread(PacketStream *packet_stream);
+int packet_stream_receive(PacketStream *packet_stream);
 int packet_stream_available_bytes(PacketStream *packet_stream, int length);
 int packet_stream_read_bytes(PacketStream *packet_stream, int length,
                              int8_t *buffer);
@@ -108,6 +162,7 @@ int packet_stream_write_bytes(PacketStream *packet_stream, int8_t *buffer,
                               int offset, int length);
 int packet_stream_read_byte(PacketStream *packet_stream);
 int packet_stream_has_packet(PacketStream *packet_stream);
+int packet_stream_frame_packet(PacketStream *packet_stream, int8_t *buffer);
 int packet_stream_read_packet(PacketStream *packet_stream, int8_t *buffer);
 void packet_stream_new_packet(PacketStream *packet_stream, ClientOpcode opcode);
 /*int packet_stream_decode_opcode(PacketStream *packet_stream, int opcode);*/
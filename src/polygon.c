@@ -5,3 +5,57 @@ void polygon_new(GamePolygon *polygon) {
     polygon->visited = 0;
     polygon->index2 = -1;
 }
+
+/* sort polygons furthest first with a two pass radix sort on depth. each key
+ * packs the depth above the polygon's index so the passes only move 32-bit
+ * integers around, and polygons are gathered once at the end. polygons at the
+ * same depth keep their order. keys needs space for count * 2 entries and
+ * scratch for count */
+void polygon_depth_sort(GamePolygon **polygons, int count, uint32_t *keys,
+                        GamePolygon **scratch) {
+    uint32_t *keys_in = keys;
+    uint32_t *keys_out = keys + count;
+
+    int low_offsets[256] = {0};
+    int high_offsets[256] = {0};
+
+    for (int i = 0; i < count; i++) {
+        /* flip the sign bit so signed depths order as unsigned, then invert
+         * so the furthest (largest) depth comes first */
+        uint32_t depth = ~((uint16_t)polygons[i]->depth ^ 0x8000) & 0xffff;
+
+        keys_in[i] = (depth << 16) | i;
+        low_offsets[depth & 0xff]++;
+        high_offsets[depth >> 8]++;
+
+        scratch[i] = polygons[i];
+    }
+
+    int low_total = 0;
+    int high_total = 0;
+
+    for (int i = 0; i < 256; i++) {
+        int low_count = low_offsets[i];
+        int high_count = high_offsets[i];
+
+        low_offsets[i] = low_total;
+        high_offsets[i] = high_total;
+
+        low_total += low_count;
+        high_total += high_count;
+    }
+
+    for (int i = 0; i < count; i++) {
+        uint32_t key = keys_in[i];
+        keys_out[low_offsets[(key >> 16) & 0xff]++] = key;
+    }
+
+    for (int i = 0; i < count; i++) {
+        uint32_t key = keys_out[i];
+        keys_in[high_offsets[key >> 24]++] = key;
+    }
+
+    for (int i = 0; i < count; i++) {
+        polygons[i] = scratch[keys_in[i] & 0xffff];
+    }
+}
@@ -1,6 +1,9 @@
 #ifndef _H_POLYGON
 #define _H_POLYGON
 
+/* polygon indices are packed into the low bits of the depth sort keys */
+#define POLYGON_DEPTH_SORT_MAX 65536
+
 typedef struct GamePolygon GamePolygon;
 
 #include "game-model.h"
@@ -26,5 +29,7 @@ struct GamePolygon {
 };
 
 void polygon_new(GamePolygon *polygon);
+void polygon_depth_sort(GamePolygon **polygons, int count, uint32_t *keys,
+                        GamePolygon **scratch);
 
 #endif
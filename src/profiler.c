@@ -0,0 +1,143 @@
+#include "profiler.h"
+
+Profiler profiler = {0};
+
+const char *profile_scope_names[PROFILE_SCOPE_COUNT] = {
+    "packet tick",  "game input", "scene project", "scene sort",
+    "scene raster", "draw ui",    "surface draw",  "frame"};
+
+static void profiler_flush_trace(void) {
+    for (int i = 0; i < profiler.trace_event_count; i++) {
+        ProfilerEvent *event = &profiler.trace_events[i];
+
+        fprintf(profiler.trace,
+                "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%d,"
+                "\"pid\":1,\"tid\":1}",
+                profiler.trace_event_total == 0 ? "" : ",\n",
+                profile_scope_names[event->scope],
+                (long long)(event->start - profiler.trace_start),
+                (int)event->duration);
+
+        profiler.trace_event_total++;
+    }
+
+    profiler.trace_event_count = 0;
+}
+
+static void profiler_add_event(PROFILE_SCOPE scope, int64_t start,
+                               int32_t duration) {
+    profiler.history[profiler.frame_index][scope] += duration;
+
+    /* the first frame of a trace may have started before it */
+    if (profiler.trace == NULL || start < profiler.trace_start) {
+        return;
+    }
+
+    if (profiler.trace_event_count == PROFILER_TRACE_EVENTS) {
+        profiler_flush_trace();
+    }
+
+    ProfilerEvent *event = &profiler.trace_events[profiler.trace_event_count++];
+
+    event->start = start;
+    event->duration = duration;
+    event->scope = scope;
+}
+
+void profiler_begin(PROFILE_SCOPE scope) {
+    if (!profiler.enabled) {
+        return;
+    }
+
+    profiler.started[scope] = get_ticks_us();
+}
+
+void profiler_end(PROFILE_SCOPE scope) {
+    if (!profiler.enabled) {
+        return;
+    }
+
+    int64_t start = profiler.started[scope];
+
+    profiler_add_event(scope, start, (int32_t)(get_ticks_us() - start));
+}
+
+/* called once the frame has been drawn. overlay is whether the averages are
+ * being shown, otherwise scopes are only timed while a trace is open */
+void profiler_end_frame(int overlay) {
+    int64_t time = get_ticks_us();
+
+    if (profiler.enabled) {
+        profiler_add_event(PROFILE_FRAME, profiler.frame_start,
+                           (int32_t)(time - profiler.frame_start));
+    }
+
+    int was_enabled = profiler.enabled;
+
+    profiler.enabled = overlay || profiler.trace != NULL;
+    profiler.frame_start = time;
+
+    if (profiler.enabled && !was_enabled) {
+        memset(profiler.history, 0, sizeof(profiler.history));
+    }
+
+    profiler.frame_index = (profiler.frame_index + 1) % PROFILER_FRAMES;
+
+    memset(profiler.history[profiler.frame_index], 0,
+           sizeof(profiler.history[profiler.frame_index]));
+}
+
+/* average microseconds per frame */
+int profiler_average(PROFILE_SCOPE scope) {
+    int64_t total = 0;
+
+    for (int i = 0; i < PROFILER_FRAMES; i++) {
+        if (i != profiler.frame_index) {
+            total += profiler.history[i][scope];
+        }
+    }
+
+    return (int)(total / (PROFILER_FRAMES - 1));
+}
+
+int profiler_start_trace(const char *path) {
+    if (profiler.trace != NULL) {
+        return 0;
+    }
+
+    profiler.trace = fopen(path, "w");
+
+    if (profiler.trace == NULL) {
+        mud_error("unable to open %s for writing\n", path);
+        return 0;
+    }
+
+    /* finish the file if the client is closed while tracing */
+    static int registered = 0;
+
+    if (!registered) {
+        atexit(profiler_stop_trace);
+        registered = 1;
+    }
+
+    fputs("{\"traceEvents\":[\n", profiler.trace);
+
+    profiler.trace_start = get_ticks_us();
+    profiler.trace_event_total = 0;
+    profiler.trace_event_count = 0;
+
+    return 1;
+}
+
+void profiler_stop_trace(void) {
+    if (profiler.trace == NULL) {
+        return;
+    }
+
+    profiler_flush_trace();
+
+    fputs("\n]}\n", profiler.trace);
+    fclose(profiler.trace);
+
+    profiler.trace = NULL;
+}
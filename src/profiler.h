@@ -0,0 +1,67 @@
+#ifndef _H_PROFILER
+#define _H_PROFILER
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* frames averaged for the overlay */
+#define PROFILER_FRAMES 32
+
+/* trace events held in memory before they're written out */
+#define PROFILER_TRACE_EVENTS 4096
+
+typedef enum {
+    PROFILE_PACKET_TICK = 0,
+    PROFILE_GAME_INPUT = 1,
+    PROFILE_SCENE_PROJECT = 2,
+    PROFILE_SCENE_SORT = 3,
+    PROFILE_SCENE_RASTER = 4,
+    PROFILE_DRAW_UI = 5,
+    PROFILE_SURFACE_DRAW = 6,
+    PROFILE_FRAME = 7
+} PROFILE_SCOPE;
+
+#define PROFILE_SCOPE_COUNT 8
+
+typedef struct ProfilerEvent {
+    int64_t start;
+    int32_t duration;
+    int8_t scope;
+} ProfilerEvent;
+
+#include "utility.h"
+
+/* times parts of each frame in microseconds on the main thread, for the
+ * overlay and for traces that can be loaded in chrome://tracing or perfetto.
+ * scopes may run more than once a frame and are added together */
+typedef struct Profiler {
+    /* scopes are only timed while the overlay is shown or a trace is open */
+    int enabled;
+
+    int64_t started[PROFILE_SCOPE_COUNT];
+    int64_t frame_start;
+
+    /* microseconds spent in each scope over the last PROFILER_FRAMES */
+    int32_t history[PROFILER_FRAMES][PROFILE_SCOPE_COUNT];
+    int frame_index;
+
+    FILE *trace;
+    int64_t trace_start;
+    int trace_event_total;
+    ProfilerEvent trace_events[PROFILER_TRACE_EVENTS];
+    int trace_event_count;
+} Profiler;
+
+extern Profiler profiler;
+extern const char *profile_scope_names[PROFILE_SCOPE_COUNT];
+
+void profiler_begin(PROFILE_SCOPE scope);
+void profiler_end(PROFILE_SCOPE scope);
+void profiler_end_frame(int overlay);
+int profiler_average(PROFILE_SCOPE scope);
+int profiler_start_trace(const char *path);
+void profiler_stop_trace(void);
+
+#endif
@@ -0,0 +1,1092 @@
+#include "scanline.h"
+
+#ifdef SCANLINE_X86
+#include <immintrin.h>
+#endif
+
+#ifdef SCANLINE_NEON
+#include <arm_neon.h>
+#endif
+
+static void scanline_texture128(int32_t *restrict raster,
+                                int32_t *restrict texture, int k, int l, int i1,
+                                int j1, int k1, int l1, int length, int k2,
+                                int l2) {
+    // 2 ** 7 = 128
+    static const int texture_shift = 7;
+    const int texture_size = (int)pow(2, texture_shift);
+    const int texture_area = (texture_size * texture_size) - texture_size;
+
+    if (length <= 0) {
+        return;
+    }
+
+    int i = 0;
+    int j = 0;
+    int i3 = 0;
+    int j3 = 0;
+    int i4 = 0;
+
+    if (i1 != 0) {
+        i = (k / i1) << texture_shift;
+        j = (l / i1) << texture_shift;
+    }
+
+    if (i < 0) {
+        i = 0;
+    } else if (i > texture_area) {
+        i = texture_area;
+    }
+
+    k += j1;
+    l += k1;
+    i1 += l1;
+
+    if (i1 != 0) {
+        i3 = (k / i1) << texture_shift;
+        j3 = (l / i1) << texture_shift;
+    }
+
+    if (i3 < 0) {
+        i3 = 0;
+    } else if (i3 > texture_area) {
+        i3 = texture_area;
+    }
+
+    int k3 = (i3 - i) / 16;
+    int l3 = (j3 - j) / 16;
+
+    for (int i_ = length / 16; i_ > 0; i_--) {
+        for (int j_ = 0; j_ < 4; j_++) {
+            i = (i & (texture_area + (texture_size - 1))) + (k2 & 0x600000);
+            i4 = k2 >> 23;
+            k2 += l2;
+
+            for (int k_ = 0; k_ < 4; k_++) {
+                (*raster++) =
+                    texture[(j & texture_area) + (i >> texture_shift)] >> i4;
+
+                i += k3;
+                j += l3;
+            }
+        }
+
+        i = i3;
+        j = j3;
+
+        k += j1;
+        l += k1;
+        i1 += l1;
+
+        if (i1 != 0) {
+            i3 = (k / i1) << texture_shift;
+            j3 = (l / i1) << texture_shift;
+        }
+
+        if (i3 < 0) {
+            i3 = 0;
+        } else if (i3 > texture_area) {
+            i3 = texture_area;
+        }
+
+        k3 = (i3 - i) / 16;
+        l3 = (j3 - j) / 16;
+    }
+
+    for (int i_ = 0; i_ < (length & 0xf); i_++) {
+        if ((i_ & 3) == 0) {
+            i = (i & (texture_area + (texture_size - 1))) + (k2 & 0x600000);
+            i4 = k2 >> 23;
+            k2 += l2;
+        }
+
+        (*raster++) = texture[(j & texture_area) + (i >> texture_shift)] >> i4;
+
+        i += k3;
+        j += l3;
+    }
+}
+
+static void scanline_texture128_alphakey(int32_t *restrict raster,
+                                         int32_t *restrict texture, int l,
+                                         int i1, int j1, int k1, int l1, int i2,
+                                         int length, int l2, int i3) {
+    // 2 ** 7 = 128
+    static const int texture_shift = 7;
+    const int texture_size = (int)pow(2, texture_shift);
+    const int texture_area = (texture_size * texture_size) - texture_size;
+
+    if (length <= 0) {
+        return;
+    }
+
+    int colour = 0;
+    int j = 0;
+    int k = 0;
+    int j3 = 0;
+    int k3 = 0;
+    i3 <<= 2;
+
+    if (j1 != 0) {
+        j3 = (l / j1) << texture_shift;
+        k3 = (i1 / j1) << texture_shift;
+    }
+
+    if (j3 < 0) {
+        j3 = 0;
+    } else if (j3 > texture_area) {
+        j3 = texture_area;
+    }
+
+    for (int i_ = length; i_ > 0; i_ -= 16) {
+        l += k1;
+        i1 += l1;
+        j1 += i2;
+        j = j3;
+        k = k3;
+
+        if (j1 != 0) {
+            j3 = (l / j1) << texture_shift;
+            k3 = (i1 / j1) << texture_shift;
+        }
+
+        if (j3 < 0) {
+            j3 = 0;
+        } else if (j3 > texture_area) {
+            j3 = texture_area;
+        }
+
+        int l3 = (j3 - j) >> 4;
+        int i4 = (k3 - k) >> 4;
+        int k4 = l2 >> 23;
+
+        j += l2 & 0x600000;
+        l2 += i3;
+
+        if (i_ < 16) {
+            for (int j_ = 0; j_ < i_; j_++) {
+                if ((colour =
+                         texture[(k & texture_area) + (j >> texture_shift)] >>
+                         k4) != 0) {
+                    (*raster) = colour;
+                }
+
+                raster++;
+                j += l3;
+                k += i4;
+
+                if ((j_ & 3) == 3) {
+                    j = (j & (texture_area + texture_size - 1)) +
+                        (l2 & 0x600000);
+
+                    k4 = l2 >> 23;
+                    l2 += i3;
+                }
+            }
+        } else {
+            for (int j_ = 0; j_ < 4; j_++) {
+                for (int k_ = 0; k_ < 4; k_++) {
+                    if ((colour = texture[(k & texture_area) +
+                                          (j >> texture_shift)] >>
+                                  k4) != 0) {
+                        (*raster) = colour;
+                    }
+
+                    raster++;
+                    j += l3;
+                    k += i4;
+                }
+
+                if (j_ == 3) {
+                    break;
+                }
+
+                j = (j & (texture_area + texture_size - 1)) + (l2 & 0x600000);
+
+                k4 = l2 >> 23;
+                l2 += i3;
+            }
+        }
+    }
+}
+
+static void scanline_texture64(int32_t *restrict raster,
+                               int32_t *restrict texture, int k, int l, int i1,
+                               int j1, int k1, int l1, int length, int k2,
+                               int l2) {
+    // 2 ** 6 = 64
+    static const int texture_shift = 6;
+    int texture_size = (int)pow(2, texture_shift);
+    const int texture_area = (texture_size * texture_size) - texture_size;
+
+    if (length <= 0) {
+        return;
+    }
+
+    int i = 0;
+    int j = 0;
+    int i3 = 0;
+    int j3 = 0;
+    l2 <<= 2; // * 4
+
+    if (i1 != 0) {
+        i3 = (k / i1) << texture_shift;
+        j3 = (l / i1) << texture_shift;
+    }
+
+    if (i3 < 0) {
+        i3 = 0;
+    } else if (i3 > texture_area) {
+        i3 = texture_area;
+    }
+
+    for (int i_ = length; i_ > 0; i_ -= 16) {
+        k += j1;
+        l += k1;
+        i1 += l1;
+        i = i3;
+        j = j3;
+
+        if (i1 != 0) {
+            i3 = (k / i1) << texture_shift;
+            j3 = (l / i1) << texture_shift;
+        }
+
+        if (i3 < 0) {
+            i3 = 0;
+        } else if (i3 > texture_area) {
+            i3 = texture_area;
+        }
+
+        int k3 = (i3 - i) >> 4;
+        int l3 = (j3 - j) >> 4;
+        int32_t j4 = k2 >> 20;
+
+        i += k2 & 0xc0000;
+        k2 += l2;
+
+        if (i_ < 16) {
+            for (int j_ = 0; j_ < i_; j_++) {
+                (*raster++) =
+                    texture[(j & texture_area) + (i >> texture_shift)] >> j4;
+
+                i += k3;
+                j += l3;
+
+                if ((j_ & 3) == 3) {
+                    i = (i & (texture_area + texture_size - 1)) +
+                        (k2 & 0xc0000);
+
+                    j4 = k2 >> 20;
+                    k2 += l2;
+                }
+            }
+        } else {
+            for (int j_ = 0; j_ < 4; j_++) {
+                for (int k_ = 0; k_ < 4; k_++) {
+                    (*raster++) =
+                        texture[(j & texture_area) + (i >> texture_shift)] >>
+                        j4;
+
+                    i += k3;
+                    j += l3;
+                }
+
+                if (j_ == 3) {
+                    break;
+                }
+
+                i = (i & (texture_area + texture_size - 1)) + (k2 & 0xc0000);
+                j4 = k2 >> 20;
+                k2 += l2;
+            }
+        }
+    }
+}
+
+static void scanline_texture64_alphakey(int32_t *restrict raster,
+                                        int32_t *restrict texture, int l,
+                                        int i1, int j1, int k1, int l1, int i2,
+                                        int length, int l2, int i3) {
+    // 2 ** 6 = 64
+    static const int texture_shift = 6;
+    const int texture_size = (int)pow(2, texture_shift);
+    const int texture_area = (texture_size * texture_size) - texture_size;
+
+    if (length <= 0) {
+        return;
+    }
+
+    int colour = 0;
+    int j = 0;
+    int k = 0;
+    int j3 = 0;
+    int k3 = 0;
+    i3 <<= 2;
+
+    if (j1 != 0) {
+        j3 = (l / j1) << texture_shift;
+        k3 = (i1 / j1) << texture_shift;
+    }
+
+    if (j3 < 0) {
+        j3 = 0;
+    } else if (j3 > texture_area) {
+        j3 = texture_area;
+    }
+
+    for (int i_ = length; i_ > 0; i_ -= 16) {
+        l += k1;
+        i1 += l1;
+        j1 += i2;
+        j = j3;
+        k = k3;
+
+        if (j1 != 0) {
+            j3 = (l / j1) << texture_shift;
+            k3 = (i1 / j1) << texture_shift;
+        }
+
+        if (j3 < 0) {
+            j3 = 0;
+        } else if (j3 > texture_area) {
+            j3 = texture_area;
+        }
+
+        int l3 = (j3 - j) >> 4;
+        int i4 = (k3 - k) >> 4;
+        int k4 = l2 >> 20;
+
+        j += l2 & 0xc0000;
+        l2 += i3;
+
+        if (i_ < 16) {
+            for (int j_ = 0; j_ < i_; j_++) {
+                if ((colour =
+                         texture[(k & texture_area) + (j >> texture_shift)] >>
+                         k4) != 0) {
+                    (*raster) = colour;
+                }
+
+                raster++;
+                j += l3;
+                k += i4;
+
+                if ((j_ & 3) == 3) {
+                    j = (j & (texture_area + texture_size - 1)) +
+                        (l2 & 0xc0000);
+
+                    k4 = l2 >> 20;
+                    l2 += i3;
+                }
+            }
+        } else {
+            for (int j_ = 0; j_ < 4; j_++) {
+                for (int k_ = 0; k_ < 4; k_++) {
+                    if ((colour = texture[(k & texture_area) +
+                                          (j >> texture_shift)] >>
+                                  k4) != 0) {
+                        (*raster) = colour;
+                    }
+
+                    raster++;
+                    j += l3;
+                    k += i4;
+                }
+
+                if (j_ == 3) {
+                    break;
+                }
+
+                j = (j & (texture_area + texture_size - 1)) + (l2 & 0xc0000);
+                k4 = l2 >> 20;
+                l2 += i3;
+            }
+        }
+    }
+}
+
+static void scanline_colour_translucent(int32_t *restrict raster, int i,
+                                        int32_t *restrict ramp, int ramp_index,
+                                        int ramp_inc) {
+    /* If i >= 0, nothing to render */
+    if (i >= 0) {
+        return;
+    }
+
+    /* Multiply ramp increment by 4 as before */
+    ramp_inc *= 4;
+
+    /*
+     * Grab initial color from ramp. Main loop handles sets of 16 pixels
+     * in groups of 4, updating 'colour' (ew br*tish) after each 4-pixel block.
+     */
+    int colour = ramp[(ramp_index / RAMP_SIZE) & 0xff];
+    ramp_index += ramp_inc;
+
+    /* Each group of 16 pixels in the original code used 4x(4 pixel writes). */
+    int length = i / 16;
+    
+    for (int block_i = length; block_i < 0; block_i++) {
+
+#define WRITE_4_PIXELS() do {                                        \
+    *raster = colour + ((*(raster + 1) >> 1) & 0x7f7f7f); raster++;   \
+    *raster = colour + ((*(raster + 1) >> 1) & 0x7f7f7f); raster++;   \
+    *raster = colour + ((*(raster + 1) >> 1) & 0x7f7f7f); raster++;   \
+    *raster = colour + ((*(raster + 1) >> 1) & 0x7f7f7f); raster++;   \
+    colour = ramp[(ramp_index / RAMP_SIZE) & 0xff];                  \
+    ramp_index += ramp_inc;                                          \
+} while(0)
+
+        WRITE_4_PIXELS();  /* j=0 */
+        WRITE_4_PIXELS();  /* j=1 */
+        WRITE_4_PIXELS();  /* j=2 */
+        WRITE_4_PIXELS();  /* j=3 */
+#undef WRITE_4_PIXELS
+    }
+
+    /*
+     * Remainder pass (i % 16 leftover pixels). length = -(i % 16).
+     * The code does small strips, updating color after each group of 4 pixels.
+     */
+    length = -(i % 16); /* how many leftover pixels (0..15) */
+
+    for (int pix_i = 0; pix_i < length; pix_i++) {
+        *raster = colour + ((*(raster + 1) >> 1) & 0x7f7f7f);
+        raster++;
+
+        if ((pix_i & 3) == 3) {
+            colour = ramp[(ramp_index / RAMP_SIZE) & 0xff];
+            ramp_index += ramp_inc * 2;
+        }
+    }
+}
+
+
+static void scanline_colour(int32_t *restrict raster, int i,
+                            int32_t *restrict ramp, int ramp_index,
+                            int ramp_inc) {
+    if (i >= 0) {
+        return;
+    }
+
+    /*
+     * RAMP_WIDE decides if we step in blocks of 2 or 4 horizontally.
+     * Default inner loop is either 8 or 16px.
+     */
+    int step = (RAMP_WIDE ? 2 : 4);
+    ramp_inc *= (RAMP_WIDE ? 2 : 4);
+
+    int colour = ramp[(ramp_index / RAMP_SIZE) & 0xff];
+    ramp_index += ramp_inc;
+
+    int block_size = (RAMP_WIDE ? 8 : 16);   /* how many pixels per block */
+    int length = i / block_size;
+
+    /* MAIN BLOCK LOOP */
+    for (int block_i = length; block_i < 0; block_i++) {
+#define WRITE_BLOCK() do {                              \
+    for (int k_ = 0; k_ < step; k_++) {                 \
+        *raster++ = colour;                             \
+    }                                                   \
+    colour = ramp[(ramp_index / RAMP_SIZE) & 0xff];     \
+    ramp_index += ramp_inc;                             \
+} while(0)
+
+        WRITE_BLOCK();  /* j=0 */
+        WRITE_BLOCK();  /* j=1 */
+        WRITE_BLOCK();  /* j=2 */
+        WRITE_BLOCK();  /* j=3 */
+#undef WRITE_BLOCK
+    }
+
+    /*
+     * Remainder pass: i % block_size leftover pixels
+     * length = -(i % block_size)
+     */
+    length = -(i % block_size);
+    int ramp_flag = (RAMP_WIDE ? 1 : 3);
+
+    for (int pix_i = 0; pix_i < length; pix_i++) {
+        *raster++ = colour;
+        if ((pix_i & ramp_flag) == ramp_flag) {
+            if (RAMP_WIDE) {
+                colour = ramp[(ramp_index >> 8) & 0xff];
+            } else {
+                colour = ramp[(ramp_index / RAMP_SIZE) & 0xff];
+            }
+            ramp_index += ramp_inc;
+        }
+    }
+}
+
+#if defined(SCANLINE_X86) || defined(SCANLINE_NEON)
+/* the simd kernels follow the scalar ones step for step, but draw each run of
+ * 4 pixels that share a brightness (or ramp colour) at once. texels() draws
+ * texture[((v + n * dv) & area) + ((u + n * du) >> shift)] >> brightness for
+ * n = 0..3, texels_alphakey() skips the ones that are 0 */
+#define SCANLINE_TEXTURE128_KERNEL(name, target, texels)                       \
+    target static void name(int32_t *restrict raster,                          \
+                            int32_t *restrict texture, int k, int l, int i1,   \
+                            int j1, int k1, int l1, int length, int k2,        \
+                            int l2) {                                          \
+        const int texture_shift = 7;                                           \
+        const int texture_size = 128;                                          \
+        const int texture_area = (texture_size * texture_size) - texture_size; \
+                                                                               \
+        if (length <= 0) {                                                     \
+            return;                                                            \
+        }                                                                      \
+                                                                               \
+        int i = 0;                                                             \
+        int j = 0;                                                             \
+        int i3 = 0;                                                            \
+        int j3 = 0;                                                            \
+        int i4 = 0;                                                            \
+                                                                               \
+        if (i1 != 0) {                                                         \
+            i = (k / i1) << texture_shift;                                     \
+            j = (l / i1) << texture_shift;                                     \
+        }                                                                      \
+                                                                               \
+        if (i < 0) {                                                           \
+            i = 0;                                                             \
+        } else if (i > texture_area) {                                         \
+            i = texture_area;                                                  \
+        }                                                                      \
+                                                                               \
+        k += j1;                                                               \
+        l += k1;                                                               \
+        i1 += l1;                                                              \
+                                                                               \
+        if (i1 != 0) {                                                         \
+            i3 = (k / i1) << texture_shift;                                    \
+            j3 = (l / i1) << texture_shift;                                    \
+        }                                                                      \
+                                                                               \
+        if (i3 < 0) {                                                          \
+            i3 = 0;                                                            \
+        } else if (i3 > texture_area) {                                        \
+            i3 = texture_area;                                                 \
+        }                                                                      \
+                                                                               \
+        int k3 = (i3 - i) / 16;                                                \
+        int l3 = (j3 - j) / 16;                                                \
+                                                                               \
+        for (int i_ = length / 16; i_ > 0; i_--) {                             \
+            for (int j_ = 0; j_ < 4; j_++) {                                   \
+                i = (i & (texture_area + (texture_size - 1))) +                \
+                    (k2 & 0x600000);                                           \
+                i4 = k2 >> 23;                                                 \
+                k2 += l2;                                                      \
+                                                                               \
+                texels(raster, texture, i, j, k3, l3, texture_area,            \
+                       texture_shift, i4);                                     \
+                                                                               \
+                raster += 4;                                                   \
+                i += k3 * 4;                                                   \
+                j += l3 * 4;                                                   \
+            }                                                                  \
+                                                                               \
+            i = i3;                                                            \
+            j = j3;                                                            \
+                                                                               \
+            k += j1;                                                           \
+            l += k1;                                                           \
+            i1 += l1;                                                          \
+                                                                               \
+            if (i1 != 0) {                                                     \
+                i3 = (k / i1) << texture_shift;                                \
+                j3 = (l / i1) << texture_shift;                                \
+            }                                                                  \
+                                                                               \
+            if (i3 < 0) {                                                      \
+                i3 = 0;                                                        \
+            } else if (i3 > texture_area) {                                    \
+                i3 = texture_area;                                             \
+            }                                                                  \
+                                                                               \
+            k3 = (i3 - i) / 16;                                                \
+            l3 = (j3 - j) / 16;                                                \
+        }                                                                      \
+                                                                               \
+        for (int i_ = 0; i_ < (length & 0xf); i_++) {                          \
+            if ((i_ & 3) == 0) {                                               \
+                i = (i & (texture_area + (texture_size - 1))) +                \
+                    (k2 & 0x600000);                                           \
+                i4 = k2 >> 23;                                                 \
+                k2 += l2;                                                      \
+            }                                                                  \
+                                                                               \
+            (*raster++) =                                                      \
+                texture[(j & texture_area) + (i >> texture_shift)] >> i4;      \
+                                                                               \
+            i += k3;                                                           \
+            j += l3;                                                           \
+        }                                                                      \
+    }
+
+/* the 64 and 128 alphakey kernels and the opaque 64 kernel only differ in
+ * texture size, brightness bits and whether 0 is skipped. the opaque kernel
+ * names its arguments differently but takes them in the same order */
+#define SCANLINE_TEXTURE_BLOCKS_KERNEL(name, target, texels, texture_shift,    \
+                                       brightness_shift, brightness_mask,      \
+                                       alphakey)                               \
+    target static void name(int32_t *restrict raster,                          \
+                            int32_t *restrict texture, int l, int i1, int j1,  \
+                            int k1, int l1, int i2, int length, int l2,        \
+                            int i3) {                                          \
+        const int texture_size = 1 << (texture_shift);                         \
+        const int texture_area = (texture_size * texture_size) - texture_size; \
+                                                                               \
+        if (length <= 0) {                                                     \
+            return;                                                            \
+        }                                                                      \
+                                                                               \
+        int colour = 0;                                                        \
+        int j = 0;                                                             \
+        int k = 0;                                                             \
+        int j3 = 0;                                                            \
+        int k3 = 0;                                                            \
+        i3 <<= 2;                                                              \
+                                                                               \
+        if (j1 != 0) {                                                         \
+            j3 = (l / j1) << (texture_shift);                                  \
+            k3 = (i1 / j1) << (texture_shift);                                 \
+        }                                                                      \
+                                                                               \
+        if (j3 < 0) {                                                          \
+            j3 = 0;                                                            \
+        } else if (j3 > texture_area) {                                        \
+            j3 = texture_area;                                                 \
+        }                                                                      \
+                                                                               \
+        for (int i_ = length; i_ > 0; i_ -= 16) {                              \
+            l += k1;                                                           \
+            i1 += l1;                                                          \
+            j1 += i2;                                                          \
+            j = j3;                                                            \
+            k = k3;                                                            \
+                                                                               \
+            if (j1 != 0) {                                                     \
+                j3 = (l / j1) << (texture_shift);                              \
+                k3 = (i1 / j1) << (texture_shift);                             \
+            }                                                                  \
+                                                                               \
+            if (j3 < 0) {                                                      \
+                j3 = 0;                                                        \
+            } else if (j3 > texture_area) {                                    \
+                j3 = texture_area;                                             \
+            }                                                                  \
+                                                                               \
+            int l3 = (j3 - j) >> 4;                                            \
+            int i4 = (k3 - k) >> 4;                                            \
+            int k4 = l2 >> (brightness_shift);                                 \
+                                                                               \
+            j += l2 & (brightness_mask);                                       \
+            l2 += i3;                                                          \
+                                                                               \
+            if (i_ < 16) {                                                     \
+                for (int j_ = 0; j_ < i_; j_++) {                              \
+                    colour = texture[(k & texture_area) +                      \
+                                     (j >> (texture_shift))] >>                \
+                             k4;                                               \
+                                                                               \
+                    if (!(alphakey) || colour != 0) {                          \
+                        (*raster) = colour;                                    \
+                    }                                                          \
+                                                                               \
+                    raster++;                                                  \
+                    j += l3;                                                   \
+                    k += i4;                                                   \
+                                                                               \
+                    if ((j_ & 3) == 3) {                                       \
+                        j = (j & (texture_area + texture_size - 1)) +          \
+                            (l2 & (brightness_mask));                          \
+                                                                               \
+                        k4 = l2 >> (brightness_shift);                         \
+                        l2 += i3;                                              \
+                    }                                                          \
+                }                                                              \
+            } else {                                                           \
+                for (int j_ = 0; j_ < 4; j_++) {                               \
+                    texels(raster, texture, j, k, l3, i4, texture_area,        \
+                           (texture_shift), k4);                               \
+                                                                               \
+                    raster += 4;                                               \
+                    j += l3 * 4;                                               \
+                    k += i4 * 4;                                               \
+                                                                               \
+                    if (j_ == 3) {                                             \
+                        break;                                                 \
+                    }                                                          \
+                                                                               \
+                    j = (j & (texture_area + texture_size - 1)) +              \
+                        (l2 & (brightness_mask));                              \
+                                                                               \
+                    k4 = l2 >> (brightness_shift);                             \
+                    l2 += i3;                                                  \
+                }                                                              \
+            }                                                                  \
+        }                                                                      \
+    }
+
+#define SCANLINE_COLOUR_TRANSLUCENT_KERNEL(name, target, translucent)          \
+    target static void name(int32_t *restrict raster, int i,                   \
+                            int32_t *restrict ramp, int ramp_index,            \
+                            int ramp_inc) {                                    \
+        if (i >= 0) {                                                          \
+            return;                                                            \
+        }                                                                      \
+                                                                               \
+        ramp_inc *= 4;                                                         \
+                                                                               \
+        int colour = ramp[(ramp_index / RAMP_SIZE) & 0xff];                    \
+        ramp_index += ramp_inc;                                                \
+                                                                               \
+        for (int block_i = i / 16; block_i < 0; block_i++) {                   \
+            for (int j_ = 0; j_ < 4; j_++) {                                   \
+                translucent(raster, colour);                                   \
+                raster += 4;                                                   \
+                                                                               \
+                colour = ramp[(ramp_index / RAMP_SIZE) & 0xff];                \
+                ramp_index += ramp_inc;                                        \
+            }                                                                  \
+        }                                                                      \
+                                                                               \
+        int length = -(i % 16);                                                \
+                                                                               \
+        for (int pix_i = 0; pix_i < length; pix_i++) {                         \
+            *raster = colour + ((*(raster + 1) >> 1) & 0x7f7f7f);              \
+            raster++;                                                          \
+                                                                               \
+            if ((pix_i & 3) == 3) {                                            \
+                colour = ramp[(ramp_index / RAMP_SIZE) & 0xff];                \
+                ramp_index += ramp_inc * 2;                                    \
+            }                                                                  \
+        }                                                                      \
+    }
+
+/* only for RAMP_WIDE == 0, where the colour changes every 4 pixels */
+#define SCANLINE_COLOUR_KERNEL(name, target, fill)                             \
+    target static void name(int32_t *restrict raster, int i,                   \
+                            int32_t *restrict ramp, int ramp_index,            \
+                            int ramp_inc) {                                    \
+        if (i >= 0) {                                                          \
+            return;                                                            \
+        }                                                                      \
+                                                                               \
+        ramp_inc *= 4;                                                         \
+                                                                               \
+        int colour = ramp[(ramp_index / RAMP_SIZE) & 0xff];                    \
+        ramp_index += ramp_inc;                                                \
+                                                                               \
+        for (int block_i = i / 16; block_i < 0; block_i++) {                   \
+            for (int j_ = 0; j_ < 4; j_++) {                                   \
+                fill(raster, colour);                                          \
+                raster += 4;                                                   \
+                                                                               \
+                colour = ramp[(ramp_index / RAMP_SIZE) & 0xff];                \
+                ramp_index += ramp_inc;                                        \
+            }                                                                  \
+        }                                                                      \
+                                                                               \
+        int length = -(i % 16);                                                \
+                                                                               \
+        for (int pix_i = 0; pix_i < length; pix_i++) {                         \
+            *raster++ = colour;                                                \
+                                                                               \
+            if ((pix_i & 3) == 3) {                                            \
+                colour = ramp[(ramp_index / RAMP_SIZE) & 0xff];                \
+                ramp_index += ramp_inc;                                        \
+            }                                                                  \
+        }                                                                      \
+    }
+
+/* declares the 6 kernels for one instruction set */
+#define SCANLINE_KERNELS_DEFINE(isa, target)                                   \
+    SCANLINE_TEXTURE128_KERNEL(scanline_texture128_##isa, target,              \
+                               scanline_texels_##isa)                          \
+    SCANLINE_TEXTURE_BLOCKS_KERNEL(scanline_texture128_alphakey_##isa, target, \
+                                   scanline_texels_alphakey_##isa, 7, 23,      \
+                                   0x600000, 1)                                \
+    SCANLINE_TEXTURE_BLOCKS_KERNEL(scanline_texture64_##isa, target,           \
+                                   scanline_texels_##isa, 6, 20, 0xc0000, 0)   \
+    SCANLINE_TEXTURE_BLOCKS_KERNEL(scanline_texture64_alphakey_##isa, target,  \
+                                   scanline_texels_alphakey_##isa, 6, 20,      \
+                                   0xc0000, 1)                                 \
+    SCANLINE_COLOUR_TRANSLUCENT_KERNEL(scanline_colour_translucent_##isa,      \
+                                       target, scanline_translucent_##isa)     \
+    SCANLINE_COLOUR_KERNEL(scanline_colour_##isa, target, scanline_fill_##isa)
+#endif
+
+#ifdef SCANLINE_X86
+#define SCANLINE_SSE2 __attribute__((target("sse2")))
+#define SCANLINE_AVX2 __attribute__((target("avx2")))
+
+SCANLINE_SSE2 static inline __m128i scanline_index_sse2(int u, int v, int du,
+                                                        int dv, int area,
+                                                        int shift) {
+    __m128i us = _mm_setr_epi32(u, u + du, u + du * 2, u + du * 3);
+    __m128i vs = _mm_setr_epi32(v, v + dv, v + dv * 2, v + dv * 3);
+
+    return _mm_add_epi32(_mm_and_si128(vs, _mm_set1_epi32(area)),
+                         _mm_sra_epi32(us, _mm_cvtsi32_si128(shift)));
+}
+
+/* sse2 has no gather, so only the addressing and shifts are 4 wide */
+SCANLINE_SSE2 static inline __m128i
+scanline_gather_sse2(int32_t *restrict texture, int u, int v, int du, int dv,
+                     int area, int shift, int brightness) {
+    int32_t index[4];
+
+    _mm_storeu_si128((__m128i *)index,
+                     scanline_index_sse2(u, v, du, dv, area, shift));
+
+    __m128i texels = _mm_setr_epi32(texture[index[0]], texture[index[1]],
+                                    texture[index[2]], texture[index[3]]);
+
+    return _mm_sra_epi32(texels, _mm_cvtsi32_si128(brightness));
+}
+
+SCANLINE_SSE2 static inline void
+scanline_texels_sse2(int32_t *restrict raster, int32_t *restrict texture,
+                     int u, int v, int du, int dv, int area, int shift,
+                     int brightness) {
+    _mm_storeu_si128((__m128i *)raster,
+                     scanline_gather_sse2(texture, u, v, du, dv, area, shift,
+                                          brightness));
+}
+
+SCANLINE_SSE2 static inline void
+scanline_texels_alphakey_sse2(int32_t *restrict raster,
+                              int32_t *restrict texture, int u, int v, int du,
+                              int dv, int area, int shift, int brightness) {
+    __m128i texels =
+        scanline_gather_sse2(texture, u, v, du, dv, area, shift, brightness);
+
+    __m128i keyed = _mm_cmpeq_epi32(texels, _mm_setzero_si128());
+    __m128i pixels = _mm_loadu_si128((__m128i *)raster);
+
+    _mm_storeu_si128((__m128i *)raster,
+                     _mm_or_si128(texels, _mm_and_si128(keyed, pixels)));
+}
+
+SCANLINE_SSE2 static inline void scanline_translucent_sse2(int32_t *raster,
+                                                           int colour) {
+    __m128i behind = _mm_loadu_si128((__m128i *)(raster + 1));
+
+    behind = _mm_and_si128(_mm_srli_epi32(behind, 1),
+                           _mm_set1_epi32(0x7f7f7f));
+
+    _mm_storeu_si128((__m128i *)raster,
+                     _mm_add_epi32(_mm_set1_epi32(colour), behind));
+}
+
+SCANLINE_SSE2 static inline void scanline_fill_sse2(int32_t *raster,
+                                                    int colour) {
+    _mm_storeu_si128((__m128i *)raster, _mm_set1_epi32(colour));
+}
+
+SCANLINE_KERNELS_DEFINE(sse2, SCANLINE_SSE2)
+
+/* avx2 adds a gather and a masked store. the brightness changes every 4
+ * pixels, so 4 lanes are still used */
+SCANLINE_AVX2 static inline __m128i
+scanline_gather_avx2(int32_t *restrict texture, int u, int v, int du, int dv,
+                     int area, int shift, int brightness) {
+    __m128i lanes = _mm_setr_epi32(0, 1, 2, 3);
+
+    __m128i us = _mm_add_epi32(_mm_set1_epi32(u),
+                               _mm_mullo_epi32(lanes, _mm_set1_epi32(du)));
+
+    __m128i vs = _mm_add_epi32(_mm_set1_epi32(v),
+                               _mm_mullo_epi32(lanes, _mm_set1_epi32(dv)));
+
+    __m128i index =
+        _mm_add_epi32(_mm_and_si128(vs, _mm_set1_epi32(area)),
+                      _mm_sra_epi32(us, _mm_cvtsi32_si128(shift)));
+
+    __m128i texels = _mm_i32gather_epi32((const int *)texture, index, 4);
+
+    return _mm_sra_epi32(texels, _mm_cvtsi32_si128(brightness));
+}
+
+SCANLINE_AVX2 static inline void
+scanline_texels_avx2(int32_t *restrict raster, int32_t *restrict texture,
+                     int u, int v, int du, int dv, int area, int shift,
+                     int brightness) {
+    _mm_storeu_si128((__m128i *)raster,
+                     scanline_gather_avx2(texture, u, v, du, dv, area, shift,
+                                          brightness));
+}
+
+SCANLINE_AVX2 static inline void
+scanline_texels_alphakey_avx2(int32_t *restrict raster,
+                              int32_t *restrict texture, int u, int v, int du,
+                              int dv, int area, int shift, int brightness) {
+    __m128i texels =
+        scanline_gather_avx2(texture, u, v, du, dv, area, shift, brightness);
+
+    __m128i keyed = _mm_cmpeq_epi32(texels, _mm_setzero_si128());
+
+    _mm_maskstore_epi32((int *)raster,
+                        _mm_xor_si128(keyed, _mm_set1_epi32(-1)), texels);
+}
+
+SCANLINE_AVX2 static inline void scanline_translucent_avx2(int32_t *raster,
+                                                           int colour) {
+    __m128i behind = _mm_loadu_si128((__m128i *)(raster + 1));
+
+    behind = _mm_and_si128(_mm_srli_epi32(behind, 1),
+                           _mm_set1_epi32(0x7f7f7f));
+
+    _mm_storeu_si128((__m128i *)raster,
+                     _mm_add_epi32(_mm_set1_epi32(colour), behind));
+}
+
+SCANLINE_AVX2 static inline void scanline_fill_avx2(int32_t *raster,
+                                                    int colour) {
+    _mm_storeu_si128((__m128i *)raster, _mm_set1_epi32(colour));
+}
+
+SCANLINE_KERNELS_DEFINE(avx2, SCANLINE_AVX2)
+#endif
+
+#ifdef SCANLINE_NEON
+#define SCANLINE_NEON_TARGET
+
+static inline int32x4_t scanline_gather_neon(int32_t *restrict texture, int u,
+                                             int v, int du, int dv, int area,
+                                             int shift, int brightness) {
+    int32_t us[4] = {u, u + du, u + du * 2, u + du * 3};
+    int32_t vs[4] = {v, v + dv, v + dv * 2, v + dv * 3};
+    int32_t index[4];
+
+    vst1q_s32(index, vaddq_s32(vandq_s32(vld1q_s32(vs), vdupq_n_s32(area)),
+                               vshlq_s32(vld1q_s32(us), vdupq_n_s32(-shift))));
+
+    int32_t texels[4] = {texture[index[0]], texture[index[1]],
+                         texture[index[2]], texture[index[3]]};
+
+    return vshlq_s32(vld1q_s32(texels), vdupq_n_s32(-brightness));
+}
+
+static inline void scanline_texels_neon(int32_t *restrict raster,
+                                        int32_t *restrict texture, int u,
+                                        int v, int du, int dv, int area,
+                                        int shift, int brightness) {
+    vst1q_s32(raster, scanline_gather_neon(texture, u, v, du, dv, area, shift,
+                                           brightness));
+}
+
+static inline void scanline_texels_alphakey_neon(int32_t *restrict raster,
+                                                 int32_t *restrict texture,
+                                                 int u, int v, int du, int dv,
+                                                 int area, int shift,
+                                                 int brightness) {
+    int32x4_t texels =
+        scanline_gather_neon(texture, u, v, du, dv, area, shift, brightness);
+
+    uint32x4_t keyed = vceqq_s32(texels, vdupq_n_s32(0));
+
+    vst1q_s32(raster, vbslq_s32(keyed, vld1q_s32(raster), texels));
+}
+
+static inline void scanline_translucent_neon(int32_t *raster, int colour) {
+    int32x4_t behind = vandq_s32(vshrq_n_s32(vld1q_s32(raster + 1), 1),
+                                 vdupq_n_s32(0x7f7f7f));
+
+    vst1q_s32(raster, vaddq_s32(vdupq_n_s32(colour), behind));
+}
+
+static inline void scanline_fill_neon(int32_t *raster, int colour) {
+    vst1q_s32(raster, vdupq_n_s32(colour));
+}
+
+SCANLINE_KERNELS_DEFINE(neon, SCANLINE_NEON_TARGET)
+#endif
+
+/* in order of preference */
+static const ScanlineKernels scanline_kernel_table[SCANLINE_KERNELS_COUNT] = {
+#ifdef SCANLINE_X86
+    {SCANLINE_KERNELS_AVX2, "avx2", scanline_texture128_avx2,
+     scanline_texture128_alphakey_avx2, scanline_texture64_avx2,
+     scanline_texture64_alphakey_avx2, scanline_colour_translucent_avx2,
+     scanline_colour_avx2},
+    {SCANLINE_KERNELS_SSE2, "sse2", scanline_texture128_sse2,
+     scanline_texture128_alphakey_sse2, scanline_texture64_sse2,
+     scanline_texture64_alphakey_sse2, scanline_colour_translucent_sse2,
+     scanline_colour_sse2},
+#endif
+#ifdef SCANLINE_NEON
+    {SCANLINE_KERNELS_NEON, "neon", scanline_texture128_neon,
+     scanline_texture128_alphakey_neon, scanline_texture64_neon,
+     scanline_texture64_alphakey_neon, scanline_colour_translucent_neon,
+     scanline_colour_neon},
+#endif
+    {SCANLINE_KERNELS_SCALAR, "scalar", scanline_texture128,
+     scanline_texture128_alphakey, scanline_texture64,
+     scanline_texture64_alphakey, scanline_colour_translucent,
+     scanline_colour}};
+
+ScanlineKernels scanline_kernels = {
+    SCANLINE_KERNELS_SCALAR,     "scalar",
+    scanline_texture128,         scanline_texture128_alphakey,
+    scanline_texture64,          scanline_texture64_alphakey,
+    scanline_colour_translucent, scanline_colour};
+
+static const ScanlineKernels *scanline_find_kernels(SCANLINE_KERNELS type) {
+    for (int i = 0; i < SCANLINE_KERNELS_COUNT; i++) {
+        if (scanline_kernel_table[i].name != NULL &&
+            scanline_kernel_table[i].type == type) {
+            return &scanline_kernel_table[i];
+        }
+    }
+
+    return NULL;
+}
+
+int scanline_kernels_supported(SCANLINE_KERNELS type) {
+    if (RAMP_WIDE && type != SCANLINE_KERNELS_SCALAR) {
+        return 0;
+    }
+
+    if (scanline_find_kernels(type) == NULL) {
+        return 0;
+    }
+
+#ifdef SCANLINE_X86
+    __builtin_cpu_init();
+
+    if (type == SCANLINE_KERNELS_SSE2) {
+        return __builtin_cpu_supports("sse2");
+    }
+
+    if (type == SCANLINE_KERNELS_AVX2) {
+        return __builtin_cpu_supports("avx2");
+    }
+#endif
+
+    return 1;
+}
+
+int scanline_set_kernels(SCANLINE_KERNELS type) {
+    if (!scanline_kernels_supported(type)) {
+        return 0;
+    }
+
+    scanline_kernels = *scanline_find_kernels(type);
+
+    return 1;
+}
+
+/* use the fastest kernels this cpu supports */
+void init_scanline_global(void) {
+    for (int i = 0; i < SCANLINE_KERNELS_COUNT; i++) {
+        if (scanline_kernel_table[i].name != NULL &&
+            scanline_set_kernels(scanline_kernel_table[i].type)) {
+            return;
+        }
+    }
+}
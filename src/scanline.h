@@ -1,6 +1,35 @@
 #ifndef _H_SCANLINE
 #define _H_SCANLINE
 
+#include <math.h>
+#include <stdint.h>
+
+/* x86 kernels are built with target attributes and picked at runtime, so the
+ * rest of the client needs no -msse2/-mavx2 */
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(EMSCRIPTEN) &&     \
+    (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+#define SCANLINE_X86
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define SCANLINE_NEON
+#endif
+
+#define RAMP_SIZE 256
+
+/* originally Scene had a wide_band property and a second colour_scanline
+ * function that was unused */
+#define RAMP_WIDE 0
+
+typedef enum {
+    SCANLINE_KERNELS_SCALAR = 0,
+    SCANLINE_KERNELS_SSE2 = 1,
+    SCANLINE_KERNELS_AVX2 = 2,
+    SCANLINE_KERNELS_NEON = 3
+} SCANLINE_KERNELS;
+
+#define SCANLINE_KERNELS_COUNT 4
+
 typedef struct Scanline {
     int start_x;
     int end_x;
@@ -8,4 +37,38 @@ typedef struct Scanline {
     int end_s;
 } Scanline;
 
+typedef void (*ScanlineTexture)(int32_t *restrict raster,
+                                int32_t *restrict texture, int k, int l, int i1,
+                                int j1, int k1, int l1, int length, int k2,
+                                int l2);
+
+typedef void (*ScanlineTextureAlphakey)(int32_t *restrict raster,
+                                        int32_t *restrict texture, int l,
+                                        int i1, int j1, int k1, int l1, int i2,
+                                        int length, int l2, int i3);
+
+typedef void (*ScanlineColour)(int32_t *restrict raster, int i,
+                               int32_t *restrict ramp, int ramp_index,
+                               int ramp_inc);
+
+/* the innermost loops of the software renderer. every set of kernels draws
+ * exactly the same pixels as the scalar ones */
+typedef struct ScanlineKernels {
+    SCANLINE_KERNELS type;
+    const char *name;
+
+    ScanlineTexture texture128;
+    ScanlineTextureAlphakey texture128_alphakey;
+    ScanlineTexture texture64;
+    ScanlineTextureAlphakey texture64_alphakey;
+    ScanlineColour colour_translucent;
+    ScanlineColour colour;
+} ScanlineKernels;
+
+extern ScanlineKernels scanline_kernels;
+
+void init_scanline_global(void);
+int scanline_kernels_supported(SCANLINE_KERNELS type);
+int scanline_set_kernels(SCANLINE_KERNELS type);
+
 #endif
@@ -66,13 +66,11 @@ void scene_gl_update_camera(Scene *scene) {
 
 /* normal GL only */
 #ifdef RENDER_GL
-void scene_gl_draw_game_model(Scene *scene, GameModel *game_model) {
-    if (game_model->gl_ebo_offset == -1 || !game_model->visible) {
-        return;
-    }
-
-    vertex_buffer_gl_bind(game_model->gl_buffer);
+static int scene_gl_can_draw(GameModel *game_model) {
+    return game_model->gl_ebo_offset != -1 && game_model->visible;
+}
 
+static void scene_gl_set_model_uniforms(Scene *scene, GameModel *game_model) {
     shader_set_mat4(&scene->game_model_shader, "model", game_model->transform);
 
     mat4 view_model = {0};
@@ -107,6 +105,31 @@ void scene_gl_draw_game_model(Scene *scene, GameModel *game_model) {
     shader_set_float(&scene->game_model_shader, "opacity",
                      game_model->transparent ? TRANSLUCENT_MODEL_OPACITY
                                              : 1.0f);
+}
+
+/* whether the uniforms set for one model are the same for the other */
+static int scene_gl_same_model_uniforms(GameModel *game_model,
+                                        GameModel *other) {
+    return game_model->unlit == other->unlit &&
+           game_model->light_ambience == other->light_ambience &&
+           game_model->light_diffuse == other->light_diffuse &&
+           game_model->light_direction_x == other->light_direction_x &&
+           game_model->light_direction_y == other->light_direction_y &&
+           game_model->light_direction_z == other->light_direction_z &&
+           game_model->light_direction_magnitude ==
+               other->light_direction_magnitude &&
+           game_model->transparent == other->transparent &&
+           memcmp(game_model->transform, other->transform, sizeof(mat4)) == 0;
+}
+
+void scene_gl_draw_game_model(Scene *scene, GameModel *game_model) {
+    if (!scene_gl_can_draw(game_model)) {
+        return;
+    }
+
+    vertex_buffer_gl_bind(game_model->gl_buffer);
+
+    scene_gl_set_model_uniforms(scene, game_model);
 
     glCullFace(GL_BACK);
     shader_set_int(&scene->game_model_shader, "cull_front", 0);
@@ -122,6 +145,92 @@ void scene_gl_draw_game_model(Scene *scene, GameModel *game_model) {
                    (void *)(game_model->gl_ebo_offset * sizeof(GLuint)));
 }
 
+/* opaque models are queued and drawn together by scene_gl_draw_queued_models
+ * rather than one at a time */
+static void scene_gl_queue_game_model(Scene *scene, GameModel *game_model) {
+    if (!scene_gl_can_draw(game_model)) {
+        return;
+    }
+
+    scene->gl_draw_models[scene->gl_draw_model_count++] = game_model;
+}
+
+static void scene_gl_draw_elements(Scene *scene, int length) {
+#ifdef EMSCRIPTEN
+    for (int i = 0; i < length; i++) {
+        glDrawElements(GL_TRIANGLES, scene->gl_draw_counts[i], GL_UNSIGNED_INT,
+                       scene->gl_draw_offsets[i]);
+    }
+#else
+    if (length == 1) {
+        glDrawElements(GL_TRIANGLES, scene->gl_draw_counts[0], GL_UNSIGNED_INT,
+                       scene->gl_draw_offsets[0]);
+    } else {
+        glMultiDrawElements(GL_TRIANGLES, scene->gl_draw_counts,
+                            GL_UNSIGNED_INT, scene->gl_draw_offsets, length);
+    }
+#endif
+}
+
+/* queued models that follow each other with the same vertex buffer and
+ * uniforms are drawn together, with the element ranges that touch joined
+ * into one. each group is drawn with back faces culled and then front faces,
+ * instead of switching for every model. terrain, walls and roofs are built
+ * in world space, so most of the scene ends up in a handful of groups */
+static void scene_gl_draw_queued_models(Scene *scene) {
+    int start = 0;
+
+    while (start < scene->gl_draw_model_count) {
+        GameModel *first = scene->gl_draw_models[start];
+        int end = start + 1;
+
+        while (end < scene->gl_draw_model_count &&
+               scene->gl_draw_models[end]->gl_buffer == first->gl_buffer &&
+               scene_gl_same_model_uniforms(first,
+                                            scene->gl_draw_models[end])) {
+            end++;
+        }
+
+        int length = 0;
+        int next_offset = -1;
+
+        for (int i = start; i < end; i++) {
+            GameModel *game_model = scene->gl_draw_models[i];
+
+            if (game_model->gl_ebo_offset == next_offset) {
+                scene->gl_draw_counts[length - 1] += game_model->gl_ebo_length;
+            } else {
+                scene->gl_draw_counts[length] = game_model->gl_ebo_length;
+
+                scene->gl_draw_offsets[length] =
+                    (void *)(game_model->gl_ebo_offset * sizeof(GLuint));
+
+                length++;
+            }
+
+            next_offset = game_model->gl_ebo_offset + game_model->gl_ebo_length;
+        }
+
+        vertex_buffer_gl_bind(first->gl_buffer);
+
+        scene_gl_set_model_uniforms(scene, first);
+
+        glCullFace(GL_BACK);
+        shader_set_int(&scene->game_model_shader, "cull_front", 0);
+
+        scene_gl_draw_elements(scene, length);
+
+        glCullFace(GL_FRONT);
+        shader_set_int(&scene->game_model_shader, "cull_front", 1);
+
+        scene_gl_draw_elements(scene, length);
+
+        start = end;
+    }
+
+    scene->gl_draw_model_count = 0;
+}
+
 void scene_gl_render(Scene *scene) {
     int scene_height = scene->gl_height - 1;
 
@@ -249,11 +358,13 @@ void scene_gl_render(Scene *scene) {
         GameModel *game_model = scene->models[i];
 
         if (game_model->autocommit && !game_model->unpickable) {
-            scene_gl_draw_game_model(scene, game_model);
+            scene_gl_queue_game_model(scene, game_model);
             game_model->gl_invisible = 1;
         }
     }
 
+    scene_gl_draw_queued_models(scene);
+
     if (scene->gl_terrain_pick_step == GL_PICK_STEP_SAMPLE) {
         int mouse_x = scene->mouse_x + (scene->surface->width / 2);
         int mouse_y = scene->surface->height - scene->mouse_y;
@@ -292,35 +403,40 @@ void scene_gl_render(Scene *scene) {
                 } else {
                     GlModelTime model_time = {game_model, time};
 
-                    if (scene->gl_mouse_picked_size <
-                        (scene->gl_mouse_picked_count / 2)) {
-                        size_t new_size = scene->gl_mouse_picked_count * 2;
+                    if (scene->gl_mouse_picked_count ==
+                        scene->gl_mouse_picked_size) {
+                        size_t new_size = scene->gl_mouse_picked_size * 2;
                         void *new_ptr = NULL;
 
                         new_ptr = realloc(scene->gl_mouse_picked_time,
-                                          new_size * sizeof(GlModelTime *));
-                        if (new_ptr == NULL) {
-                            return;
+                                          new_size * sizeof(GlModelTime));
+
+                        /* the models still have to be queued, so the pick is
+                         * dropped rather than the frame */
+                        if (new_ptr != NULL) {
+                            scene->gl_mouse_picked_time = new_ptr;
+                            scene->gl_mouse_picked_size = new_size;
                         }
-                        scene->gl_mouse_picked_time = new_ptr;
-                        scene->gl_mouse_picked_size = new_size;
                     }
 
-                    scene->gl_mouse_picked_time[scene->gl_mouse_picked_count] =
-                        model_time;
-
-                    scene->gl_mouse_picked_count++;
+                    if (scene->gl_mouse_picked_count <
+                        scene->gl_mouse_picked_size) {
+                        scene->gl_mouse_picked_time
+                            [scene->gl_mouse_picked_count++] = model_time;
+                    }
                 }
             }
         }
 
         if (!game_model->gl_invisible && !game_model->transparent) {
-            scene_gl_draw_game_model(scene, game_model);
+            scene_gl_queue_game_model(scene, game_model);
         }
 
         game_model->gl_invisible = 0;
     }
 
+    scene_gl_draw_queued_models(scene);
+
     qsort(scene->gl_mouse_picked_time, scene->gl_mouse_picked_count,
           sizeof(GlModelTime), scene_gl_model_time_compare);
 
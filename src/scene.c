@@ -5,36 +5,25 @@ static void scene_set_texture_pixels(Scene *scene, int id);
 static void scene_initialise_polygon_2d(Scene *scene, int polygon_index);
 
 #ifdef RENDER_SW
-static void scene_texture128_scanline(int32_t *restrict raster,
-                                      int32_t *restrict texture, int k, int l,
-                                      int i1, int j1, int k1, int l1,
-                                      int length, int k2, int l2);
-static void scene_texture128_alphakey_scanline(int32_t *restrict raster,
-                                               int32_t *restrict texture, int l,
-                                               int i1, int j1, int k1, int l1,
-                                               int i2, int length, int l2,
-                                               int i3);
-static void scene_texture64_scanline(int32_t *restrict raster,
-                                     int32_t *restrict texture, int k, int l,
-                                     int i1, int j1, int k1, int l1, int length,
-                                     int k2, int l2);
-static void scene_texture64_alphakey_scanline(int32_t *restrict raster,
-                                              int32_t *restrict texture, int l,
-                                              int i1, int j1, int k1, int l1,
-                                              int i2, int length, int l2,
-                                              int i3);
-static void scene_colour_translucent_scanline(int32_t *restrict raster, int i,
-                                              int32_t *restrict ramp,
-                                              int ramp_index, int ramp_inc);
-static void scene_colour_scanline(int32_t *restrict raster, int i,
-                                  int32_t *restrict ramp, int ramp_index,
-                                  int ramp_inc);
 static void scene_generate_scanlines(Scene *scene, int plane, int32_t *plane_x,
                                      int32_t *plane_y, int32_t *vertex_shade,
                                      GameModel *game_model, int face);
 static void scene_rasterize(Scene *scene, int vertex_count, int32_t *vertices_x,
                             int32_t *vertices_y, int32_t *vertices_z,
                             int face_fill, GameModel *game_model);
+static void scene_rasterize_span(Scene *scene, Scanline *scanlines,
+                                 int scanlines_y, int min_y, int max_y,
+                                 int vertex_count, int32_t *vertices_x,
+                                 int32_t *vertices_y, int32_t *vertices_z,
+                                 int face_fill, int32_t *gradient_ramp,
+                                 int transparent);
+#ifdef SCENE_RASTER_THREADED
+static void scene_raster_queue(Scene *scene, int vertex_count,
+                               int32_t *vertices_x, int32_t *vertices_y,
+                               int32_t *vertices_z, int face_fill,
+                               int transparent);
+static void scene_raster_flush(Scene *scene);
+#endif
 static int scene_method306(int i, int j, int k, int l, int i1);
 static int scene_method307(int i, int j, int k, int l, int flag);
 static int scene_method308(int i, int j, int k, int flag);
@@ -91,22 +80,6 @@ int scene_frustum_max_y = 0;
 int scene_frustum_min_y = 0;
 int scene_frustum_far_z = 0;
 int scene_frustum_near_z = 0;
-int64_t scene_texture_count_loaded = 0;
-
-int scene_polygon_depth_compare(const void *a, const void *b) {
-    GamePolygon *polygon_a = (*(GamePolygon **)a);
-    GamePolygon *polygon_b = (*(GamePolygon **)b);
-
-    if (polygon_a->depth == 0) {
-        return -1;
-    }
-
-    if (polygon_a->depth == polygon_b->depth) {
-        return 0;
-    }
-
-    return polygon_a->depth < polygon_b->depth ? 1 : -1;
-}
 
 void scene_new(Scene *scene, Surface *surface, int model_count,
                int polygon_count, int max_sprite_count) {
@@ -114,7 +87,11 @@ void scene_new(Scene *scene, Surface *surface, int model_count,
 
     // TODO we need to re-allocate more polygons when client is resized, or just
     // add more to initial polygon_count
-    polygon_count = 32767;
+    polygon_count = SCENE_MAX_POLYGONS;
+
+    /* the depth sort can only tell this many polygons apart */
+    _Static_assert(SCENE_MAX_POLYGONS <= POLYGON_DEPTH_SORT_MAX,
+                   "polygon count must fit the depth sort index");
 
     scene->surface = surface;
     scene->max_model_count = model_count;
@@ -132,7 +109,7 @@ void scene_new(Scene *scene, Surface *surface, int model_count,
     scene->gl_mouse_picked_size = 32;
 
     scene->gl_mouse_picked_time =
-        calloc(scene->gl_mouse_picked_size, sizeof(GlModelTime *));
+        calloc(scene->gl_mouse_picked_size, sizeof(GlModelTime));
 #endif
 
     scene->clip_near = 5;
@@ -145,6 +122,13 @@ void scene_new(Scene *scene, Surface *surface, int model_count,
 #endif
 
     scene->models = calloc(model_count, sizeof(GameModel *));
+    scene->cull_models = calloc(model_count, sizeof(int));
+
+#ifdef RENDER_GL
+    scene->gl_draw_models = calloc(model_count, sizeof(GameModel *));
+    scene->gl_draw_counts = calloc(model_count, sizeof(GLsizei));
+    scene->gl_draw_offsets = calloc(model_count, sizeof(void *));
+#endif
     scene->visible_polygons = calloc(polygon_count, sizeof(GamePolygon *));
 
     for (int i = 0; i < polygon_count; i++) {
@@ -152,6 +136,13 @@ void scene_new(Scene *scene, Surface *surface, int model_count,
         polygon_new(scene->visible_polygons[i]);
     }
 
+#ifdef RENDER_SW
+    scene->polygon_depth_keys = calloc(polygon_count * 2, sizeof(uint32_t));
+
+    scene->polygon_depth_scratch =
+        calloc(polygon_count, sizeof(GamePolygon *));
+#endif
+
     GameModel *view = malloc(sizeof(GameModel));
 
     /* 2D sprites */
@@ -285,552 +276,53 @@ void scene_new(Scene *scene, Surface *surface, int model_count,
 #endif
 }
 
-#ifdef RENDER_SW
-static void scene_texture128_scanline(int32_t *restrict raster,
-                                      int32_t *restrict texture, int k, int l,
-                                      int i1, int j1, int k1, int l1,
-                                      int length, int k2, int l2) {
-    // 2 ** 7 = 128
-    static const int texture_shift = 7;
-    const int texture_size = (int)pow(2, texture_shift);
-    const int texture_area = (texture_size * texture_size) - texture_size;
-
-    if (length <= 0) {
-        return;
-    }
-
-    int i = 0;
-    int j = 0;
-    int i3 = 0;
-    int j3 = 0;
-    int i4 = 0;
-
-    if (i1 != 0) {
-        i = (k / i1) << texture_shift;
-        j = (l / i1) << texture_shift;
-    }
-
-    if (i < 0) {
-        i = 0;
-    } else if (i > texture_area) {
-        i = texture_area;
-    }
-
-    k += j1;
-    l += k1;
-    i1 += l1;
-
-    if (i1 != 0) {
-        i3 = (k / i1) << texture_shift;
-        j3 = (l / i1) << texture_shift;
-    }
-
-    if (i3 < 0) {
-        i3 = 0;
-    } else if (i3 > texture_area) {
-        i3 = texture_area;
-    }
-
-    int k3 = (i3 - i) / 16;
-    int l3 = (j3 - j) / 16;
-
-    for (int i_ = length / 16; i_ > 0; i_--) {
-        for (int j_ = 0; j_ < 4; j_++) {
-            i = (i & (texture_area + (texture_size - 1))) + (k2 & 0x600000);
-            i4 = k2 >> 23;
-            k2 += l2;
-
-            for (int k_ = 0; k_ < 4; k_++) {
-                (*raster++) =
-                    texture[(j & texture_area) + (i >> texture_shift)] >> i4;
-
-                i += k3;
-                j += l3;
-            }
-        }
-
-        i = i3;
-        j = j3;
-
-        k += j1;
-        l += k1;
-        i1 += l1;
-
-        if (i1 != 0) {
-            i3 = (k / i1) << texture_shift;
-            j3 = (l / i1) << texture_shift;
-        }
-
-        if (i3 < 0) {
-            i3 = 0;
-        } else if (i3 > texture_area) {
-            i3 = texture_area;
-        }
-
-        k3 = (i3 - i) / 16;
-        l3 = (j3 - j) / 16;
-    }
-
-    for (int i_ = 0; i_ < (length & 0xf); i_++) {
-        if ((i_ & 3) == 0) {
-            i = (i & (texture_area + (texture_size - 1))) + (k2 & 0x600000);
-            i4 = k2 >> 23;
-            k2 += l2;
-        }
-
-        (*raster++) = texture[(j & texture_area) + (i >> texture_shift)] >> i4;
-
-        i += k3;
-        j += l3;
-    }
-}
-
-static void scene_texture128_alphakey_scanline(int32_t *restrict raster,
-                                               int32_t *restrict texture, int l,
-                                               int i1, int j1, int k1, int l1,
-                                               int i2, int length, int l2,
-                                               int i3) {
-    // 2 ** 7 = 128
-    static const int texture_shift = 7;
-    const int texture_size = (int)pow(2, texture_shift);
-    const int texture_area = (texture_size * texture_size) - texture_size;
-
-    if (length <= 0) {
-        return;
-    }
-
-    int colour = 0;
-    int j = 0;
-    int k = 0;
-    int j3 = 0;
-    int k3 = 0;
-    i3 <<= 2;
-
-    if (j1 != 0) {
-        j3 = (l / j1) << texture_shift;
-        k3 = (i1 / j1) << texture_shift;
-    }
-
-    if (j3 < 0) {
-        j3 = 0;
-    } else if (j3 > texture_area) {
-        j3 = texture_area;
-    }
-
-    for (int i_ = length; i_ > 0; i_ -= 16) {
-        l += k1;
-        i1 += l1;
-        j1 += i2;
-        j = j3;
-        k = k3;
-
-        if (j1 != 0) {
-            j3 = (l / j1) << texture_shift;
-            k3 = (i1 / j1) << texture_shift;
-        }
-
-        if (j3 < 0) {
-            j3 = 0;
-        } else if (j3 > texture_area) {
-            j3 = texture_area;
-        }
-
-        int l3 = (j3 - j) >> 4;
-        int i4 = (k3 - k) >> 4;
-        int k4 = l2 >> 23;
-
-        j += l2 & 0x600000;
-        l2 += i3;
-
-        if (i_ < 16) {
-            for (int j_ = 0; j_ < i_; j_++) {
-                if ((colour =
-                         texture[(k & texture_area) + (j >> texture_shift)] >>
-                         k4) != 0) {
-                    (*raster) = colour;
-                }
-
-                raster++;
-                j += l3;
-                k += i4;
-
-                if ((j_ & 3) == 3) {
-                    j = (j & (texture_area + texture_size - 1)) +
-                        (l2 & 0x600000);
-
-                    k4 = l2 >> 23;
-                    l2 += i3;
-                }
-            }
-        } else {
-            for (int j_ = 0; j_ < 4; j_++) {
-                for (int k_ = 0; k_ < 4; k_++) {
-                    if ((colour = texture[(k & texture_area) +
-                                          (j >> texture_shift)] >>
-                                  k4) != 0) {
-                        (*raster) = colour;
-                    }
-
-                    raster++;
-                    j += l3;
-                    k += i4;
-                }
-
-                if (j_ == 3) {
-                    break;
-                }
-
-                j = (j & (texture_area + texture_size - 1)) + (l2 & 0x600000);
-
-                k4 = l2 >> 23;
-                l2 += i3;
-            }
-        }
-    }
-}
-
-static void scene_texture64_scanline(int32_t *restrict raster,
-                                     int32_t *restrict texture, int k, int l,
-                                     int i1, int j1, int k1, int l1, int length,
-                                     int k2, int l2) {
-    // 2 ** 6 = 64
-    static const int texture_shift = 6;
-    int texture_size = (int)pow(2, texture_shift);
-    const int texture_area = (texture_size * texture_size) - texture_size;
-
-    if (length <= 0) {
-        return;
-    }
-
-    int i = 0;
-    int j = 0;
-    int i3 = 0;
-    int j3 = 0;
-    l2 <<= 2; // * 4
-
-    if (i1 != 0) {
-        i3 = (k / i1) << texture_shift;
-        j3 = (l / i1) << texture_shift;
-    }
-
-    if (i3 < 0) {
-        i3 = 0;
-    } else if (i3 > texture_area) {
-        i3 = texture_area;
-    }
-
-    for (int i_ = length; i_ > 0; i_ -= 16) {
-        k += j1;
-        l += k1;
-        i1 += l1;
-        i = i3;
-        j = j3;
-
-        if (i1 != 0) {
-            i3 = (k / i1) << texture_shift;
-            j3 = (l / i1) << texture_shift;
-        }
-
-        if (i3 < 0) {
-            i3 = 0;
-        } else if (i3 > texture_area) {
-            i3 = texture_area;
-        }
-
-        int k3 = (i3 - i) >> 4;
-        int l3 = (j3 - j) >> 4;
-        int32_t j4 = k2 >> 20;
-
-        i += k2 & 0xc0000;
-        k2 += l2;
-
-        if (i_ < 16) {
-            for (int j_ = 0; j_ < i_; j_++) {
-                (*raster++) =
-                    texture[(j & texture_area) + (i >> texture_shift)] >> j4;
-
-                i += k3;
-                j += l3;
-
-                if ((j_ & 3) == 3) {
-                    i = (i & (texture_area + texture_size - 1)) +
-                        (k2 & 0xc0000);
-
-                    j4 = k2 >> 20;
-                    k2 += l2;
-                }
-            }
-        } else {
-            for (int j_ = 0; j_ < 4; j_++) {
-                for (int k_ = 0; k_ < 4; k_++) {
-                    (*raster++) =
-                        texture[(j & texture_area) + (i >> texture_shift)] >>
-                        j4;
-
-                    i += k3;
-                    j += l3;
-                }
-
-                if (j_ == 3) {
-                    break;
-                }
-
-                i = (i & (texture_area + texture_size - 1)) + (k2 & 0xc0000);
-                j4 = k2 >> 20;
-                k2 += l2;
-            }
-        }
-    }
+static int scene_has_model(Scene *scene, GameModel *model) {
+    return model->scene_index >= 0 && model->scene_index < scene->model_count &&
+           scene->models[model->scene_index] == model;
 }
 
-static void scene_texture64_alphakey_scanline(int32_t *restrict raster,
-                                              int32_t *restrict texture, int l,
-                                              int i1, int j1, int k1, int l1,
-                                              int i2, int length, int l2,
-                                              int i3) {
-    // 2 ** 6 = 64
-    static const int texture_shift = 6;
-    const int texture_size = (int)pow(2, texture_shift);
-    const int texture_area = (texture_size * texture_size) - texture_size;
-
-    if (length <= 0) {
+/* adding a model that's already in the scene does nothing */
+void scene_add_model(Scene *scene, GameModel *model) {
+    if (model == NULL) {
+        mud_error("Warning tried to add null object!\n");
         return;
     }
 
-    int colour = 0;
-    int j = 0;
-    int k = 0;
-    int j3 = 0;
-    int k3 = 0;
-    i3 <<= 2;
-
-    if (j1 != 0) {
-        j3 = (l / j1) << texture_shift;
-        k3 = (i1 / j1) << texture_shift;
-    }
-
-    if (j3 < 0) {
-        j3 = 0;
-    } else if (j3 > texture_area) {
-        j3 = texture_area;
-    }
-
-    for (int i_ = length; i_ > 0; i_ -= 16) {
-        l += k1;
-        i1 += l1;
-        j1 += i2;
-        j = j3;
-        k = k3;
-
-        if (j1 != 0) {
-            j3 = (l / j1) << texture_shift;
-            k3 = (i1 / j1) << texture_shift;
-        }
-
-        if (j3 < 0) {
-            j3 = 0;
-        } else if (j3 > texture_area) {
-            j3 = texture_area;
-        }
-
-        int l3 = (j3 - j) >> 4;
-        int i4 = (k3 - k) >> 4;
-        int k4 = l2 >> 20;
-
-        j += l2 & 0xc0000;
-        l2 += i3;
-
-        if (i_ < 16) {
-            for (int j_ = 0; j_ < i_; j_++) {
-                if ((colour =
-                         texture[(k & texture_area) + (j >> texture_shift)] >>
-                         k4) != 0) {
-                    (*raster) = colour;
-                }
-
-                raster++;
-                j += l3;
-                k += i4;
-
-                if ((j_ & 3) == 3) {
-                    j = (j & (texture_area + texture_size - 1)) +
-                        (l2 & 0xc0000);
-
-                    k4 = l2 >> 20;
-                    l2 += i3;
-                }
-            }
-        } else {
-            for (int j_ = 0; j_ < 4; j_++) {
-                for (int k_ = 0; k_ < 4; k_++) {
-                    if ((colour = texture[(k & texture_area) +
-                                          (j >> texture_shift)] >>
-                                  k4) != 0) {
-                        (*raster) = colour;
-                    }
-
-                    raster++;
-                    j += l3;
-                    k += i4;
-                }
-
-                if (j_ == 3) {
-                    break;
-                }
-
-                j = (j & (texture_area + texture_size - 1)) + (l2 & 0xc0000);
-                k4 = l2 >> 20;
-                l2 += i3;
-            }
-        }
-    }
-}
-
-static void scene_colour_translucent_scanline(int32_t *restrict raster, int i,
-                                              int32_t *restrict ramp,
-                                              int ramp_index, int ramp_inc) {
-    /* If i >= 0, nothing to render */
-    if (i >= 0) {
+    if (scene_has_model(scene, model)) {
         return;
     }
 
-    /* Multiply ramp increment by 4 as before */
-    ramp_inc *= 4;
-
-    /*
-     * Grab initial color from ramp. Main loop handles sets of 16 pixels
-     * in groups of 4, updating 'colour' (ew br*tish) after each 4-pixel block.
-     */
-    int colour = ramp[(ramp_index / RAMP_SIZE) & 0xff];
-    ramp_index += ramp_inc;
-
-    /* Each group of 16 pixels in the original code used 4x(4 pixel writes). */
-    int length = i / 16;
-    
-    for (int block_i = length; block_i < 0; block_i++) {
-
-#define WRITE_4_PIXELS() do {                                        \
-    *raster = colour + ((*(raster + 1) >> 1) & 0x7f7f7f); raster++;   \
-    *raster = colour + ((*(raster + 1) >> 1) & 0x7f7f7f); raster++;   \
-    *raster = colour + ((*(raster + 1) >> 1) & 0x7f7f7f); raster++;   \
-    *raster = colour + ((*(raster + 1) >> 1) & 0x7f7f7f); raster++;   \
-    colour = ramp[(ramp_index / RAMP_SIZE) & 0xff];                  \
-    ramp_index += ramp_inc;                                          \
-} while(0)
-
-        WRITE_4_PIXELS();  /* j=0 */
-        WRITE_4_PIXELS();  /* j=1 */
-        WRITE_4_PIXELS();  /* j=2 */
-        WRITE_4_PIXELS();  /* j=3 */
-#undef WRITE_4_PIXELS
-    }
-
-    /*
-     * Remainder pass (i % 16 leftover pixels). length = -(i % 16).
-     * The code does small strips, updating color after each group of 4 pixels.
-     */
-    length = -(i % 16); /* how many leftover pixels (0..15) */
-
-    for (int pix_i = 0; pix_i < length; pix_i++) {
-        *raster = colour + ((*(raster + 1) >> 1) & 0x7f7f7f);
-        raster++;
-
-        if ((pix_i & 3) == 3) {
-            colour = ramp[(ramp_index / RAMP_SIZE) & 0xff];
-            ramp_index += ramp_inc * 2;
-        }
+    if (scene->model_count < scene->max_model_count) {
+        model->scene_index = scene->model_count;
+        scene->models[scene->model_count++] = model;
+        scene->cull_dirty = 1;
     }
 }
 
-
-static void scene_colour_scanline(int32_t *restrict raster, int i,
-                                  int32_t *restrict ramp, int ramp_index,
-                                  int ramp_inc) {
-    if (i >= 0) {
+/* the last model takes the place of the removed one */
+void scene_remove_model(Scene *scene, GameModel *model) {
+    if (model == NULL || !scene_has_model(scene, model)) {
         return;
     }
 
-    /*
-     * RAMP_WIDE decides if we step in blocks of 2 or 4 horizontally.
-     * Default inner loop is either 8 or 16px.
-     */
-    int step = (RAMP_WIDE ? 2 : 4);
-    ramp_inc *= (RAMP_WIDE ? 2 : 4);
-
-    int colour = ramp[(ramp_index / RAMP_SIZE) & 0xff];
-    ramp_index += ramp_inc;
-
-    int block_size = (RAMP_WIDE ? 8 : 16);   /* how many pixels per block */
-    int length = i / block_size;
-
-    /* MAIN BLOCK LOOP */
-    for (int block_i = length; block_i < 0; block_i++) {
-#define WRITE_BLOCK() do {                              \
-    for (int k_ = 0; k_ < step; k_++) {                 \
-        *raster++ = colour;                             \
-    }                                                   \
-    colour = ramp[(ramp_index / RAMP_SIZE) & 0xff];     \
-    ramp_index += ramp_inc;                             \
-} while(0)
-
-        WRITE_BLOCK();  /* j=0 */
-        WRITE_BLOCK();  /* j=1 */
-        WRITE_BLOCK();  /* j=2 */
-        WRITE_BLOCK();  /* j=3 */
-#undef WRITE_BLOCK
-    }
-
-    /*
-     * Remainder pass: i % block_size leftover pixels
-     * length = -(i % block_size)
-     */
-    length = -(i % block_size);
-    int ramp_flag = (RAMP_WIDE ? 1 : 3);
-
-    for (int pix_i = 0; pix_i < length; pix_i++) {
-        *raster++ = colour;
-        if ((pix_i & ramp_flag) == ramp_flag) {
-            if (RAMP_WIDE) {
-                colour = ramp[(ramp_index >> 8) & 0xff];
-            } else {
-                colour = ramp[(ramp_index / RAMP_SIZE) & 0xff];
-            }
-            ramp_index += ramp_inc;
-        }
-    }
-}
+    int index = model->scene_index;
+    GameModel *last = scene->models[--scene->model_count];
 
-#endif /* RENDER_SW */
+    scene->models[index] = last;
+    scene->models[scene->model_count] = NULL;
 
-void scene_add_model(Scene *scene, GameModel *model) {
-    if (model == NULL) {
-        mud_error("Warning tried to add null object!\n");
-        return;
+    if (last != NULL) {
+        last->scene_index = index;
     }
 
-    if (scene->model_count < scene->max_model_count) {
-        scene->models[scene->model_count++] = model;
-    }
-}
-
-void scene_remove_model(Scene *scene, GameModel *model) {
-    for (int i = 0; i < scene->model_count; i++) {
-        if (scene->models[i] == model) {
-            scene->models[i] = NULL;
-            scene->model_count--;
-
-            for (int j = i; j < scene->model_count; j++) {
-                scene->models[j] = scene->models[j + 1];
-            }
-        }
-    }
+    model->scene_index = -1;
+    scene->cull_dirty = 1;
 }
 
 void scene_null_model(Scene *scene, GameModel *model) {
-    for (int i = 0; i < scene->model_count; i++) {
-        if (scene->models[i] == model) {
-            scene->models[i] = NULL;
-        }
+    if (model != NULL && scene_has_model(scene, model)) {
+        scene->models[model->scene_index] = NULL;
+        scene->cull_dirty = 1;
     }
 }
 
@@ -843,6 +335,7 @@ void scene_dispose(Scene *scene) {
     scene_clear(scene);
 
     scene->model_count = 0;
+    scene->cull_dirty = 1;
 }
 
 void scene_clear(Scene *scene) {
@@ -1304,7 +797,198 @@ void scene_render_polygon_2d_face(Scene *scene, int face) {
     }
 }
 
+static int scene_cull_cell_index(int x, int z) {
+    int cell_x = x / SCENE_CULL_CELL_SIZE;
+    int cell_z = z / SCENE_CULL_CELL_SIZE;
+
+    if (cell_x < 0) {
+        cell_x = 0;
+    } else if (cell_x >= SCENE_CULL_GRID) {
+        cell_x = SCENE_CULL_GRID - 1;
+    }
+
+    if (cell_z < 0) {
+        cell_z = 0;
+    } else if (cell_z >= SCENE_CULL_GRID) {
+        cell_z = SCENE_CULL_GRID - 1;
+    }
+
+    return cell_x * SCENE_CULL_GRID + cell_z;
+}
+
+static int scene_cull_model_cell(GameModel *game_model) {
+    return scene_cull_cell_index((game_model->min_x + game_model->max_x) / 2,
+                                 (game_model->min_z + game_model->max_z) / 2);
+}
+
+/* transform the models in a cell if they need it, then grow the cell to fit
+ * all of them */
+static void scene_cull_cell_bounds(Scene *scene, SceneCullCell *cell) {
+    cell->min_x = 999999;
+    cell->min_y = 999999;
+    cell->min_z = 999999;
+    cell->max_x = -999999;
+    cell->max_y = -999999;
+    cell->max_z = -999999;
+
+    for (int i = cell->start; i < cell->start + cell->count; i++) {
+        GameModel *game_model = scene->models[scene->cull_models[i]];
+
+        if (game_model == NULL) {
+            continue;
+        }
+
+        game_model_apply(game_model);
+
+        if (game_model->min_x < cell->min_x) {
+            cell->min_x = game_model->min_x;
+        }
+
+        if (game_model->min_y < cell->min_y) {
+            cell->min_y = game_model->min_y;
+        }
+
+        if (game_model->min_z < cell->min_z) {
+            cell->min_z = game_model->min_z;
+        }
+
+        if (game_model->max_x > cell->max_x) {
+            cell->max_x = game_model->max_x;
+        }
+
+        if (game_model->max_y > cell->max_y) {
+            cell->max_y = game_model->max_y;
+        }
+
+        if (game_model->max_z > cell->max_z) {
+            cell->max_z = game_model->max_z;
+        }
+    }
+}
+
+/* put each model in the cell under the centre of its bounds. a model that
+ * moves later stays in its cell, which grows to fit it */
+static void scene_cull_build(Scene *scene) {
+    for (int i = 0; i < SCENE_CULL_CELLS; i++) {
+        scene->cull_cells[i].count = 0;
+    }
+
+    for (int i = 0; i < scene->model_count; i++) {
+        GameModel *game_model = scene->models[i];
+
+        if (game_model != NULL) {
+            game_model_apply(game_model);
+            scene->cull_cells[scene_cull_model_cell(game_model)].count++;
+        }
+    }
+
+    int start = 0;
+
+    for (int i = 0; i < SCENE_CULL_CELLS; i++) {
+        scene->cull_cells[i].start = start;
+        start += scene->cull_cells[i].count;
+        scene->cull_cells[i].count = 0;
+    }
+
+    for (int i = 0; i < scene->model_count; i++) {
+        GameModel *game_model = scene->models[i];
+
+        if (game_model != NULL) {
+            SceneCullCell *cell =
+                &scene->cull_cells[scene_cull_model_cell(game_model)];
+
+            scene->cull_models[cell->start + cell->count++] = i;
+        }
+    }
+
+    for (int i = 0; i < SCENE_CULL_CELLS; i++) {
+        scene_cull_cell_bounds(scene, &scene->cull_cells[i]);
+    }
+
+    scene->cull_dirty = 0;
+}
+
+/* the same test as game_model_project, against the bounds of a whole
+ * cell */
+static int scene_cull_cell_outside(SceneCullCell *cell) {
+    return cell->min_z > scene_frustum_near_z ||
+           cell->max_z < scene_frustum_far_z ||
+           cell->min_x > scene_frustum_min_x ||
+           cell->max_x < scene_frustum_max_x ||
+           cell->min_y > scene_frustum_min_y ||
+           cell->max_y < scene_frustum_max_y;
+}
+
+/* project every model in the frustum, skipping cells outside it */
+static void scene_cull_project(Scene *scene) {
+    if (scene->cull_dirty) {
+        scene_cull_build(scene);
+    }
+
+    memset(&scene->stats, 0, sizeof(SceneStats));
+
+    for (int i = 0; i < SCENE_CULL_CELLS; i++) {
+        SceneCullCell *cell = &scene->cull_cells[i];
+        int end = cell->start + cell->count;
+
+        if (cell->count == 0) {
+            continue;
+        }
+
+        /* only cells with models which moved or changed need new bounds */
+        for (int j = cell->start; j < end; j++) {
+            GameModel *game_model = scene->models[scene->cull_models[j]];
+
+            if (game_model != NULL && game_model->transform_state != 0) {
+                scene_cull_cell_bounds(scene, cell);
+                break;
+            }
+        }
+
+        if (scene_cull_cell_outside(cell)) {
+            for (int j = cell->start; j < end; j++) {
+                GameModel *game_model = scene->models[scene->cull_models[j]];
+
+                /* scene_remove_model leaves empty slots behind */
+                if (game_model != NULL) {
+                    game_model->visible = 0;
+                    scene->stats.models_culled++;
+                }
+            }
+
+            scene->stats.cells_culled++;
+            continue;
+        }
+
+        for (int j = cell->start; j < end; j++) {
+            GameModel *game_model = scene->models[scene->cull_models[j]];
+
+            if (game_model == NULL) {
+                continue;
+            }
+
+            scene->stats.models_tested++;
+
+            game_model_project(game_model, scene->camera_x, scene->camera_y,
+                               scene->camera_z, scene->camera_yaw,
+                               scene->camera_pitch, scene->camera_roll,
+                               scene->view_distance, scene->clip_near);
+
+            if (game_model->visible) {
+                scene->stats.models_projected++;
+            } else {
+                scene->stats.models_culled++;
+            }
+        }
+    }
+
+    scene->stats.models_lit = game_model_lit_count;
+    game_model_lit_count = 0;
+}
+
 void scene_render(Scene *scene) {
+    profiler_begin(PROFILE_SCENE_PROJECT);
+
     scene->interlace = scene->surface->interlace;
 
     int frustum_x =
@@ -1338,15 +1022,14 @@ void scene_render(Scene *scene) {
     scene_frustum_far_z += scene->camera_z;
     scene_frustum_near_z += scene->camera_z;
 
-    scene->models[scene->model_count] = scene->view;
+    scene_cull_project(scene);
+
     scene->view->transform_state = GAME_MODEL_TRANSFORM_RESET;
 
-    for (int i = 0; i <= scene->model_count; i++) {
-        game_model_project(scene->models[i], scene->camera_x, scene->camera_y,
-                           scene->camera_z, scene->camera_yaw,
-                           scene->camera_pitch, scene->camera_roll,
-                           scene->view_distance, scene->clip_near);
-    }
+    game_model_project(scene->view, scene->camera_x, scene->camera_y,
+                       scene->camera_z, scene->camera_yaw, scene->camera_pitch,
+                       scene->camera_roll, scene->view_distance,
+                       scene->clip_near);
 
 #ifdef RENDER_SW
     scene->visible_polygons_count = 0;
@@ -1464,24 +1147,38 @@ void scene_render(Scene *scene) {
 
     scene_initialise_polygons_2d(scene);
 
+    profiler_end(PROFILE_SCENE_PROJECT);
+
     if (scene->visible_polygons_count == 0) {
         return;
     }
 
     scene->last_visible_polygons_count = scene->visible_polygons_count;
 
-    qsort(scene->visible_polygons, scene->visible_polygons_count,
-          sizeof(GamePolygon *), scene_polygon_depth_compare);
+    profiler_begin(PROFILE_SCENE_SORT);
+
+    polygon_depth_sort(scene->visible_polygons, scene->visible_polygons_count,
+                       scene->polygon_depth_keys,
+                       scene->polygon_depth_scratch);
 
     scene_polygons_intersect_sort(scene, 100, scene->visible_polygons,
                                   scene->visible_polygons_count);
 
+    profiler_end(PROFILE_SCENE_SORT);
+    profiler_begin(PROFILE_SCENE_RASTER);
+
     for (int i = 0; i < scene->visible_polygons_count; i++) {
         GamePolygon *polygon = scene->visible_polygons[i];
         GameModel *game_model = polygon->model;
         int face = polygon->face;
 
         if (game_model == scene->view) {
+#ifdef SCENE_RASTER_THREADED
+            /* sprites are drawn straight away, so everything behind them
+             * has to be drawn first */
+            scene_raster_flush(scene);
+#endif
+
             scene_render_polygon_2d_face(scene, face);
         } else {
             int plane_index = 0;
@@ -1661,10 +1358,22 @@ void scene_render(Scene *scene) {
             }
         }
     }
+
+#ifdef SCENE_RASTER_THREADED
+    scene_raster_flush(scene);
+#endif
+
+    profiler_end(PROFILE_SCENE_RASTER);
 #elif defined(RENDER_GL)
+    profiler_end(PROFILE_SCENE_PROJECT);
+    profiler_begin(PROFILE_SCENE_RASTER);
     scene_gl_render(scene);
+    profiler_end(PROFILE_SCENE_RASTER);
 #elif defined(RENDER_3DS_GL)
+    profiler_end(PROFILE_SCENE_PROJECT);
+    profiler_begin(PROFILE_SCENE_RASTER);
     scene_3ds_gl_render(scene);
+    profiler_end(PROFILE_SCENE_RASTER);
 #endif
     scene->mouse_picking_active = 0;
 }
@@ -2316,8 +2025,80 @@ static void scene_rasterize(Scene *scene, int vertex_count, int32_t *vertices_x,
         if (face_fill >= scene->texture_count) {
             face_fill = 0;
         }
+
+#ifdef SCENE_RASTER_THREADED
+        /* loading a texture may evict one used by a queued polygon */
+        if (scene->texture_pixels[face_fill] == NULL) {
+            scene_raster_flush(scene);
+        }
+#endif
+
         scene_prepare_texture(scene, face_fill);
+    } else {
+        /* the lookup below changes face_fill when it adds a ramp */
+        int colour = face_fill;
+
+        for (int i = 0; i < RAMP_COUNT; i++) {
+            if (scene->gradient_base[i] == face_fill) {
+                scene->gradient_ramp = scene->gradient_ramps[i];
+                break;
+            }
+            if (i == RAMP_COUNT - 1) {
+#ifdef SCENE_RASTER_THREADED
+                /* the ramp being replaced may be used by a queued polygon */
+                scene_raster_flush(scene);
+#endif
+
+                int gradient_index =
+                    (int)(((float)rand() / (float)RAND_MAX) * RAMP_COUNT);
+
+                scene->gradient_base[gradient_index] = face_fill;
+                face_fill = -1 - face_fill;
+
+                int r = ((face_fill >> 10) & 0x1f) * 8;
+                int g = ((face_fill >> 5) & 0x1f) * 8;
+                int b = (face_fill & 0x1f) * 8;
+
+                for (int j = 0; j < 256; j++) {
+                    int darkness = j * j;
+                    int dark_r = (r * darkness) / 0x10000;
+                    int dark_g = (g * darkness) / 0x10000;
+                    int dark_b = (b * darkness) / 0x10000;
+
+                    scene->gradient_ramps[gradient_index]
+                                         [(RAMP_SIZE - 1) - j] =
+                        (dark_r << 16) + (dark_g << 8) + dark_b;
+                }
+                scene->gradient_ramp = scene->gradient_ramps[gradient_index];
+            }
+        }
+
+        face_fill = colour;
+    }
+
+#ifdef SCENE_RASTER_THREADED
+    if (scene->raster_thread_count > 0) {
+        scene_raster_queue(scene, vertex_count, vertices_x, vertices_y,
+                           vertices_z, face_fill, game_model->transparent);
+        return;
+    }
+#endif
 
+    scene_rasterize_span(scene, scene->scanlines, 0, scene->min_y,
+                         scene->max_y, vertex_count, vertices_x, vertices_y,
+                         vertices_z, face_fill, scene->gradient_ramp,
+                         game_model->transparent);
+}
+
+/* draw rows min_y to max_y of a polygon, whose scanlines start at row
+ * scanlines_y of scanlines */
+static void scene_rasterize_span(Scene *scene, Scanline *scanlines,
+                                 int scanlines_y, int min_y, int max_y,
+                                 int vertex_count, int32_t *vertices_x,
+                                 int32_t *vertices_y, int32_t *vertices_z,
+                                 int face_fill, int32_t *gradient_ramp,
+                                 int transparent) {
+    if (face_fill >= 0) {
         int vertex_x = vertices_x[0];
         int vertex_y = vertices_y[0];
         int vertex_z = vertices_z[0];
@@ -2350,9 +2131,9 @@ static void scene_rasterize(Scene *scene, int vertex_count, int32_t *vertices_x,
             int i15 = i12 >> 4;
             int k15 = k13 >> 4;
 
-            int i16 = scene->min_y - scene->base_y;
+            int i16 = min_y - scene->base_y;
             int k16 = scene->width;
-            int i17 = scene->base_x + scene->min_y * k16;
+            int i17 = scene->base_x + min_y * k16;
             int8_t scanline_inc = 1;
 
             /* Offset l9,k11,i13 by the portion that min_y has advanced. */
@@ -2362,8 +2143,8 @@ static void scene_rasterize(Scene *scene, int vertex_count, int32_t *vertices_x,
 
             if (scene->interlace) {
                 /* If odd line, skip one to align with even lines. */
-                if ((scene->min_y & 1) == 1) {
-                    scene->min_y++;
+                if ((min_y & 1) == 1) {
+                    min_y++;
                     l9  += i11;
                     k11 += k12;
                     i13 += i14;
@@ -2379,8 +2160,8 @@ static void scene_rasterize(Scene *scene, int vertex_count, int32_t *vertices_x,
 
             if (!scene->texture_back_transparent[face_fill]) {
                 /* Non-alpha KEY path */
-                for (int y = scene->min_y; y < scene->max_y; y += scanline_inc) {
-                    Scanline *scanline = &scene->scanlines[y];
+                for (int y = min_y; y < max_y; y += scanline_inc) {
+                    Scanline *scanline = &scanlines[y - scanlines_y];
                     int j = scanline->start_x >> 8;
                     int i18 = scanline->end_x >> 8;
                     int length = i18 - j;
@@ -2411,7 +2192,7 @@ static void scene_rasterize(Scene *scene, int vertex_count, int32_t *vertices_x,
                     /* Recompute length after clipping */
                     length = i18 - j;
                     if (length > 0) {
-                        scene_texture128_scanline(
+                        scanline_kernels.texture128(
                             scene->raster + (i17 + j),
                             scene->texture_pixels[face_fill],
                             (l9 + k14 * j), (k11 + i15 * j), (i13 + k15 * j),
@@ -2428,8 +2209,8 @@ static void scene_rasterize(Scene *scene, int vertex_count, int32_t *vertices_x,
             }
 
             /* Alpha-KEY path */
-            for (int y = scene->min_y; y < scene->max_y; y += scanline_inc) {
-                Scanline *scanline = &scene->scanlines[y];
+            for (int y = min_y; y < max_y; y += scanline_inc) {
+                Scanline *scanline = &scanlines[y - scanlines_y];
                 int j = scanline->start_x >> 8;
                 int k18 = scanline->end_x >> 8;
                 int length = k18 - j;
@@ -2456,7 +2237,7 @@ static void scene_rasterize(Scene *scene, int vertex_count, int32_t *vertices_x,
 
                 length = k18 - j;
                 if (length > 0) {
-                    scene_texture128_alphakey_scanline(
+                    scanline_kernels.texture128_alphakey(
                         scene->raster + (i17 + j),
                         scene->texture_pixels[face_fill],
                         (l9 + k14 * j), (k11 + i15 * j), (i13 + k15 * j),
@@ -2488,9 +2269,9 @@ static void scene_rasterize(Scene *scene, int vertex_count, int32_t *vertices_x,
         int j15 = j12 >> 4;
         int l15 = l13 >> 4;
 
-        int j16 = scene->min_y - scene->base_y;
+        int j16 = min_y - scene->base_y;
         int l16 = scene->width;
-        int j17 = scene->base_x + scene->min_y * l16;
+        int j17 = scene->base_x + min_y * l16;
         int8_t scanline_inc = 1;
 
         i10 += j11 * j16;
@@ -2498,8 +2279,8 @@ static void scene_rasterize(Scene *scene, int vertex_count, int32_t *vertices_x,
         j13 += j14 * j16;
 
         if (scene->interlace) {
-            if ((scene->min_y & 1) == 1) {
-                scene->min_y++;
+            if ((min_y & 1) == 1) {
+                min_y++;
                 i10  += j11;
                 l11  += l12;
                 j13  += j14;
@@ -2514,8 +2295,8 @@ static void scene_rasterize(Scene *scene, int vertex_count, int32_t *vertices_x,
 
         if (!scene->texture_back_transparent[face_fill]) {
             /* Non-alpha KEY path */
-            for (int y = scene->min_y; y < scene->max_y; y += scanline_inc) {
-                Scanline *scanline = &scene->scanlines[y];
+            for (int y = min_y; y < max_y; y += scanline_inc) {
+                Scanline *scanline = &scanlines[y - scanlines_y];
                 int j = scanline->start_x >> 8;
                 int k19 = scanline->end_x >> 8;
                 int length = k19 - j;
@@ -2541,7 +2322,7 @@ static void scene_rasterize(Scene *scene, int vertex_count, int32_t *vertices_x,
                 }
                 length = k19 - j;
                 if (length > 0) {
-                    scene_texture64_scanline(
+                    scanline_kernels.texture64(
                         scene->raster + (j17 + j),
                         scene->texture_pixels[face_fill],
                         (i10 + l14 * j), (l11 + j15 * j), (j13 + l15 * j),
@@ -2557,8 +2338,8 @@ static void scene_rasterize(Scene *scene, int vertex_count, int32_t *vertices_x,
         }
 
         /* Alpha-KEY path */
-        for (int y = scene->min_y; y < scene->max_y; y += scanline_inc) {
-            Scanline *scanline = &scene->scanlines[y];
+        for (int y = min_y; y < max_y; y += scanline_inc) {
+            Scanline *scanline = &scanlines[y - scanlines_y];
             int j = scanline->start_x >> 8;
             int i20 = scanline->end_x >> 8;
             int l21 = i20 - j;
@@ -2584,7 +2365,7 @@ static void scene_rasterize(Scene *scene, int vertex_count, int32_t *vertices_x,
             }
             l21 = i20 - j;
             if (l21 > 0) {
-                scene_texture64_alphakey_scanline(
+                scanline_kernels.texture64_alphakey(
                     scene->raster + (j17 + j),
                     scene->texture_pixels[face_fill],
                     (i10 + l14 * j), (l11 + j15 * j), (j13 + l15 * j),
@@ -2599,53 +2380,23 @@ static void scene_rasterize(Scene *scene, int vertex_count, int32_t *vertices_x,
         return;
     }
 
-    /* -------------- COLORED (face_fill < 0) -------------- */
-    for (int i = 0; i < RAMP_COUNT; i++) {
-        if (scene->gradient_base[i] == face_fill) {
-            scene->gradient_ramp = scene->gradient_ramps[i];
-            break;
-        }
-        if (i == RAMP_COUNT - 1) {
-            int gradient_index =
-                (int)(((float)rand() / (float)RAND_MAX) * RAMP_COUNT);
-
-            scene->gradient_base[gradient_index] = face_fill;
-            face_fill = -1 - face_fill;
-
-            int r = ((face_fill >> 10) & 0x1f) * 8;
-            int g = ((face_fill >> 5) & 0x1f) * 8;
-            int b = (face_fill & 0x1f) * 8;
-
-            for (int j = 0; j < 256; j++) {
-                int darkness = j * j;
-                int dark_r = (r * darkness) / 0x10000;
-                int dark_g = (g * darkness) / 0x10000;
-                int dark_b = (b * darkness) / 0x10000;
-
-                scene->gradient_ramps[gradient_index][(RAMP_SIZE - 1) - j] =
-                    (dark_r << 16) + (dark_g << 8) + dark_b;
-            }
-            scene->gradient_ramp = scene->gradient_ramps[gradient_index];
-        }
-    }
-
     int i2 = scene->width;
-    int l2 = scene->base_x + scene->min_y * i2;
+    int l2 = scene->base_x + min_y * i2;
     int8_t scanline_inc = 1;
 
     if (scene->interlace) {
-        if ((scene->min_y & 1) == 1) {
-            scene->min_y++;
+        if ((min_y & 1) == 1) {
+            min_y++;
             l2 += i2;
         }
         i2 <<= 1;      /* double stepping horizontally */
         scanline_inc = 2;
     }
 
-    if (game_model->transparent) {
+    if (transparent) {
         /* -------------- TRANSLUCENT RAMP FILL -------------- */
-        for (int y = scene->min_y; y < scene->max_y; y += scanline_inc) {
-            Scanline *scanline = &scene->scanlines[y];
+        for (int y = min_y; y < max_y; y += scanline_inc) {
+            Scanline *scanline = &scanlines[y - scanlines_y];
             int j   = scanline->start_x >> 8;
             int k4  = scanline->end_x >> 8;
             int k6  = k4 - j;
@@ -2670,8 +2421,8 @@ static void scene_rasterize(Scene *scene, int vertex_count, int32_t *vertices_x,
             }
             k6 = k4 - j;
             if (k6 > 0) {
-                scene_colour_translucent_scanline(
-                    scene->raster + (l2 + j), -k6, scene->gradient_ramp,
+                scanline_kernels.colour_translucent(
+                    scene->raster + (l2 + j), -k6, gradient_ramp,
                     ramp_index, ramp_inc);
             }
 
@@ -2681,8 +2432,8 @@ static void scene_rasterize(Scene *scene, int vertex_count, int32_t *vertices_x,
     }
 
     /* -------------- OPAQUE RAMP FILL -------------- */
-    for (int y = scene->min_y; y < scene->max_y; y += scanline_inc) {
-        Scanline *scanline = &scene->scanlines[y];
+    for (int y = min_y; y < max_y; y += scanline_inc) {
+        Scanline *scanline = &scanlines[y - scanlines_y];
         int j  = scanline->start_x >> 8;
         int k5 = scanline->end_x >> 8;
         int i7 = k5 - j;
@@ -2705,12 +2456,229 @@ static void scene_rasterize(Scene *scene, int vertex_count, int32_t *vertices_x,
         }
         i7 = k5 - j;
         if (i7 > 0) {
-            scene_colour_scanline(scene->raster + (l2 + j), -i7,
-                                  scene->gradient_ramp, ramp_index, ramp_inc);
+            scanline_kernels.colour(scene->raster + (l2 + j), -i7,
+                                    gradient_ramp, ramp_index, ramp_inc);
         }
         l2 += i2;
     }
 }
+
+#ifdef SCENE_RASTER_THREADED
+/* copy the polygon's scanlines so it can be drawn after the next polygon has
+ * overwritten scene->scanlines */
+static void scene_raster_queue(Scene *scene, int vertex_count,
+                               int32_t *vertices_x, int32_t *vertices_y,
+                               int32_t *vertices_z, int face_fill,
+                               int transparent) {
+    int rows = scene->max_y - scene->min_y;
+
+    if (rows <= 0) {
+        return;
+    }
+
+    if (scene->raster_polygon_count == scene->raster_polygon_max) {
+        scene->raster_polygon_max =
+            scene->raster_polygon_max ? scene->raster_polygon_max * 2 : 256;
+
+        scene->raster_polygons =
+            realloc(scene->raster_polygons,
+                    scene->raster_polygon_max * sizeof(SceneRasterPolygon));
+    }
+
+    if (scene->raster_scanline_count + rows > scene->raster_scanline_max) {
+        while (scene->raster_scanline_count + rows >
+               scene->raster_scanline_max) {
+            scene->raster_scanline_max = scene->raster_scanline_max
+                                             ? scene->raster_scanline_max * 2
+                                             : 16384;
+        }
+
+        scene->raster_scanlines =
+            realloc(scene->raster_scanlines,
+                    scene->raster_scanline_max * sizeof(Scanline));
+    }
+
+    SceneRasterPolygon *polygon =
+        &scene->raster_polygons[scene->raster_polygon_count++];
+
+    polygon->min_y = scene->min_y;
+    polygon->max_y = scene->max_y;
+    polygon->scanline_offset = scene->raster_scanline_count;
+    polygon->face_fill = face_fill;
+    polygon->gradient_ramp = scene->gradient_ramp;
+    polygon->transparent = transparent;
+
+    /* only the first, second and last vertices are used for texturing */
+    int last = vertex_count - 1;
+
+    polygon->vertex_x[0] = vertices_x[0];
+    polygon->vertex_y[0] = vertices_y[0];
+    polygon->vertex_z[0] = vertices_z[0];
+    polygon->vertex_x[1] = vertices_x[1];
+    polygon->vertex_y[1] = vertices_y[1];
+    polygon->vertex_z[1] = vertices_z[1];
+    polygon->vertex_x[2] = vertices_x[last];
+    polygon->vertex_y[2] = vertices_y[last];
+    polygon->vertex_z[2] = vertices_z[last];
+
+    memcpy(scene->raster_scanlines + scene->raster_scanline_count,
+           scene->scanlines + scene->min_y, rows * sizeof(Scanline));
+
+    scene->raster_scanline_count += rows;
+}
+
+/* draw the part of every queued polygon between rows top and bottom, in the
+ * order they were queued */
+static void scene_raster_band(Scene *scene, int top, int bottom) {
+    for (int i = 0; i < scene->raster_polygon_count; i++) {
+        SceneRasterPolygon *polygon = &scene->raster_polygons[i];
+
+        int min_y = polygon->min_y > top ? polygon->min_y : top;
+        int max_y = polygon->max_y < bottom ? polygon->max_y : bottom;
+
+        if (min_y >= max_y) {
+            continue;
+        }
+
+        scene_rasterize_span(
+            scene, scene->raster_scanlines + polygon->scanline_offset,
+            polygon->min_y, min_y, max_y, 3, polygon->vertex_x,
+            polygon->vertex_y, polygon->vertex_z, polygon->face_fill,
+            polygon->gradient_ramp, polygon->transparent);
+    }
+}
+
+/* take bands until there are none left. run by the workers and the thread
+ * that flushed */
+static void scene_raster_work(Scene *scene) {
+    for (;;) {
+        SDL_LockMutex(scene->raster_lock);
+
+        int band = scene->raster_band_next++;
+
+        SDL_UnlockMutex(scene->raster_lock);
+
+        if (band >= scene->raster_band_count) {
+            return;
+        }
+
+        int top = band * scene->raster_band_height;
+
+        scene_raster_band(scene, top, top + scene->raster_band_height);
+
+        SDL_LockMutex(scene->raster_lock);
+
+        if (++scene->raster_bands_done == scene->raster_band_count) {
+            SDL_CondSignal(scene->raster_done);
+        }
+
+        SDL_UnlockMutex(scene->raster_lock);
+    }
+}
+
+static int scene_raster_thread(void *data) {
+    Scene *scene = data;
+    int generation = 0;
+
+    SDL_LockMutex(scene->raster_lock);
+
+    for (;;) {
+        while (scene->raster_generation == generation) {
+            SDL_CondWait(scene->raster_start, scene->raster_lock);
+        }
+
+        generation = scene->raster_generation;
+
+        SDL_UnlockMutex(scene->raster_lock);
+        scene_raster_work(scene);
+        SDL_LockMutex(scene->raster_lock);
+    }
+
+    return 0;
+}
+
+/* draw every queued polygon. long runs are split into horizontal bands
+ * which are drawn in parallel, each band keeping the painter's order */
+static void scene_raster_flush(Scene *scene) {
+    if (scene->raster_polygon_count == 0) {
+        return;
+    }
+
+    if (scene->raster_polygon_count < SCENE_RASTER_MIN_POLYGONS) {
+        scene_raster_band(scene, 0, scene->base_y + scene->clip_y);
+    } else {
+        int band_count =
+            (scene->raster_thread_count + 1) * SCENE_RASTER_BANDS_PER_THREAD;
+
+        int band_height =
+            (scene->base_y + scene->clip_y + band_count - 1) / band_count;
+
+        /* keep bands on even rows so interlacing skips the same rows */
+        band_height = (band_height + 1) & ~1;
+
+        SDL_LockMutex(scene->raster_lock);
+
+        scene->raster_band_next = 0;
+        scene->raster_band_count = band_count;
+        scene->raster_band_height = band_height;
+        scene->raster_bands_done = 0;
+        scene->raster_generation++;
+
+        SDL_CondBroadcast(scene->raster_start);
+        SDL_UnlockMutex(scene->raster_lock);
+
+        scene_raster_work(scene);
+
+        SDL_LockMutex(scene->raster_lock);
+
+        while (scene->raster_bands_done < scene->raster_band_count) {
+            SDL_CondWait(scene->raster_done, scene->raster_lock);
+        }
+
+        SDL_UnlockMutex(scene->raster_lock);
+    }
+
+    scene->raster_polygon_count = 0;
+    scene->raster_scanline_count = 0;
+}
+#endif
+
+/* start threads to help rasterize polygons. they last as long as the
+ * scene */
+void scene_set_raster_threads(Scene *scene, int thread_count) {
+#ifdef SCENE_RASTER_THREADED
+    if (scene->raster_thread_count > 0 || thread_count <= 0) {
+        return;
+    }
+
+    if (thread_count > SCENE_RASTER_THREADS_MAX) {
+        thread_count = SCENE_RASTER_THREADS_MAX;
+    }
+
+    scene->raster_lock = SDL_CreateMutex();
+    scene->raster_start = SDL_CreateCond();
+    scene->raster_done = SDL_CreateCond();
+
+    for (int i = 0; i < thread_count; i++) {
+#ifdef SDL12
+        SDL_Thread *thread = SDL_CreateThread(scene_raster_thread, scene);
+#else
+        SDL_Thread *thread =
+            SDL_CreateThread(scene_raster_thread, "scene_raster", scene);
+#endif
+
+        if (thread == NULL) {
+            mud_error("unable to create raster thread: %s\n", SDL_GetError());
+            break;
+        }
+
+        scene->raster_thread_count++;
+    }
+#else
+    (void)scene;
+    (void)thread_count;
+#endif
+}
 #endif /* RENDER_SW */
 
 
@@ -3156,15 +3124,25 @@ void scene_allocate_textures(Scene *scene, int count, int length_64,
     scene->texture_count = count;
     scene->texture_colours = calloc(count, sizeof(int8_t *));
     scene->texture_palette = calloc(count, sizeof(int32_t *));
-    scene->texture_loaded_number = calloc(count, sizeof(int64_t));
     scene->texture_dimension = calloc(count, sizeof(int8_t));
     scene->texture_back_transparent = calloc(count, sizeof(int8_t));
     scene->texture_pixels = calloc(count, sizeof(int32_t *));
+    scene->texture_lru_prev = calloc(count, sizeof(int));
+    scene->texture_lru_next = calloc(count, sizeof(int));
 
-    scene_texture_count_loaded = 0;
+    for (int i = 0; i < 2; i++) {
+        scene->texture_lru_head[i] = -1;
+        scene->texture_lru_tail[i] = -1;
+        scene->texture_slots_used[i] = 0;
+    }
+
+    /* every texture needs a slot to be drawn from */
+    if (length_64 < 1) {
+        length_64 = 1;
+    }
 
-    for (int i = 0; i < count; i++) {
-        scene->texture_loaded_number[i] = 0;
+    if (length_128 < 1) {
+        length_128 = 1;
     }
 
     /* 64x64 rgba */
@@ -3182,153 +3160,168 @@ void scene_define_texture(Scene *scene, int id, int8_t *colours,
     scene->texture_palette[id] = palette;
     scene->texture_dimension[id] = is_128;
 
-    scene->texture_loaded_number[id] = 0;
     scene->texture_back_transparent[id] = 0;
     scene->texture_pixels[id] = NULL;
 
     scene_prepare_texture(scene, id);
 }
 
-static void scene_prepare_texture(Scene *scene, int id) {
-    if (id < 0) {
-        return;
+static void scene_texture_unlink(Scene *scene, int id) {
+    int dimension = scene->texture_dimension[id];
+    int prev = scene->texture_lru_prev[id];
+    int next = scene->texture_lru_next[id];
+
+    if (prev != -1) {
+        scene->texture_lru_next[prev] = next;
+    } else {
+        scene->texture_lru_head[dimension] = next;
     }
 
-    int max_id = 1 << 30;
-    int old_id = 0;
+    if (next != -1) {
+        scene->texture_lru_prev[next] = prev;
+    } else {
+        scene->texture_lru_tail[dimension] = prev;
+    }
+}
+
+static void scene_texture_link(Scene *scene, int id) {
+    int dimension = scene->texture_dimension[id];
+    int head = scene->texture_lru_head[dimension];
 
-    // TODO we can probably move this increment below the NULL check block
-    scene_texture_count_loaded++;
-    scene->texture_loaded_number[id] = scene_texture_count_loaded;
+    scene->texture_lru_prev[id] = -1;
+    scene->texture_lru_next[id] = head;
 
-    /* without this we eventually get undefined behaviour */
-    if (scene_texture_count_loaded == max_id - 1) {
-        scene_texture_count_loaded = 0;
-        scene->texture_loaded_number[id] = scene_texture_count_loaded;
+    if (head != -1) {
+        scene->texture_lru_prev[head] = id;
+    } else {
+        scene->texture_lru_tail[dimension] = id;
     }
 
-    if (scene->texture_pixels[id] != NULL) {
+    scene->texture_lru_head[dimension] = id;
+}
+
+/* unpack a texture into a slot if it isn't already, taking the slot of the
+ * least recently used texture of the same size once they're all in use */
+static void scene_prepare_texture(Scene *scene, int id) {
+    if (id < 0) {
         return;
     }
 
-    if (scene->texture_dimension[id] == 0) {
-        // is 64 pixels wide
-        for (int i = 0; i < scene->length_64; i++) {
-            if (scene->texture_colours_64[i] == NULL) {
-                scene->texture_colours_64[i] =
-                    calloc(128 * 128, sizeof(int32_t));
+    int dimension = scene->texture_dimension[id];
 
-                scene->texture_pixels[id] = scene->texture_colours_64[i];
-                scene_set_texture_pixels(scene, id);
-                return;
-            }
-        }
-    } else {
-        // is 128 wide
-        for (int i = 0; i < scene->length_128; i++) {
-            if (scene->texture_colours_128[i] == NULL) {
-                scene->texture_colours_128[i] =
-                    calloc(256 * 256, sizeof(int32_t));
-
-                scene->texture_pixels[id] = scene->texture_colours_128[i];
-                scene_set_texture_pixels(scene, id);
-                return;
-            }
+    if (scene->texture_pixels[id] != NULL) {
+        if (scene->texture_lru_head[dimension] != id) {
+            scene_texture_unlink(scene, id);
+            scene_texture_link(scene, id);
         }
-    }
 
-    for (int i = 0; i < scene->texture_count; i++) {
-        if (i != id &&
-            scene->texture_dimension[i] == scene->texture_dimension[id] &&
-            scene->texture_pixels[i] != NULL &&
-            scene->texture_loaded_number[i] < max_id) {
-            max_id = scene->texture_loaded_number[i];
-            old_id = i;
-        }
+        scene->stats.textures_hit++;
+        return;
     }
 
-    free(scene->texture_pixels[id]);
+    scene->stats.textures_missed++;
+
+    int32_t **slots =
+        dimension ? scene->texture_colours_128 : scene->texture_colours_64;
 
-    scene->texture_pixels[id] = scene->texture_pixels[old_id];
-    scene->texture_pixels[old_id] = NULL;
+    int slot_count = dimension ? scene->length_128 : scene->length_64;
 
+    if (scene->texture_slots_used[dimension] < slot_count) {
+        int slot = scene->texture_slots_used[dimension]++;
+        int texture_width = dimension ? 128 : 64;
+
+        /* 4 shades of every pixel */
+        slots[slot] =
+            calloc(texture_width * texture_width * 4, sizeof(int32_t));
+
+        scene->texture_pixels[id] = slots[slot];
+    } else {
+        int old_id = scene->texture_lru_tail[dimension];
+
+        scene_texture_unlink(scene, old_id);
+
+        scene->texture_pixels[id] = scene->texture_pixels[old_id];
+        scene->texture_pixels[old_id] = NULL;
+
+        scene->stats.textures_evicted++;
+    }
+
+    scene_texture_link(scene, id);
     scene_set_texture_pixels(scene, id);
 }
 
 static void scene_set_texture_pixels(Scene *scene, int id) {
     int texture_width = scene->texture_dimension[id] ? 128 : 64;
+    int texture_area = texture_width * texture_width;
+    int32_t *palette = scene->texture_palette[id];
+    int8_t *texture_colours = scene->texture_colours[id];
     int32_t *colours = scene->texture_pixels[id];
+
+    /* each palette entry in the 4 shades, so every pixel is only looked up */
+    int32_t shades[4][256];
+
+    for (int i = 0; i < 256; i++) {
+        int colour = palette[i] & 0xf8f8ff;
+
+        if (colour == 0) {
+            colour = 1;
+        } else if (colour == 0xf800ff) {
+            colour = 0;
+        }
+
+        shades[0][i] = colour;
+        shades[1][i] = (colour - (colour >> 3)) & 0xf8f8ff;
+        shades[2][i] = (colour - (colour >> 2)) & 0xf8f8ff;
+
+        shades[3][i] = (colour - (colour >> 2) - (colour >> 3)) & 0xf8f8ff;
+    }
+
     int colour_count = 0;
 
     for (int x = 0; x < texture_width; x++) {
         for (int y = 0; y < texture_width; y++) {
-            int colour =
-                scene->texture_palette
-                    [id]
-                    [scene->texture_colours[id][y + x * texture_width] & 0xff];
+            int index = texture_colours[y + x * texture_width] & 0xff;
 
-            colour &= 0xf8f8ff;
-
-            if (colour == 0) {
-                colour = 1;
-            } else if (colour == 0xf800ff) {
-                colour = 0;
+            if (shades[0][index] == 0) {
                 scene->texture_back_transparent[id] = 1;
             }
 
-            colours[colour_count++] = colour;
-        }
-    }
-
-    for (int i = 0; i < colour_count; i++) {
-        int32_t colour = colours[i];
-
-        colours[colour_count + i] = (colour - (colour >> 3)) & 0xf8f8ff;
-        colours[colour_count * 2 + i] = (colour - (colour >> 2)) & 0xf8f8ff;
+            colours[colour_count] = shades[0][index];
+            colours[texture_area + colour_count] = shades[1][index];
+            colours[texture_area * 2 + colour_count] = shades[2][index];
+            colours[texture_area * 3 + colour_count] = shades[3][index];
 
-        colours[colour_count * 3 + i] =
-            (colour - (colour >> 2) - (colour >> 3)) & 0xf8f8ff;
+            colour_count++;
+        }
     }
 }
 
 #ifdef RENDER_SW
+/* move a texture down a row. each shade moves with it, and it counts as used
+ * so it keeps its place as it moves */
 void scene_scroll_texture(Scene *scene, int id) {
     if (scene->texture_pixels[id] == NULL) {
         return;
     }
 
+    if (scene->texture_lru_head[scene->texture_dimension[id]] != id) {
+        scene_texture_unlink(scene, id);
+        scene_texture_link(scene, id);
+    }
+
     int32_t *colours = scene->texture_pixels[id];
-    int S = SCROLL_TEXTURE_SIZE;
-    int area = SCROLL_TEXTURE_AREA; // = S * S
-    int32_t tmp_row[/* max S */ 512];
-    memcpy(tmp_row, &colours[area - S], S * sizeof(int32_t));
-    memmove(&colours[S],
-            &colours[0],
-            (area - S) * sizeof(int32_t));
-
-    memcpy(&colours[0],
-           tmp_row,
-           S * sizeof(int32_t));
-
-    int32_t *base_layer = colours;
-    int32_t *layer1 = colours + area;
-    int32_t *layer2 = colours + 2 * area;
-    int32_t *layer3 = colours + 3 * area;
-
-    for (int i = 0; i < area; i++) {
-        int32_t c = base_layer[i];
-
-        int32_t c_sub1 = c - (c >> 3);         // used for layer1
-        int32_t c_sub2 = c - (c >> 2);         // used for layer2
-        int32_t c_sub3 = c_sub2 - (c >> 3);    // c - (c>>2) - (c>>3)
-
-        c_sub1 &= 0xf8f8ff;
-        c_sub2 &= 0xf8f8ff;
-        c_sub3 &= 0xf8f8ff;
-
-        layer1[i] = c_sub1;
-        layer2[i] = c_sub2;
-        layer3[i] = c_sub3;
+    int32_t last_row[SCROLL_TEXTURE_SIZE];
+
+    for (int i = 0; i < 4; i++) {
+        int32_t *shade = colours + (i * SCROLL_TEXTURE_AREA);
+
+        memcpy(last_row, shade + SCROLL_TEXTURE_AREA - SCROLL_TEXTURE_SIZE,
+               sizeof(last_row));
+
+        memmove(shade + SCROLL_TEXTURE_SIZE, shade,
+                (SCROLL_TEXTURE_AREA - SCROLL_TEXTURE_SIZE) * sizeof(int32_t));
+
+        memcpy(shade, last_row, sizeof(last_row));
     }
 }
 #endif
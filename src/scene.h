@@ -39,6 +39,7 @@ typedef struct Scene Scene;
 
 #include "game-model.h"
 #include "polygon.h"
+#include "profiler.h"
 #include "scanline.h"
 #include "surface.h"
 #include "utility.h"
@@ -55,11 +56,6 @@ typedef struct Scene Scene;
 
 #define VERTEX_COUNT 40 // ambigious - SCENE_VERTEX_COUNT ?
 #define RAMP_COUNT 50
-#define RAMP_SIZE 256
-
-/* originally Scene had a wide_band property and a second colour_scanline
- * function that was unused */
-#define RAMP_WIDE 0
 
 /* originally 12345678 - this way we save on memory. */
 #define COLOUR_TRANSPARENT INT16_MAX
@@ -68,6 +64,87 @@ typedef struct Scene Scene;
 #define SCROLL_TEXTURE_SIZE 64
 #define SCROLL_TEXTURE_AREA (SCROLL_TEXTURE_SIZE * SCROLL_TEXTURE_SIZE)
 
+/* polygons allocated for every scene, whatever size was asked for */
+#define SCENE_MAX_POLYGONS 32767
+
+/* models are grouped by where they are in the region, 12 tiles a side so
+ * each terrain chunk gets a cell */
+#define SCENE_CULL_GRID 8
+#define SCENE_CULL_CELL_SIZE (12 * 128)
+#define SCENE_CULL_CELLS (SCENE_CULL_GRID * SCENE_CULL_GRID)
+
+#if defined(RENDER_SW) && !defined(WII) && !defined(_3DS) &&                   \
+    !defined(EMSCRIPTEN)
+#define SCENE_RASTER_THREADED
+#endif
+
+/* max number of extra threads rasterizing polygons */
+#define SCENE_RASTER_THREADS_MAX 16
+
+/* the screen is split into this many horizontal bands per thread, so a
+ * thread that finishes early can take another */
+#define SCENE_RASTER_BANDS_PER_THREAD 4
+
+/* runs of fewer queued polygons are drawn on the calling thread */
+#define SCENE_RASTER_MIN_POLYGONS 64
+
+#ifdef SCENE_RASTER_THREADED
+/* a polygon waiting to be rasterized, with its own copy of its scanlines */
+typedef struct SceneRasterPolygon {
+    int min_y;
+    int max_y;
+    int scanline_offset;
+    int face_fill;
+    int32_t *gradient_ramp;
+    int transparent;
+
+    /* first, second and last vertex */
+    int32_t vertex_x[3];
+    int32_t vertex_y[3];
+    int32_t vertex_z[3];
+} SceneRasterPolygon;
+#endif
+
+/* the models under one part of the region and the bounds of all of them,
+ * which are tested against the frustum before any of the models are */
+typedef struct SceneCullCell {
+    /* range in scene->cull_models */
+    int start;
+    int count;
+
+    int min_x;
+    int max_x;
+    int min_y;
+    int max_y;
+    int min_z;
+    int max_z;
+} SceneCullCell;
+
+/* counted again every frame */
+typedef struct SceneStats {
+    /* models whose own bounds were tested against the frustum */
+    int models_tested;
+
+    /* models outside the frustum, including those in culled cells */
+    int models_culled;
+
+    /* models in the frustum, which had their vertices projected */
+    int models_projected;
+
+    int cells_culled;
+
+    /* models which had their face and vertex intensities worked out again
+     * since the last frame */
+    int models_lit;
+
+    /* textured faces whose texture was already unpacked */
+    int textures_hit;
+
+    /* textures unpacked into a free slot or one taken from another */
+    int textures_missed;
+    int textures_evicted;
+} SceneStats;
+
 extern int scene_frustum_max_x;
 extern int scene_frustum_min_x;
 extern int scene_frustum_max_y;
@@ -75,8 +152,6 @@ extern int scene_frustum_min_y;
 extern int scene_frustum_far_z;
 extern int scene_frustum_near_z;
 
-extern int64_t scene_texture_count_loaded;
-
 #if defined(RENDER_GL) || defined(RENDER_3DS_GL)
 typedef enum {
     /* no picking */
@@ -108,6 +183,17 @@ struct Scene {
     int max_mouse_picked;
     GameModel **models;
     GameModel *view;
+
+    SceneCullCell cull_cells[SCENE_CULL_CELLS];
+
+    /* indexes into models, sorted by cell */
+    int *cull_models;
+
+    /* models were added or removed since the cells were filled */
+    int8_t cull_dirty;
+
+    SceneStats stats;
+
     int32_t *raster;
     int32_t gradient_base[RAMP_COUNT];
     int32_t gradient_ramps[RAMP_COUNT][RAMP_SIZE];
@@ -116,13 +202,21 @@ struct Scene {
     int8_t **texture_colours;
     int32_t **texture_palette;
     int8_t *texture_dimension;
-    int64_t *texture_loaded_number;
     int32_t **texture_pixels;
     int8_t *texture_back_transparent;
     int32_t **texture_colours_64;
     int length_64;
     int32_t **texture_colours_128;
     int length_128;
+
+    /* unpacked textures of each size (indexed by texture_dimension), most
+     * recently used first. the last one gives up its slot when they're all
+     * taken */
+    int *texture_lru_prev;
+    int *texture_lru_next;
+    int texture_lru_head[2];
+    int texture_lru_tail[2];
+    int texture_slots_used[2];
     Surface *surface;
     Scanline *scanlines;
     int min_y;
@@ -157,6 +251,35 @@ struct Scene {
     int camera_roll;
     int visible_polygons_count;
     GamePolygon **visible_polygons;
+
+#ifdef RENDER_SW
+    /* scratch space for polygon_depth_sort */
+    uint32_t *polygon_depth_keys;
+    GamePolygon **polygon_depth_scratch;
+#endif
+
+#ifdef SCENE_RASTER_THREADED
+    /* polygons between sprites are queued and rasterized in horizontal bands
+     * on raster_thread_count threads plus the one calling scene_render */
+    int raster_thread_count;
+    SDL_mutex *raster_lock;
+    SDL_cond *raster_start;
+    SDL_cond *raster_done;
+    int raster_generation;
+    int raster_band_next;
+    int raster_band_count;
+    int raster_band_height;
+    int raster_bands_done;
+
+    SceneRasterPolygon *raster_polygons;
+    int raster_polygon_count;
+    int raster_polygon_max;
+
+    Scanline *raster_scanlines;
+    int raster_scanline_count;
+    int raster_scanline_max;
+#endif
+
     int sprite_count;
     int *sprite_id;
     int *sprite_x;
@@ -203,6 +326,15 @@ struct Scene {
 
     int gl_mouse_picked_count;
 
+#ifdef RENDER_GL
+    /* opaque models waiting to be drawn, and the element ranges they're
+     * drawn with */
+    GameModel **gl_draw_models;
+    int gl_draw_model_count;
+    GLsizei *gl_draw_counts;
+    const void **gl_draw_offsets;
+#endif
+
     float *gl_sprite_depth_bottom;
     float *gl_sprite_depth_top;
 
@@ -249,7 +381,6 @@ struct Scene {
 #endif
 };
 
-int scene_polygon_depth_compare(const void *a, const void *b);
 
 #if defined(RENDER_GL) || defined(RENDER_3DS_GL)
 int scene_gl_model_time_compare(const void *a, const void *b);
@@ -270,6 +401,7 @@ void scene_set_sprite_translate_x(Scene *scene, int i, int n);
 void scene_set_mouse_location(Scene *scene, int x, int y);
 void scene_set_bounds(Scene *scene, int width, int height);
 void scene_set_frustum(Scene *scene, int x, int y, int z);
+void scene_set_raster_threads(Scene *scene, int thread_count);
 void scene_render(Scene *scene);
 void scene_set_camera(Scene *scene, int x, int z, int y, int pitch, int yaw,
                       int roll, int distance);
@@ -30,8 +30,44 @@ int character_width[256] = {0};
 int32_t *surface_texture_pixels = NULL;
 
 #ifdef RENDER_SW
+typedef enum {
+    SURFACE_SPANS_COPY,
+    SURFACE_SPANS_ALPHA,
+    SURFACE_SPANS_MASK,
+    SURFACE_SPANS_SKIN_MASK
+} SurfaceSpansMode;
+
+/* what to draw a sprite's spans with. pixels replaces the sprite's own
+ * colours, for the tint cache */
+typedef struct SurfaceSpansPlot {
+    SurfaceSpans *spans;
+    int8_t *colours;
+    int32_t *palette;
+    int32_t *pixels;
+    SurfaceSpansMode mode;
+    int alpha;
+    int mask_colour;
+    int skin_colour;
+} SurfaceSpansPlot;
+
 static int surface_blend_alpha(int background_colour, int colour, int alpha);
 
+static void surface_pack_spans(Surface *surface, int sprite_id, int loaded);
+
+static void surface_spans_plot_new(Surface *surface, SurfaceSpansPlot *plot,
+                                   int sprite_id, SurfaceSpansMode mode);
+
+static void surface_plot_spans_scale(Surface *surface, SurfaceSpansPlot *plot,
+                                     int j, int k, int dest_pos,
+                                     int dest_offset, int width, int height,
+                                     int l1, int i2, int y_inc);
+
+static void surface_plot_spans_transform(Surface *surface,
+                                         SurfaceSpansPlot *plot, int j, int k,
+                                         int dest_pos, int width, int height,
+                                         int k1, int l1, int k2, int l2,
+                                         int y_inc);
+
 static void surface_draw_sprite_transform_mask_software(
     Surface *surface, int x, int y, int draw_width, int draw_height,
     int sprite_id, int mask_colour, int skin_colour, int skew_x, int flip);
@@ -77,6 +113,11 @@ static void surface_plot_sprite32_transform_dual_mask(
     int k, int dest_pos, int i1, int j1, int k1, int l1, int i2,
     int mask_colour, int skin_colour, int l2, int i3, int j3);
 
+static void surface_plot_sprite32_transform_tinted(
+    Surface *surface, int32_t *restrict dest, int32_t *restrict src, int j,
+    int k, int dest_pos, int width, int height, int k1, int l1, int i2, int k2,
+    int l2, int y_inc);
+
 static void surface_plot_sprite8(int32_t *restrict dest,
                                  int8_t *restrict colours,
                                  int32_t *restrict palette, int src_pos,
@@ -107,9 +148,17 @@ static void surface_plot_letter(int32_t *restrict dest,
                                 int font_data_offset);
 #endif /* RENDER_SW */
 
+static void surface_forget_tinted(Surface *surface, int sprite_id);
+static void surface_unpack_spans(Surface *surface, int sprite_id);
+
 #if defined(RENDER_GL) || defined(RENDER_3DS_GL)
 static void surface_gl_quad_new(Surface *surface, gl_quad *quad, int x, int y,
                                 int width, int height);
+static void surface_gl_buffer_indices(Surface *surface);
+#endif
+
+#ifdef RENDER_GL
+static void surface_gl_pack_circle(Surface *surface);
 #endif
 
 void init_surface_global(void) {
@@ -166,6 +215,10 @@ void surface_new(Surface *surface, int width, int height, int limit,
     surface->sprite_translate_x = calloc(limit, sizeof(int16_t));
     surface->sprite_translate_y = calloc(limit, sizeof(int16_t));
 
+#ifdef RENDER_SW
+    surface->sprite_spans = calloc(limit, sizeof(SurfaceSpans *));
+#endif
+
     surface->mud = mud;
 
 #ifdef RENDER_GL
@@ -220,29 +273,32 @@ void surface_new(Surface *surface, int width, int height, int limit,
     /* base texture { u, v } */
     vertex_buffer_gl_add_attribute(&surface->gl_flat_buffer, &attribute_offset,
                                    2);
+
+#ifdef RENDER_GL
+    /* skin colour { r, g, b } */
+    vertex_buffer_gl_add_attribute(&surface->gl_flat_buffer, &attribute_offset,
+                                   3);
+#endif
+
+    surface_gl_buffer_indices(surface);
 #endif
 
 #ifdef RENDER_GL
-#ifdef __SWITCH__
-    gl_load_texture(&surface->gl_sprite_texture, "romfs:/textures/sprites.png");
+    surface->gl_flat_quads = calloc(GL_MAX_QUADS, sizeof(gl_quad));
+#endif
 
-    for (int i = 0; i < ENTITY_TEXTURE_LENGTH; i++) {
-        char filename[32] = {0};
-        sprintf(filename, "romfs:/textures/entities_%d.png", i);
+#ifdef RENDER_GL
+    surface->gl_sprites = calloc(limit, sizeof(SurfaceGlSprite));
 
-        gl_load_texture(&surface->gl_entity_textures[i], filename);
+    for (int i = 0; i < limit; i++) {
+        surface->gl_sprites[i].page = -1;
     }
-#else
-    gl_load_texture(&surface->gl_sprite_texture,
-                    "./cache/textures/sprites.png");
 
-    for (int i = 0; i < ENTITY_TEXTURE_LENGTH; i++) {
-        char filename[32] = {0};
-        sprintf(filename, "./cache/textures/entities_%d.png", i);
+    atlas_gl_new(&surface->gl_atlas);
+    surface_gl_pack_circle(surface);
+    atlas_gl_upload(&surface->gl_atlas);
 
-        gl_load_texture(&surface->gl_entity_textures[i], filename);
-    }
-#endif
+    surface->gl_sprite_texture = surface->gl_atlas.pages[0].texture;
 
     surface->gl_dynamic_texture_buffer =
         calloc(1024 * 1024 * 3, sizeof(uint8_t));
@@ -291,9 +347,71 @@ float surface_gl_translate_y(Surface *surface, int y) {
     return gl_translate_y(y, surface->height);
 }
 
+/* every quad is two triangles over its own 4 vertices, so the indices never
+ * change and are only buffered once */
+static void surface_gl_buffer_indices(Surface *surface) {
+#ifdef RENDER_GL
+    GLuint *indices = malloc(GL_MAX_QUADS * 6 * sizeof(GLuint));
+#elif defined(RENDER_3DS_GL)
+    uint16_t *indices = surface->gl_flat_buffer.ebo;
+#endif
+
+    for (int i = 0; i < GL_MAX_QUADS; i++) {
+        int vertex_index = i * 4;
+        int index = i * 6;
+
+        indices[index] = vertex_index;
+        indices[index + 1] = vertex_index + 1;
+        indices[index + 2] = vertex_index + 2;
+        indices[index + 3] = vertex_index;
+        indices[index + 4] = vertex_index + 2;
+        indices[index + 5] = vertex_index + 3;
+    }
+
+#ifdef RENDER_GL
+    vertex_buffer_gl_bind(&surface->gl_flat_buffer);
+
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0,
+                    GL_MAX_QUADS * 6 * sizeof(GLuint), indices);
+
+    free(indices);
+#endif
+}
+
+#ifdef RENDER_GL
+/* send the quads buffered since the last upload to the vertex buffer. the
+ * first upload of a frame orphans the buffer so the driver doesn't have to
+ * wait for the last frame's draws to finish with it */
+static void surface_gl_upload_quads(Surface *surface) {
+    int uploaded = surface->gl_flat_uploaded;
+    int count = surface->gl_flat_count - uploaded;
+
+    if (count <= 0) {
+        return;
+    }
+
+    vertex_buffer_gl_bind(&surface->gl_flat_buffer);
+
+    if (uploaded == 0) {
+        glBufferData(GL_ARRAY_BUFFER, GL_MAX_QUADS * sizeof(gl_quad), NULL,
+                     GL_DYNAMIC_DRAW);
+    }
+
+    glBufferSubData(GL_ARRAY_BUFFER, uploaded * sizeof(gl_quad),
+                    count * sizeof(gl_quad),
+                    surface->gl_flat_quads + uploaded);
+
+    surface->gl_flat_uploaded = surface->gl_flat_count;
+}
+#endif
+
 void surface_gl_reset_context(Surface *surface) {
     surface->gl_flat_count = 0;
 
+#ifdef RENDER_GL
+    surface->gl_flat_uploaded = 0;
+#endif
+
 #ifdef RENDER_GL
     surface->gl_contexts[0].texture = surface->gl_sprite_texture;
     surface->gl_contexts[0].base_texture = surface->gl_sprite_texture;
@@ -421,6 +539,21 @@ void surface_gl_vertex_apply_colour(gl_quad_vertex *vertices, int length,
     }
 }
 
+#ifdef RENDER_GL
+void surface_gl_vertex_apply_skin(gl_quad_vertex *vertices, int length,
+                                  int skin_colour) {
+    float r = ((skin_colour >> 16) & 0xff) / 255.0f;
+    float g = ((skin_colour >> 8) & 0xff) / 255.0f;
+    float b = (skin_colour & 0xff) / 255.0f;
+
+    for (int i = 0; i < length; i++) {
+        vertices[i].skin_r = r;
+        vertices[i].skin_g = g;
+        vertices[i].skin_b = b;
+    }
+}
+#endif
+
 void surface_gl_vertex_apply_depth(gl_quad_vertex *vertices, int length,
                                    float depth) {
     for (int i = 0; i < length; i++) {
@@ -460,29 +593,12 @@ void surface_gl_buffer_quad(Surface *surface, gl_quad *quad, C3D_Tex *texture,
         return;
     }
 
-    int vertex_offset = surface->gl_flat_count * sizeof(gl_quad);
-    int ebo_index = surface->gl_flat_count * 4;
-
 #ifdef RENDER_GL
-    vertex_buffer_gl_bind(&surface->gl_flat_buffer);
-
-    glBufferSubData(GL_ARRAY_BUFFER, vertex_offset, sizeof(gl_quad), quad);
-
-    GLuint indices[] = {ebo_index, ebo_index + 1, ebo_index + 2,
-                        ebo_index, ebo_index + 2, ebo_index + 3};
-
-    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER,
-                    surface->gl_flat_count * sizeof(indices), sizeof(indices),
-                    indices);
+    surface->gl_flat_quads[surface->gl_flat_count] = *quad;
 #elif defined(RENDER_3DS_GL)
-    memcpy(surface->gl_flat_buffer.vbo + vertex_offset, quad, sizeof(gl_quad));
-
-    uint16_t indices[] = {ebo_index, ebo_index + 1, ebo_index + 2,
-                          ebo_index, ebo_index + 2, ebo_index + 3};
+    int vertex_offset = surface->gl_flat_count * sizeof(gl_quad);
 
-    memcpy(surface->gl_flat_buffer.ebo +
-               (surface->gl_flat_count * sizeof(indices)),
-           indices, sizeof(indices));
+    memcpy(surface->gl_flat_buffer.vbo + vertex_offset, quad, sizeof(gl_quad));
 #endif
 
     surface->gl_flat_count++;
@@ -566,9 +682,15 @@ void surface_gl_buffer_character(Surface *surface, char character, int x, int y,
 
     surface_gl_quad_new(surface, &quad, x, y, width, height);
 
+#ifdef RENDER_GL
+    gl_atlas_position atlas_position =
+        draw_shadow ? surface->gl_font_shadow_positions[font_id][char_set_index]
+                    : surface->gl_font_positions[font_id][char_set_index];
+#elif defined(RENDER_3DS_GL)
     gl_atlas_position atlas_position =
         draw_shadow ? gl_font_shadow_atlas_positions[font_id][char_set_index]
                     : gl_font_atlas_positions[font_id][char_set_index];
+#endif
 
     surface_gl_quad_apply_atlas(&quad, atlas_position, 0);
     surface_gl_quad_apply_base_atlas(&quad, gl_transparent_atlas_position, 0);
@@ -601,9 +723,7 @@ void surface_gl_buffer_sprite(Surface *surface, int sprite_id, int x, int y,
     gl_atlas_position atlas_position = gl_transparent_atlas_position;
     gl_atlas_position base_atlas_position = gl_transparent_atlas_position;
 
-    if (sprite_id == SPRITE_LIMIT - 1) {
-        atlas_position = gl_logo_atlas_position;
-    } else if (sprite_id == surface->mud->sprite_logo) {
+    if (sprite_id == surface->mud->sprite_logo) {
 #ifdef RENDER_GL
         gl_atlas_position test = {MINIMAP_SPRITE_WIDTH / 1024.0f,
                                   (MINIMAP_SPRITE_WIDTH + 512) / 1024.0f, 0.0f,
@@ -648,6 +768,31 @@ void surface_gl_buffer_sprite(Surface *surface, int sprite_id, int x, int y,
 #elif defined(RENDER_3DS_GL)
         atlas_position = gl_map_atlas_position;
 #endif
+    } else if (sprite_id == surface->mud->sprite_texture + 1) {
+#ifdef RENDER_GL
+        base_texture = surface->gl_dynamic_texture;
+
+        gl_atlas_position test = {0.0f, (float)SLEEP_WIDTH / 1024.0f, 0.0f,
+                                  (float)SLEEP_HEIGHT / 1024.0f};
+
+        base_atlas_position = test;
+#elif defined(RENDER_3DS_GL)
+        atlas_position = gl_sleep_atlas_position;
+#else
+        return;
+#endif
+#ifdef RENDER_GL
+    } else if (sprite_id >= 0 && sprite_id < surface->limit &&
+               surface->gl_sprites[sprite_id].page != -1) {
+        SurfaceGlSprite *gl_sprite = &surface->gl_sprites[sprite_id];
+
+        texture = surface->gl_atlas.pages[gl_sprite->page].texture;
+        base_texture = texture;
+        atlas_position = gl_sprite->atlas_position;
+        base_atlas_position = gl_sprite->base_atlas_position;
+#elif defined(RENDER_3DS_GL)
+    } else if (sprite_id == SPRITE_LIMIT - 1) {
+        atlas_position = gl_logo_atlas_position;
     } else if (sprite_id >= 0 && sprite_id < surface->mud->sprite_media) {
         gl_entity_texture texture_position =
             gl_entities_texture_positions[sprite_id];
@@ -655,11 +800,7 @@ void surface_gl_buffer_sprite(Surface *surface, int sprite_id, int x, int y,
         int texture_index = texture_position.texture_index;
 
         if (texture_index >= 0) {
-#ifdef RENDER_GL
-            texture = surface->gl_entity_textures[texture_index];
-#elif defined(RENDER_3DS_GL)
             texture = &surface->gl_entity_textures[texture_index];
-#endif
             atlas_position = texture_position.atlas_position;
         }
 
@@ -680,11 +821,7 @@ void surface_gl_buffer_sprite(Surface *surface, int sprite_id, int x, int y,
         int base_texture_index = base_texture_position.texture_index;
 
         if (base_texture_index >= 0) {
-#ifdef RENDER_GL
-            base_texture = surface->gl_entity_textures[base_texture_index];
-#elif defined(RENDER_3DS_GL)
             base_texture = &surface->gl_entity_textures[base_texture_index];
-#endif
             base_atlas_position = base_texture_position.atlas_position;
         }
     } else if (sprite_id >= surface->mud->sprite_media &&
@@ -694,18 +831,6 @@ void surface_gl_buffer_sprite(Surface *surface, int sprite_id, int x, int y,
 
         atlas_position = gl_media_atlas_positions[atlas_index];
         base_atlas_position = gl_media_base_atlas_positions[atlas_index];
-    } else if (sprite_id == surface->mud->sprite_texture + 1) {
-#ifdef RENDER_GL
-        base_texture = surface->gl_dynamic_texture;
-
-        gl_atlas_position test = {0.0f, (float)SLEEP_WIDTH / 1024.0f, 0.0f,
-                                  (float)SLEEP_HEIGHT / 1024.0f};
-
-        base_atlas_position = test;
-#elif defined(RENDER_3DS_GL)
-        atlas_position = gl_sleep_atlas_position;
-#else
-        return;
 #endif
     } else {
         return;
@@ -828,6 +953,11 @@ void surface_gl_buffer_sprite(Surface *surface, int sprite_id, int x, int y,
     surface_gl_vertex_apply_colour((gl_quad_vertex *)(&quad), 4, mask_colour,
                                    alpha);
 
+#ifdef RENDER_GL
+    surface_gl_vertex_apply_skin((gl_quad_vertex *)(&quad), 4,
+                                 skin_colour == 0 ? WHITE : skin_colour);
+#endif
+
     surface_gl_vertex_apply_depth((gl_quad_vertex *)(&quad), 2, depth_bottom);
     surface_gl_vertex_apply_depth((gl_quad_vertex *)(&quad) + 2, 2, depth_top);
 
@@ -845,7 +975,11 @@ void surface_gl_buffer_circle(Surface *surface, int x, int y, int radius,
 
     surface_gl_quad_new(surface, &quad, x, y, diameter, diameter);
 
+#ifdef RENDER_GL
+    surface_gl_quad_apply_atlas(&quad, surface->gl_circle_position, 0);
+#elif defined(RENDER_3DS_GL)
     surface_gl_quad_apply_atlas(&quad, gl_circle_atlas_position, 0);
+#endif
     surface_gl_quad_apply_base_atlas(&quad, gl_transparent_atlas_position, 0);
 
     surface_gl_vertex_apply_colour((gl_quad_vertex *)(&quad), 4, colour, alpha);
@@ -890,6 +1024,8 @@ void surface_gl_draw(Surface *surface, GL_DEPTH_MODE depth_mode) {
 
     shader_use(&surface->gl_flat_shader);
 
+    surface_gl_upload_quads(surface);
+
     vertex_buffer_gl_bind(&surface->gl_flat_buffer);
 
     int drawn_quads = 0;
@@ -1611,8 +1747,11 @@ void surface_apply_login_filter(Surface *surface, int background_height) {
 
 // TODO remove this
 void surface_clear(Surface *surface) {
+    surface_forget_tinted(surface, -1);
+
     for (int i = 0; i < surface->limit; i++) {
         free(surface->surface_pixels[i]);
+        surface_free_spans(surface, i);
 
         surface->surface_pixels[i] = NULL;
         surface->sprite_width[i] = 0;
@@ -1620,6 +1759,430 @@ void surface_clear(Surface *surface) {
     }
 }
 
+#ifdef RENDER_SW
+static int surface_tint_bucket(int sprite_id, int mask_colour,
+                               int skin_colour) {
+    uint32_t hash = (uint32_t)sprite_id * 0x9e3779b1;
+
+    hash ^= (uint32_t)mask_colour * 0x85ebca6b;
+    hash ^= (uint32_t)skin_colour * 0xc2b2ae35;
+
+    return (hash >> 16) & (SURFACE_TINT_BUCKETS - 1);
+}
+
+static void surface_tint_free(Surface *surface, int index) {
+    SurfaceTintedSprite *entry = &surface->tint_cache[index];
+
+    int *link = &surface->tint_buckets[surface_tint_bucket(
+        entry->sprite_id, entry->mask_colour, entry->skin_colour)];
+
+    while (*link != index) {
+        link = &surface->tint_cache[*link].next;
+    }
+
+    *link = entry->next;
+
+    free(entry->pixels);
+    entry->pixels = NULL;
+
+    surface->tint_cache_used -= entry->size;
+    surface->tint_count--;
+}
+
+/* find or make the recoloured copy of a sprite. NULL if it doesn't fit in the
+ * cache, and it has to be recoloured as it's drawn */
+static int32_t *surface_tint_sprite(Surface *surface, int sprite_id,
+                                    int mask_colour, int skin_colour) {
+    if (surface->tint_cache == NULL) {
+        return NULL;
+    }
+
+    int bucket = surface_tint_bucket(sprite_id, mask_colour, skin_colour);
+
+    for (int i = surface->tint_buckets[bucket]; i != -1;
+         i = surface->tint_cache[i].next) {
+        SurfaceTintedSprite *entry = &surface->tint_cache[i];
+
+        if (entry->sprite_id == sprite_id &&
+            entry->mask_colour == mask_colour &&
+            entry->skin_colour == skin_colour) {
+            entry->stamp = surface->tint_stamp;
+            return entry->pixels;
+        }
+    }
+
+    int area =
+        surface->sprite_width[sprite_id] * surface->sprite_height[sprite_id];
+
+    /* spans only need their opaque pixels tinted, and have no transparent
+     * ones to mark */
+    SurfaceSpans *spans = surface->sprite_spans[sprite_id];
+
+    if (spans != NULL) {
+        area = spans->pixel_count;
+    }
+
+    size_t size = area * sizeof(int32_t);
+
+    if (area <= 0 || size > surface->tint_cache_size) {
+        return NULL;
+    }
+
+    int32_t *pixels = malloc(size);
+
+    if (pixels == NULL) {
+        return NULL;
+    }
+
+    int mask_r = (mask_colour >> 16) & 0xff;
+    int mask_g = (mask_colour >> 8) & 0xff;
+    int mask_b = mask_colour & 0xff;
+    int skin_r = (skin_colour >> 16) & 0xff;
+    int skin_g = (skin_colour >> 8) & 0xff;
+    int skin_b = skin_colour & 0xff;
+
+    int32_t *src_pixels = surface->surface_pixels[sprite_id];
+    int8_t *src_colours = surface->sprite_colours[sprite_id];
+    int32_t *palette = surface->sprite_palette[sprite_id];
+    int32_t opaque = (int32_t)0xff000000;
+
+    if (spans != NULL) {
+        src_pixels = NULL;
+        src_colours = spans->colours;
+        opaque = 0;
+
+        if (spans->palette != NULL) {
+            palette = spans->palette;
+        }
+    }
+
+    for (int i = 0; i < area; i++) {
+        int colour = 0;
+
+        if (src_pixels != NULL) {
+            colour = src_pixels[i];
+        } else {
+            int index = src_colours[i] & 0xff;
+
+            if (index != 0) {
+                colour = palette[index];
+
+                if (colour == 0) {
+                    /* drawn, unlike a 0 in a 32-bit sprite */
+                    pixels[i] = opaque;
+                    continue;
+                }
+            }
+        }
+
+        if (colour == 0) {
+            pixels[i] = 0;
+            continue;
+        }
+
+        if ((colour & 0xff000000) != 0) {
+            /* copied from a screen with an alpha channel */
+            free(pixels);
+            return NULL;
+        }
+
+        int r = (colour >> 16) & 0xff;
+        int g = (colour >> 8) & 0xff;
+        int b = colour & 0xff;
+
+        if (r == g && g == b) {
+            colour = (((r * mask_r) >> 8) << 16) + (((g * mask_g) >> 8) << 8) +
+                     ((b * mask_b) >> 8);
+        } else if (skin_colour != WHITE && r == 255 && g == b) {
+            colour = (((r * skin_r) >> 8) << 16) + (((g * skin_g) >> 8) << 8) +
+                     ((b * skin_b) >> 8);
+        }
+
+        pixels[i] = colour | opaque;
+    }
+
+    while (surface->tint_count >= SURFACE_TINT_ENTRIES ||
+           surface->tint_cache_used + size > surface->tint_cache_size) {
+        int oldest = -1;
+
+        for (int i = 0; i < SURFACE_TINT_ENTRIES; i++) {
+            if (surface->tint_cache[i].pixels != NULL &&
+                (oldest == -1 || surface->tint_cache[i].stamp <
+                                     surface->tint_cache[oldest].stamp)) {
+                oldest = i;
+            }
+        }
+
+        surface_tint_free(surface, oldest);
+    }
+
+    int index = 0;
+
+    while (surface->tint_cache[index].pixels != NULL) {
+        index++;
+    }
+
+    SurfaceTintedSprite *entry = &surface->tint_cache[index];
+
+    entry->sprite_id = sprite_id;
+    entry->mask_colour = mask_colour;
+    entry->skin_colour = skin_colour;
+    entry->stamp = ++surface->tint_stamp;
+    entry->next = surface->tint_buckets[bucket];
+    entry->size = size;
+    entry->pixels = pixels;
+
+    surface->tint_buckets[bucket] = index;
+    surface->tint_cache_used += size;
+    surface->tint_count++;
+
+    return pixels;
+}
+#endif
+
+/* keep up to size_kb of entity sprites with their grey and skin masks applied,
+ * so each frame only has to scale them */
+void surface_set_tint_cache(Surface *surface, int size_kb) {
+#ifdef RENDER_SW
+    if (surface->tint_cache != NULL || size_kb <= 0) {
+        return;
+    }
+
+    surface->tint_cache =
+        calloc(SURFACE_TINT_ENTRIES, sizeof(SurfaceTintedSprite));
+
+    if (surface->tint_cache == NULL) {
+        mud_error("unable to allocate sprite tint cache\n");
+        return;
+    }
+
+    for (int i = 0; i < SURFACE_TINT_BUCKETS; i++) {
+        surface->tint_buckets[i] = -1;
+    }
+
+    surface->tint_cache_size = (size_t)size_kb * 1024;
+#else
+    (void)surface;
+    (void)size_kb;
+#endif
+}
+
+/* drop the recoloured copies of a sprite whose pixels are changing, or of
+ * every sprite if sprite_id is -1 */
+static void surface_forget_tinted(Surface *surface, int sprite_id) {
+#ifdef RENDER_SW
+    if (surface->tint_count == 0) {
+        return;
+    }
+
+    for (int i = 0; i < SURFACE_TINT_ENTRIES; i++) {
+        SurfaceTintedSprite *entry = &surface->tint_cache[i];
+
+        if (entry->pixels != NULL &&
+            (sprite_id == -1 || entry->sprite_id == sprite_id)) {
+            surface_tint_free(surface, i);
+        }
+    }
+#else
+    (void)surface;
+    (void)sprite_id;
+#endif
+}
+
+/* build spans for sprites as they're parsed and loaded from now on. the
+ * software draws step over the transparent pixels instead of testing each */
+void surface_set_rle_sprites(Surface *surface, int enabled) {
+#ifdef RENDER_SW
+    surface->rle_sprites = enabled;
+#else
+    (void)surface;
+    (void)enabled;
+#endif
+}
+
+void surface_free_spans(Surface *surface, int sprite_id) {
+#ifdef RENDER_SW
+    free(surface->sprite_spans[sprite_id]);
+    surface->sprite_spans[sprite_id] = NULL;
+#else
+    (void)surface;
+    (void)sprite_id;
+#endif
+}
+
+int surface_sprite_loaded(Surface *surface, int sprite_id) {
+#ifdef RENDER_SW
+    if (surface->sprite_spans[sprite_id] != NULL) {
+        return 1;
+    }
+#endif
+
+    return surface->surface_pixels[sprite_id] != NULL ||
+           surface->sprite_colours[sprite_id] != NULL;
+}
+
+#ifdef RENDER_SW
+/* replace the palette indices of a sprite with the runs of its opaque ones.
+ * loaded sprites get their own copy of the palette with the colours that
+ * surface_palette_sprite_to_raster would give, and magenta is left out */
+static void surface_pack_spans(Surface *surface, int sprite_id, int loaded) {
+    int width = surface->sprite_width[sprite_id];
+    int height = surface->sprite_height[sprite_id];
+    int8_t *colours = surface->sprite_colours[sprite_id];
+    int32_t *palette = surface->sprite_palette[sprite_id];
+
+    if (width <= 0 || height <= 0 || colours == NULL) {
+        return;
+    }
+
+    int span_count = 0;
+    int pixel_count = 0;
+    int palette_length = 0;
+
+    for (int y = 0; y < height; y++) {
+        int was_opaque = 0;
+
+        for (int x = 0; x < width; x++) {
+            int index = colours[x + y * width] & 0xff;
+
+            int opaque = loaded ? palette[index] != MAGENTA : index != 0;
+
+            if (opaque) {
+                span_count += !was_opaque;
+                pixel_count++;
+
+                if (index >= palette_length) {
+                    palette_length = index + 1;
+                }
+            }
+
+            was_opaque = opaque;
+        }
+    }
+
+    if (!loaded) {
+        palette_length = 0;
+    }
+
+    size_t size = sizeof(SurfaceSpans) + (height + 1) * sizeof(int32_t) +
+                  span_count * sizeof(SurfaceSpan) +
+                  palette_length * sizeof(int32_t) + pixel_count;
+
+    SurfaceSpans *spans = malloc(size);
+
+    if (spans == NULL) {
+        mud_error("unable to allocate sprite spans\n");
+        return;
+    }
+
+    spans->height = height;
+    spans->rows = (int32_t *)(spans + 1);
+    spans->spans = (SurfaceSpan *)(spans->rows + height + 1);
+    spans->palette = NULL;
+    spans->colours = (int8_t *)(spans->spans + span_count);
+    spans->pixel_count = pixel_count;
+
+    if (loaded) {
+        spans->palette = (int32_t *)(spans->spans + span_count);
+        spans->colours = (int8_t *)(spans->palette + palette_length);
+
+        for (int i = 0; i < palette_length; i++) {
+            spans->palette[i] = palette[i] == 0 ? 1 : palette[i];
+        }
+    }
+
+    int span_index = 0;
+    int pixel_index = 0;
+
+    for (int y = 0; y < height; y++) {
+        int8_t *row = colours + y * width;
+
+        spans->rows[y] = span_index;
+
+        for (int x = 0; x < width;) {
+            int index = row[x] & 0xff;
+
+            if (loaded ? palette[index] == MAGENTA : index == 0) {
+                x++;
+                continue;
+            }
+
+            SurfaceSpan *span = &spans->spans[span_index++];
+
+            span->x = x;
+            span->offset = pixel_index;
+
+            for (; x < width; x++) {
+                index = row[x] & 0xff;
+
+                if (loaded ? palette[index] == MAGENTA : index == 0) {
+                    break;
+                }
+
+                spans->colours[pixel_index++] = row[x];
+            }
+
+            span->length = x - span->x;
+        }
+    }
+
+    spans->rows[height] = span_index;
+
+    free(surface->sprite_spans[sprite_id]);
+    surface->sprite_spans[sprite_id] = spans;
+
+    free(surface->sprite_colours[sprite_id]);
+    surface->sprite_colours[sprite_id] = NULL;
+}
+#endif
+
+/* put back the palette indices of a sprite, or the pixels of a loaded one,
+ * for code that reads them */
+static void surface_unpack_spans(Surface *surface, int sprite_id) {
+#ifdef RENDER_SW
+    SurfaceSpans *spans = surface->sprite_spans[sprite_id];
+
+    if (spans == NULL) {
+        return;
+    }
+
+    int width = surface->sprite_width[sprite_id];
+    int area = width * surface->sprite_height[sprite_id];
+
+    if (spans->palette != NULL) {
+        surface->surface_pixels[sprite_id] = calloc(area, sizeof(int32_t));
+        assert(surface->surface_pixels[sprite_id] != NULL);
+    } else {
+        surface->sprite_colours[sprite_id] = calloc(area, sizeof(int8_t));
+        assert(surface->sprite_colours[sprite_id] != NULL);
+    }
+
+    for (int y = 0; y < spans->height; y++) {
+        for (int i = spans->rows[y]; i < spans->rows[y + 1]; i++) {
+            SurfaceSpan *span = &spans->spans[i];
+            int8_t *colours = spans->colours + span->offset;
+            int dest = span->x + y * width;
+
+            if (spans->palette == NULL) {
+                memcpy(surface->sprite_colours[sprite_id] + dest, colours,
+                       span->length);
+                continue;
+            }
+
+            for (int x = 0; x < span->length; x++) {
+                surface->surface_pixels[sprite_id][dest + x] =
+                    spans->palette[colours[x] & 0xff];
+            }
+        }
+    }
+
+    surface_free_spans(surface, sprite_id);
+#else
+    (void)surface;
+    (void)sprite_id;
+#endif
+}
+
 void surface_parse_sprite_tga(Surface *surface, int sprite_id, int8_t *buffer,
                               size_t len, int columns, int rows) {
     size_t offset = 0;
@@ -1723,6 +2286,8 @@ void surface_parse_sprite_tga(Surface *surface, int sprite_id, int8_t *buffer,
     if (rows <= 1 && columns <= 1) {
         free(surface->surface_pixels[sprite_id]);
         surface->surface_pixels[sprite_id] = NULL;
+        surface_forget_tinted(surface, sprite_id);
+        surface_free_spans(surface, sprite_id);
         surface->sprite_colours[sprite_id] = (int8_t *)pixels;
         surface->sprite_translate[sprite_id] = 1;
         surface->sprite_translate_x[sprite_id] = 0;
@@ -1757,6 +2322,8 @@ void surface_parse_sprite_tga(Surface *surface, int sprite_id, int8_t *buffer,
 
                 free(surface->surface_pixels[sprite_id]);
                 surface->surface_pixels[sprite_id] = NULL;
+                surface_forget_tinted(surface, sprite_id);
+                surface_free_spans(surface, sprite_id);
                 surface->sprite_colours[sprite_id] = frame_pixels;
                 surface->sprite_translate[sprite_id] = 1;
                 surface->sprite_translate_x[sprite_id] = 0;
@@ -1797,13 +2364,13 @@ void surface_parse_sprite(Surface *surface, int sprite_id, int8_t *sprite_data,
 
     int colour_count = index_data[index_offset++] & 0xff;
 
-#ifdef RENDER_SW
+#if defined(RENDER_SW) || defined(RENDER_GL)
     int32_t colours[256];
     colours[0] = MAGENTA;
 #endif
 
     for (int i = 0; i < colour_count - 1; i++) {
-#ifdef RENDER_SW
+#if defined(RENDER_SW) || defined(RENDER_GL)
         int colour = ((index_data[index_offset] & 0xff) << 16) +
                      ((index_data[index_offset + 1] & 0xff) << 8) +
                      (index_data[index_offset + 2] & 0xff);
@@ -1815,7 +2382,7 @@ void surface_parse_sprite(Surface *surface, int sprite_id, int8_t *sprite_data,
         index_offset += 3;
     }
 
-#ifdef RENDER_SW
+#if defined(RENDER_SW) || defined(RENDER_GL)
     int sprite_offset = 2;
 #endif
 
@@ -1832,7 +2399,7 @@ void surface_parse_sprite(Surface *surface, int sprite_id, int8_t *sprite_data,
 
         index_offset += 2;
 
-#ifdef RENDER_SW
+#if defined(RENDER_SW) || defined(RENDER_GL)
         int type = index_data[index_offset++] & 0xff;
         int area = surface->sprite_width[i] * surface->sprite_height[i];
 
@@ -1846,6 +2413,8 @@ void surface_parse_sprite(Surface *surface, int sprite_id, int8_t *sprite_data,
 
         free(surface->surface_pixels[i]);
         surface->surface_pixels[i] = NULL;
+        surface_forget_tinted(surface, i);
+        surface_free_spans(surface, i);
 
         surface->sprite_translate[i] = 0;
 
@@ -1854,7 +2423,7 @@ void surface_parse_sprite(Surface *surface, int sprite_id, int8_t *sprite_data,
             surface->sprite_translate[i] = 1;
         }
 
-#ifdef RENDER_SW
+#if defined(RENDER_SW) || defined(RENDER_GL)
         if (type == 0) {
             for (int j = 0; j < area; j++) {
                 surface->sprite_colours[i][j] = sprite_data[sprite_offset++];
@@ -1883,12 +2452,18 @@ void surface_parse_sprite(Surface *surface, int sprite_id, int8_t *sprite_data,
         palette_to_locolour((uint8_t *)surface->sprite_colours[i], area,
                             (uint32_t *)colours);
         surface->sprite_palette[i] = (int32_t *)ibm_vga_palette;
-#elif defined(RENDER_SW)
+#elif defined(RENDER_SW) || defined(RENDER_GL)
         surface->sprite_palette[i] = calloc(colour_count, sizeof(int32_t));
         assert(surface->sprite_palette[i] != NULL);
         memcpy(surface->sprite_palette[i], colours,
                colour_count * sizeof(int32_t));
 #endif
+
+#ifdef RENDER_SW
+        if (surface->rle_sprites) {
+            surface_pack_spans(surface, i, 0);
+        }
+#endif
     }
 
     free(sprite_data);
@@ -1896,6 +2471,9 @@ void surface_parse_sprite(Surface *surface, int sprite_id, int8_t *sprite_data,
 
 void surface_read_sleep_word(Surface *surface, int sprite_id,
                              int8_t *sprite_data) {
+    surface_forget_tinted(surface, sprite_id);
+    surface_free_spans(surface, sprite_id);
+
     if (surface->surface_pixels[sprite_id] == NULL) {
         surface->surface_pixels[sprite_id] =
             malloc(SLEEP_WIDTH * SLEEP_HEIGHT * sizeof(int32_t));
@@ -1999,6 +2577,9 @@ void surface_read_sleep_word(Surface *surface, int sprite_id,
 }
 
 void surface_screen_raster_to_palette_sprite(Surface *surface, int sprite_id) {
+    surface_forget_tinted(surface, sprite_id);
+    surface_unpack_spans(surface, sprite_id);
+
     int sprite_size =
         surface->sprite_width[sprite_id] * surface->sprite_height[sprite_id];
 #ifndef USE_LOCOLOUR
@@ -2130,7 +2711,15 @@ int32_t *surface_palette_sprite_to_raster(Surface *surface, int sprite_id,
 }
 
 void surface_load_sprite(Surface *surface, int sprite_id) {
+    surface_forget_tinted(surface, sprite_id);
+    surface_unpack_spans(surface, sprite_id);
+
 #ifdef RENDER_SW
+    if (surface->rle_sprites && surface->sprite_colours[sprite_id] != NULL) {
+        surface_pack_spans(surface, sprite_id, 1);
+        return;
+    }
+
     surface->surface_pixels[sprite_id] =
         surface_palette_sprite_to_raster(surface, sprite_id, 0);
 #endif
@@ -2141,6 +2730,9 @@ void surface_load_sprite(Surface *surface, int sprite_id) {
 
 void surface_screen_raster_to_sprite(Surface *surface, int sprite_id, int x,
                                      int y, int width, int height) {
+    surface_forget_tinted(surface, sprite_id);
+    surface_free_spans(surface, sprite_id);
+
     surface->sprite_width[sprite_id] = width;
     surface->sprite_height[sprite_id] = height;
     surface->sprite_translate[sprite_id] = 0;
@@ -2241,6 +2833,9 @@ void surface_screen_raster_to_sprite(Surface *surface, int sprite_id, int x,
 // TODO not draw - load from raster reversed
 void surface_draw_sprite_reversed(Surface *surface, int sprite_id, int x, int y,
                                   int width, int height) {
+    surface_forget_tinted(surface, sprite_id);
+    surface_free_spans(surface, sprite_id);
+
     surface->sprite_width[sprite_id] = width;
     surface->sprite_height[sprite_id] = height;
     surface->sprite_translate[sprite_id] = 0;
@@ -2335,7 +2930,17 @@ void surface_draw_sprite(Surface *surface, int x, int y, int sprite_id) {
         }
     }
 
-    if (surface->surface_pixels[sprite_id] == NULL) {
+    if (surface->sprite_spans[sprite_id] != NULL) {
+        int sprite_width = surface->sprite_width[sprite_id];
+        SurfaceSpansPlot plot;
+
+        surface_spans_plot_new(surface, &plot, sprite_id, SURFACE_SPANS_COPY);
+
+        surface_plot_spans_scale(surface, &plot, (src_pos % sprite_width) << 16,
+                                 (src_pos / sprite_width) << 16, dest_pos,
+                                 dest_offset, width, height, 1 << 16,
+                                 y_inc << 16, y_inc);
+    } else if (surface->surface_pixels[sprite_id] == NULL) {
         surface_plot_sprite8(
             surface->pixels, surface->sprite_colours[sprite_id],
             surface->sprite_palette[sprite_id], src_pos, dest_pos, width,
@@ -2445,9 +3050,18 @@ void surface_draw_sprite_scale(Surface *surface, int x, int y, int width,
         }
     }
 
-    surface_plot_sprite32_scale(
-        surface->pixels, surface->surface_pixels[sprite_id], l1, i2, dest_pos,
-        k3, width, height, j2, k2, sprite_width, y_inc);
+    if (surface->sprite_spans[sprite_id] != NULL) {
+        SurfaceSpansPlot plot;
+
+        surface_spans_plot_new(surface, &plot, sprite_id, SURFACE_SPANS_COPY);
+
+        surface_plot_spans_scale(surface, &plot, l1, i2, dest_pos, k3, width,
+                                 height, j2, k2, y_inc);
+    } else {
+        surface_plot_sprite32_scale(
+            surface->pixels, surface->surface_pixels[sprite_id], l1, i2,
+            dest_pos, k3, width, height, j2, k2, sprite_width, y_inc);
+    }
 
     (void)depth;
 #elif defined(RENDER_GL) || defined(RENDER_3DS_GL)
@@ -2551,7 +3165,18 @@ void surface_draw_sprite_alpha(Surface *surface, int x, int y, int sprite_id,
         }
     }
 
-    if (surface->surface_pixels[sprite_id] == NULL) {
+    if (surface->sprite_spans[sprite_id] != NULL) {
+        int sprite_width = surface->sprite_width[sprite_id];
+        SurfaceSpansPlot plot;
+
+        surface_spans_plot_new(surface, &plot, sprite_id, SURFACE_SPANS_ALPHA);
+        plot.alpha = alpha;
+
+        surface_plot_spans_scale(surface, &plot, (src_pos % sprite_width) << 16,
+                                 (src_pos / sprite_width) << 16, size,
+                                 dest_offset, width, height, 1 << 16,
+                                 y_inc << 16, y_inc);
+    } else if (surface->surface_pixels[sprite_id] == NULL) {
         surface_plot_sprite8_alpha(
             surface->pixels, surface->sprite_colours[sprite_id],
             surface->sprite_palette[sprite_id], src_pos, size, width, height,
@@ -2661,9 +3286,19 @@ void surface_draw_sprite_scale_alpha(Surface *surface, int x, int y,
         }
     }
 
-    surface_plot_sprite32_alpha_scale(
-        surface->pixels, surface->surface_pixels[sprite_id], i2, j2, j3, l3,
-        scale_x, scale_y, k2, l2, sprite_width, y_inc, alpha);
+    if (surface->sprite_spans[sprite_id] != NULL) {
+        SurfaceSpansPlot plot;
+
+        surface_spans_plot_new(surface, &plot, sprite_id, SURFACE_SPANS_ALPHA);
+        plot.alpha = alpha;
+
+        surface_plot_spans_scale(surface, &plot, i2, j2, j3, l3, scale_x,
+                                 scale_y, k2, l2, y_inc);
+    } else {
+        surface_plot_sprite32_alpha_scale(
+            surface->pixels, surface->surface_pixels[sprite_id], i2, j2, j3,
+            l3, scale_x, scale_y, k2, l2, sprite_width, y_inc, alpha);
+    }
 #elif defined(RENDER_GL) || defined(RENDER_3DS_GL)
     surface_gl_buffer_sprite(surface, sprite_id, x, y, scale_x, scale_y, 0, 0,
                              0, alpha, 0, 0, 0, 0);
@@ -2763,15 +3398,195 @@ void surface_draw_sprite_scale_mask(Surface *surface, int x, int y, int width,
         }
     }
 
-    surface_plot_sprite32_scale_mask(
-        surface->pixels, surface->surface_pixels[sprite_id], i2, j2, j3, l3,
-        width, height, k2, l2, sprite_width, y_inc, colour);
+    if (surface->sprite_spans[sprite_id] != NULL) {
+        SurfaceSpansPlot plot;
+
+        surface_spans_plot_new(surface, &plot, sprite_id, SURFACE_SPANS_MASK);
+        plot.mask_colour = colour;
+
+        surface_plot_spans_scale(surface, &plot, i2, j2, j3, l3, width, height,
+                                 k2, l2, y_inc);
+    } else {
+        surface_plot_sprite32_scale_mask(
+            surface->pixels, surface->surface_pixels[sprite_id], i2, j2, j3,
+            l3, width, height, k2, l2, sprite_width, y_inc, colour);
+    }
 #elif defined(RENDER_GL) || defined(RENDER_3DS_GL)
     surface_gl_buffer_sprite(surface, sprite_id, x, y, width, height, 0, colour,
                              0, 255, 0, 0, 0, 0);
 #endif
 }
 
+#ifdef RENDER_SW
+static void surface_spans_plot_new(Surface *surface, SurfaceSpansPlot *plot,
+                                   int sprite_id, SurfaceSpansMode mode) {
+    SurfaceSpans *spans = surface->sprite_spans[sprite_id];
+
+    memset(plot, 0, sizeof(SurfaceSpansPlot));
+
+    plot->spans = spans;
+    plot->colours = spans->colours;
+    plot->palette = spans->palette != NULL ? spans->palette
+                                           : surface->sprite_palette[sprite_id];
+    plot->mode = mode;
+    plot->mask_colour = WHITE;
+    plot->skin_colour = WHITE;
+}
+
+/* rounds towards negative infinity, for a positive divisor */
+static int surface_floor_div(int dividend, int divisor) {
+    if (dividend >= 0) {
+        return dividend / divisor;
+    }
+
+    return -((divisor - 1 - dividend) / divisor);
+}
+
+static inline int surface_spans_colour(SurfaceSpansPlot *plot, int index) {
+    if (plot->pixels != NULL) {
+        return plot->pixels[index];
+    }
+
+    return plot->palette[plot->colours[index] & 0xff];
+}
+
+/* multiplies grey pixels by the mask colour, and with the skin colour, the
+ * ones with full red and equal green and blue */
+static inline int surface_spans_mask(SurfaceSpansPlot *plot, int colour) {
+    int r = (colour >> 16) & 0xff;
+    int g = (colour >> 8) & 0xff;
+    int b = colour & 0xff;
+    int mask_colour = 0;
+
+    if (r == g && g == b) {
+        mask_colour = plot->mask_colour;
+    } else if (plot->mode == SURFACE_SPANS_SKIN_MASK && r == 255 && g == b) {
+        mask_colour = plot->skin_colour;
+    } else {
+        return colour;
+    }
+
+    return (((r * ((mask_colour >> 16) & 0xff)) >> 8) << 16) +
+           (((g * ((mask_colour >> 8) & 0xff)) >> 8) << 8) +
+           ((b * (mask_colour & 0xff)) >> 8);
+}
+
+/* draws the spans of sprite row src_y that land on dest[0] up to
+ * dest[width - 1], where dest[i] is from column (src_x + i * step) >> 16.
+ * step is negative for flipped sprites */
+static void surface_plot_spans_row(SurfaceSpansPlot *plot,
+                                   int32_t *restrict dest, int src_y,
+                                   int src_x, int step, int width) {
+    SurfaceSpans *spans = plot->spans;
+
+    if (src_y < 0 || src_y >= spans->height || width <= 0 || step == 0) {
+        return;
+    }
+
+    for (int i = spans->rows[src_y]; i < spans->rows[src_y + 1]; i++) {
+        SurfaceSpan *span = &spans->spans[i];
+        int left = span->x << 16;
+        int right = (span->x + span->length) << 16;
+        int start = 0;
+        int end = 0;
+
+        if (step > 0) {
+            start = -surface_floor_div(src_x - left, step);
+            end = -surface_floor_div(src_x - right, step);
+        } else {
+            start = surface_floor_div(src_x - right, -step) + 1;
+            end = surface_floor_div(src_x - left, -step) + 1;
+        }
+
+        if (start < 0) {
+            start = 0;
+        }
+
+        if (end > width) {
+            end = width;
+        }
+
+        int j = src_x + start * step;
+        int offset = span->offset - span->x;
+
+        switch (plot->mode) {
+        case SURFACE_SPANS_COPY:
+            for (int x = start; x < end; x++) {
+                dest[x] = surface_spans_colour(plot, offset + (j >> 16));
+                j += step;
+            }
+            break;
+        case SURFACE_SPANS_ALPHA:
+            for (int x = start; x < end; x++) {
+                int colour = surface_spans_colour(plot, offset + (j >> 16));
+
+                dest[x] = surface_blend_alpha(dest[x], colour, plot->alpha);
+                j += step;
+            }
+            break;
+        case SURFACE_SPANS_MASK:
+        case SURFACE_SPANS_SKIN_MASK:
+            for (int x = start; x < end; x++) {
+                int colour = surface_spans_colour(plot, offset + (j >> 16));
+
+                dest[x] = surface_spans_mask(plot, colour);
+                j += step;
+            }
+            break;
+        }
+    }
+}
+
+/* the same rows as surface_plot_sprite32_scale */
+static void surface_plot_spans_scale(Surface *surface, SurfaceSpansPlot *plot,
+                                     int j, int k, int dest_pos,
+                                     int dest_offset, int width, int height,
+                                     int l1, int i2, int y_inc) {
+    for (int y = -height; y < 0; y += y_inc) {
+        surface_plot_spans_row(plot, surface->pixels + dest_pos, k >> 16, j,
+                               l1, width);
+
+        k += i2;
+        dest_pos += width + dest_offset;
+    }
+}
+
+/* the same rows as surface_plot_sprite32_transform */
+static void surface_plot_spans_transform(Surface *surface,
+                                         SurfaceSpansPlot *plot, int j, int k,
+                                         int dest_pos, int width, int height,
+                                         int k1, int l1, int k2, int l2,
+                                         int y_inc) {
+    for (int y = -height; y < 0; y++) {
+        int x_offset = k2 >> 16;
+        int final_width = width;
+        int src_x = j;
+
+        if (x_offset < surface->bounds_min_x) {
+            int clip_x = surface->bounds_min_x - x_offset;
+            final_width -= clip_x;
+            x_offset = surface->bounds_min_x;
+            src_x += k1 * clip_x;
+        }
+
+        if (x_offset + final_width >= surface->bounds_max_x) {
+            final_width -= x_offset + final_width - surface->bounds_max_x;
+        }
+
+        y_inc = 1 - y_inc;
+
+        if (y_inc != 0) {
+            surface_plot_spans_row(plot, surface->pixels + dest_pos + x_offset,
+                                   k >> 16, src_x, k1, final_width);
+        }
+
+        k += l1;
+        dest_pos += surface->width;
+        k2 += l2;
+    }
+}
+#endif /* RENDER_SW */
+
 #ifdef RENDER_SW
 static void surface_plot_sprite32(int32_t *dest, int32_t *src, int src_pos,
                                   int dest_pos, int width, int height,
@@ -3267,6 +4082,10 @@ void surface_draw_minimap_sprite(Surface *surface, int x, int y, int sprite_id,
     }
 
     int l10 = k6 * j1;
+
+    /* rotated sprites are drawn from their flat pixels */
+    surface_unpack_spans(surface, sprite_id);
+
     int32_t *ai = surface->surface_pixels[sprite_id];
 
     for (int i = k6; i < l6; i++) {
@@ -3436,6 +4255,60 @@ static void surface_draw_sprite_transform_mask_software(
         y_inc = 2;
     }
 
+    if (draw_width <= 0 || draw_height <= 0) {
+        return;
+    }
+
+    int32_t *tinted =
+        surface_tint_sprite(surface, sprite_id, mask_colour, skin_colour);
+
+    if (surface->sprite_spans[sprite_id] != NULL) {
+        SurfaceSpansPlot plot;
+
+        surface_spans_plot_new(surface, &plot, sprite_id,
+                               skin_colour == WHITE ? SURFACE_SPANS_MASK
+                                                    : SURFACE_SPANS_SKIN_MASK);
+
+        plot.mask_colour = mask_colour;
+        plot.skin_colour = skin_colour;
+
+        if (tinted != NULL) {
+            plot.mode = SURFACE_SPANS_COPY;
+            plot.pixels = tinted;
+        }
+
+        if (!flip) {
+            surface_plot_spans_transform(surface, &plot, offset_x, offset_y,
+                                         j4, draw_width, draw_height,
+                                         width_ratio, height_ratio, i3, l3,
+                                         y_inc);
+        } else {
+            surface_plot_spans_transform(
+                surface, &plot, (sprite_width << 16) - offset_x - 1, offset_y,
+                j4, draw_width, draw_height, -width_ratio, height_ratio, i3, l3,
+                y_inc);
+        }
+
+        return;
+    }
+
+    if (tinted != NULL) {
+        if (!flip) {
+            surface_plot_sprite32_transform_tinted(
+                surface, surface->pixels, tinted, offset_x, offset_y, j4,
+                draw_width, draw_height, width_ratio, height_ratio,
+                sprite_width, i3, l3, y_inc);
+        } else {
+            surface_plot_sprite32_transform_tinted(
+                surface, surface->pixels, tinted,
+                (surface->sprite_width[sprite_id] << 16) - offset_x - 1,
+                offset_y, j4, draw_width, draw_height, -width_ratio,
+                height_ratio, sprite_width, i3, l3, y_inc);
+        }
+
+        return;
+    }
+
     if (skin_colour == WHITE) {
         if (surface->surface_pixels[sprite_id] != NULL) {
             if (!flip) {
@@ -3670,6 +4543,50 @@ static void surface_plot_sprite32_transform_dual_mask(
     }
 }
 
+static void surface_plot_sprite32_transform_tinted(
+    Surface *surface, int32_t *restrict dest, int32_t *restrict src, int j,
+    int k, int dest_pos, int width, int height, int k1, int l1, int i2, int k2,
+    int l2, int y_inc) {
+    int l4 = j;
+
+    for (int y = -height; y < 0; y++) {
+        int j5 = (k >> 16) * i2;
+        int x_offset = k2 >> 16;
+        int final_width = width;
+
+        if (x_offset < surface->bounds_min_x) {
+            int i6 = surface->bounds_min_x - x_offset;
+            final_width -= i6;
+            x_offset = surface->bounds_min_x;
+            j += k1 * i6;
+        }
+
+        if (x_offset + final_width >= surface->bounds_max_x) {
+            int j6 = x_offset + final_width - surface->bounds_max_x;
+            final_width -= j6;
+        }
+
+        y_inc = 1 - y_inc;
+
+        if (y_inc != 0) {
+            for (int x = x_offset; x < x_offset + final_width; x++) {
+                int colour = src[(j >> 16) + j5];
+
+                if (colour != 0) {
+                    dest[x + dest_pos] = colour & 0xffffff;
+                }
+
+                j += k1;
+            }
+        }
+
+        k += l1;
+        j = l4;
+        dest_pos += surface->width;
+        k2 += l2;
+    }
+}
+
 static void surface_plot_sprite8_transform(
     Surface *surface, int32_t *restrict dest, int8_t *restrict colour_idx,
     int32_t *restrict colours, int j, int k, int l, int i1, int height, int k1,
@@ -4413,6 +5330,287 @@ void surface_gl_update_dynamic_texture(Surface *surface) {
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 1024, 1024, 0, GL_RGB,
                  GL_UNSIGNED_BYTE, surface->gl_dynamic_texture_buffer);
 }
+
+static gl_atlas_position surface_gl_atlas_add(Surface *surface,
+                                              uint8_t *pixels, int width,
+                                              int height, int *page) {
+    int x = 0;
+    int y = 0;
+
+    if (!atlas_gl_add(&surface->gl_atlas, pixels, width, height, page, &x,
+                      &y)) {
+        mud_error("unable to fit %dx%d sprite in the texture atlas\n", width,
+                  height);
+
+        *page = -1;
+        return gl_transparent_atlas_position;
+    }
+
+    gl_atlas_position atlas_position = {
+        .left_u = x / GL_TEXTURE_SIZE,
+        .right_u = (x + width) / GL_TEXTURE_SIZE,
+        .top_v = y / GL_TEXTURE_SIZE,
+        .bottom_v = (y + height) / GL_TEXTURE_SIZE};
+
+    return atlas_position;
+}
+
+static void surface_gl_pack_circle(Surface *surface) {
+    int size = 128;
+    float radius = size / 2.0f;
+    uint8_t *pixels = calloc(size * size * 4, sizeof(uint8_t));
+
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            float distance_x = x + 0.5f - radius;
+            float distance_y = y + 0.5f - radius;
+
+            if (distance_x * distance_x + distance_y * distance_y <=
+                radius * radius) {
+                memset(pixels + ((y * size + x) * 4), 255, 4);
+            }
+        }
+    }
+
+    int page = 0;
+
+    surface->gl_circle_position =
+        surface_gl_atlas_add(surface, pixels, size, size, &page);
+
+    free(pixels);
+}
+
+/* the glyphs of every loaded font, along with a copy of each with its shadow
+ * drawn one pixel to the right and below */
+void surface_gl_pack_fonts(Surface *surface) {
+    /* big enough for the largest glyph and its shadow */
+    uint8_t *pixels = calloc((128 + 1) * (128 + 1) * 4, sizeof(uint8_t));
+
+    for (int i = 0; i <= FONT_BOLD_24; i++) {
+        int8_t *font_data = game_fonts[i];
+
+        if (font_data == NULL) {
+            continue;
+        }
+
+        for (int j = 0; j < CHAR_SET_LENGTH; j++) {
+            int character_offset = character_width[(unsigned)CHAR_SET[j]];
+            int width = font_data[character_offset + 3];
+            int height = font_data[character_offset + 4];
+
+            int font_pos = font_data[character_offset] * (128 * 128) +
+                           font_data[character_offset + 1] * 128 +
+                           font_data[character_offset + 2];
+
+            surface->gl_font_positions[i][j] = gl_transparent_atlas_position;
+
+            surface->gl_font_shadow_positions[i][j] =
+                gl_transparent_atlas_position;
+
+            if (width <= 0 || height <= 0) {
+                continue;
+            }
+
+            for (int shadow = 0; shadow < 2; shadow++) {
+                int glyph_width = width + shadow;
+                int glyph_height = height + shadow;
+
+                memset(pixels, 0, glyph_width * glyph_height * 4);
+
+                for (int y = 0; y < height; y++) {
+                    for (int x = 0; x < width; x++) {
+                        if (font_data[font_pos + (y * width) + x] == 0) {
+                            continue;
+                        }
+
+                        if (shadow) {
+                            uint8_t *right =
+                                pixels + ((y * glyph_width + x + 1) * 4);
+
+                            uint8_t *below =
+                                pixels + (((y + 1) * glyph_width + x) * 4);
+
+                            /* black, the glyph pixels after these are
+                             * drawn over them */
+                            right[3] = 255;
+                            below[3] = 255;
+                        }
+
+                        memset(pixels + ((y * glyph_width + x) * 4), 255, 4);
+                    }
+                }
+
+                int page = 0;
+
+                gl_atlas_position atlas_position = surface_gl_atlas_add(
+                    surface, pixels, glyph_width, glyph_height, &page);
+
+                if (shadow) {
+                    surface->gl_font_shadow_positions[i][j] = atlas_position;
+                } else {
+                    surface->gl_font_positions[i][j] = atlas_position;
+                }
+            }
+        }
+    }
+
+    free(pixels);
+
+    atlas_gl_upload(&surface->gl_atlas);
+}
+
+/* splits a sprite into the greyscale pixels that get multiplied by the mask
+ * colour and the rest, which are drawn as they are. skin pixels of entity
+ * sprites are kept half transparent in the base for the shader to tint */
+static void surface_gl_pack_sprite(Surface *surface, int sprite_id,
+                                   int has_skin) {
+    int width = surface->sprite_width[sprite_id];
+    int height = surface->sprite_height[sprite_id];
+
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+
+    /* greyscale on the left, base on the right */
+    int row_width = width * 2;
+    uint8_t *pixels = calloc(row_width * height * 4, sizeof(uint8_t));
+    int has_grey = 0;
+    int has_base = 0;
+
+    int8_t *colours = surface->sprite_colours[sprite_id];
+    int32_t *palette = surface->sprite_palette[sprite_id];
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int index = colours[y * width + x] & 0xff;
+
+            if (index == 0) {
+                continue;
+            }
+
+            int colour = palette[index];
+            int r = (colour >> 16) & 0xff;
+            int g = (colour >> 8) & 0xff;
+            int b = colour & 0xff;
+            int alpha = 255;
+            uint8_t *pixel = pixels + ((y * row_width + x) * 4);
+
+            if (colour != 0 && r == g && g == b) {
+                has_grey = 1;
+            } else {
+                if (has_skin && r == 255 && g == b) {
+                    alpha = 128;
+                }
+
+                pixel += width * 4;
+                has_base = 1;
+            }
+
+            pixel[0] = r;
+            pixel[1] = g;
+            pixel[2] = b;
+            pixel[3] = alpha;
+        }
+    }
+
+    SurfaceGlSprite *gl_sprite = &surface->gl_sprites[sprite_id];
+    int page = 0;
+
+    gl_sprite->atlas_position = gl_transparent_atlas_position;
+    gl_sprite->base_atlas_position = gl_transparent_atlas_position;
+
+    if (has_grey && has_base) {
+        gl_atlas_position atlas_position =
+            surface_gl_atlas_add(surface, pixels, row_width, height, &page);
+
+        float middle_u = (atlas_position.left_u + atlas_position.right_u) / 2;
+
+        gl_sprite->atlas_position = atlas_position;
+        gl_sprite->atlas_position.right_u = middle_u;
+        gl_sprite->base_atlas_position = atlas_position;
+        gl_sprite->base_atlas_position.left_u = middle_u;
+    } else if (has_grey || has_base) {
+        /* pack just the half that has anything in it */
+        for (int y = 0; y < height; y++) {
+            memmove(pixels + (y * width * 4),
+                    pixels + ((y * row_width + (has_base ? width : 0)) * 4),
+                    width * 4);
+        }
+
+        gl_atlas_position atlas_position =
+            surface_gl_atlas_add(surface, pixels, width, height, &page);
+
+        if (has_grey) {
+            gl_sprite->atlas_position = atlas_position;
+        } else {
+            gl_sprite->base_atlas_position = atlas_position;
+        }
+    }
+
+    gl_sprite->page = page;
+
+    free(pixels);
+}
+
+static int surface_gl_sprite_height_compare(const void *a, const void *b) {
+    SurfaceGlPackOrder order_a = *(SurfaceGlPackOrder *)a;
+    SurfaceGlPackOrder order_b = *(SurfaceGlPackOrder *)b;
+
+    if (order_a.height != order_b.height) {
+        return order_b.height - order_a.height;
+    }
+
+    return order_a.sprite_id - order_b.sprite_id;
+}
+
+/* copy the loaded sprites from start up to end into the atlas, tallest first
+ * as that leaves the fewest gaps under the skyline. their palette pixels are
+ * only kept until then */
+void surface_gl_pack_sprites(Surface *surface, int start, int end) {
+    if (end > surface->limit) {
+        end = surface->limit;
+    }
+
+    if (end <= start) {
+        return;
+    }
+
+    SurfaceGlPackOrder *order = calloc(end - start, sizeof(SurfaceGlPackOrder));
+    int order_length = 0;
+
+    for (int i = start; i < end; i++) {
+        if (surface->sprite_colours[i] != NULL) {
+            order[order_length].sprite_id = i;
+            order[order_length].height = surface->sprite_height[i];
+            order_length++;
+        }
+    }
+
+    qsort(order, order_length, sizeof(SurfaceGlPackOrder),
+          surface_gl_sprite_height_compare);
+
+    for (int i = 0; i < order_length; i++) {
+        int sprite_id = order[i].sprite_id;
+
+        surface_gl_pack_sprite(surface, sprite_id,
+                               sprite_id < surface->mud->sprite_media);
+
+        free(surface->sprite_colours[sprite_id]);
+        surface->sprite_colours[sprite_id] = NULL;
+
+        free(surface->sprite_palette[sprite_id]);
+        surface->sprite_palette[sprite_id] = NULL;
+    }
+
+    free(order);
+
+    atlas_gl_upload(&surface->gl_atlas);
+}
+
+/* once nothing else will be added */
+void surface_gl_finish_atlas(Surface *surface) {
+    atlas_gl_free_pixels(&surface->gl_atlas);
+}
 #endif
 
 #ifdef RENDER_3DS_GL
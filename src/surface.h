@@ -54,6 +54,9 @@ typedef struct gl_quad_vertex {
     float r, g, b, a; /* mask colour */
     float u, v;       /* greyscale texture that is multiplied by mask colour */
     float base_u, base_v; /* non grey-pixel portion that is added to coloured */
+#ifdef RENDER_GL
+    float skin_r, skin_g, skin_b; /* multiplies the skin pixels of the base */
+#endif
 } gl_quad_vertex;
 
 typedef struct gl_quad {
@@ -64,15 +67,32 @@ typedef struct gl_quad {
 #endif
 } gl_quad;
 
-/* atlas positions in ./textures/ to generate UVs */
+/* atlas positions to generate UVs */
 typedef struct gl_atlas_position {
     float left_u, right_u;
     float top_v, bottom_v;
 } gl_atlas_position;
 
+#ifdef RENDER_GL
+#include "gl/atlas.h"
+
+/* where a sprite was packed in surface->gl_atlas. the greyscale and base
+ * layers are always on the same page */
+typedef struct SurfaceGlSprite {
+    int8_t page; /* -1 when it isn't in the atlas */
+    gl_atlas_position atlas_position;
+    gl_atlas_position base_atlas_position;
+} SurfaceGlSprite;
+
+typedef struct SurfaceGlPackOrder {
+    int sprite_id;
+    int height;
+} SurfaceGlPackOrder;
+#elif defined(RENDER_3DS_GL)
 #include "gl/textures/entities.h"
 #include "gl/textures/fonts.h"
 #include "gl/textures/media.h"
+#endif
 
 #define GL_MAX_QUADS 2048
 
@@ -120,6 +140,61 @@ extern gl_atlas_position gl_transparent_atlas_position;
 #define MINIMAP_SPRITE_WIDTH 285
 #define MINIMAP_SPRITE_HEIGHT MINIMAP_SPRITE_WIDTH
 
+#ifdef RENDER_SW
+/* hash buckets for looking up recoloured sprites */
+#define SURFACE_TINT_BUCKETS 256
+
+/* max number of recoloured sprites kept at once, whatever their size */
+#define SURFACE_TINT_ENTRIES 512
+
+/* a sprite with its grey and skin masks already applied, so entities can be
+ * drawn without recolouring every pixel each frame. sprite colours are 24-bit,
+ * the top byte is set on opaque pixels to tell black apart from transparent */
+typedef struct SurfaceTintedSprite {
+    int sprite_id;
+    int mask_colour;
+    int skin_colour;
+
+    /* tint_stamp of the surface when this was last drawn */
+    int stamp;
+
+    /* next entry in the same bucket, or -1 */
+    int next;
+
+    size_t size;
+
+    /* one for each opaque pixel when the sprite is stored as spans */
+    int32_t *pixels;
+} SurfaceTintedSprite;
+
+/* a run of opaque pixels along one row of a sprite */
+typedef struct SurfaceSpan {
+    uint16_t x;
+    uint16_t length;
+
+    /* index of the first pixel of the run in colours or pixels */
+    int32_t offset;
+} SurfaceSpan;
+
+/* a sprite stored as only its opaque pixels, so drawing can step over the
+ * transparent ones instead of testing each of them. allocated as one block */
+typedef struct SurfaceSpans {
+    int height;
+
+    /* the spans of row y are spans[rows[y]] up to spans[rows[y + 1]] */
+    int32_t *rows;
+    SurfaceSpan *spans;
+
+    /* palette indices, one for each opaque pixel */
+    int8_t *colours;
+    int pixel_count;
+
+    /* loaded sprites keep their indices but are drawn with the colours
+     * their pixels would have had. NULL to use sprite_palette */
+    int32_t *palette;
+} SurfaceSpans;
+#endif
+
 typedef enum {
     FONT_REGULAR_11 = 0,
     FONT_BOLD_12 = 1,
@@ -181,11 +256,32 @@ struct Surface {
     int *rotations_4;
     int *rotations_5;
     int rotations_length;
+
+    /* recoloured sprites, with the least recently drawn freed first once
+     * tint_cache_size bytes are in use */
+    SurfaceTintedSprite *tint_cache;
+    int tint_buckets[SURFACE_TINT_BUCKETS];
+    int tint_count;
+    size_t tint_cache_used;
+    size_t tint_cache_size;
+    int tint_stamp;
+
+    /* sprites are turned into spans as they're loaded when rle_sprites is
+     * set, otherwise sprite_spans stays empty */
+    SurfaceSpans **sprite_spans;
+    int rle_sprites;
 #elif defined(RENDER_GL)
     Shader gl_flat_shader;
 
+    /* the first page of gl_atlas, which has the fonts and circle */
     GLuint gl_sprite_texture;
-    GLuint gl_entity_textures[ENTITY_TEXTURE_LENGTH];
+
+    gl_atlas gl_atlas;
+    SurfaceGlSprite *gl_sprites;
+    gl_atlas_position gl_font_positions[FONT_BOLD_24 + 1][CHAR_SET_LENGTH];
+    gl_atlas_position gl_font_shadow_positions[FONT_BOLD_24 + 1]
+                                              [CHAR_SET_LENGTH];
+    gl_atlas_position gl_circle_position;
 
     uint8_t *gl_dynamic_texture_buffer;
     GLuint gl_dynamic_texture;
@@ -209,6 +305,12 @@ struct Surface {
     gl_vertex_buffer gl_flat_buffer;
     int gl_flat_count;
 
+#ifdef RENDER_GL
+    /* quads are kept here until surface_gl_draw uploads them together */
+    gl_quad *gl_flat_quads;
+    int gl_flat_uploaded;
+#endif
+
     /* used for texture array and boundary changes */
     SurfaceGlContext gl_contexts[GL_MAX_QUADS];
     int gl_context_count;
@@ -250,6 +352,10 @@ void surface_gl_buffer_quad(Surface *surface, gl_quad *quad, C3D_Tex *texture,
 #endif
 void surface_gl_vertex_apply_colour(gl_quad_vertex *vertices, int length,
                                     int colour, int alpha);
+#ifdef RENDER_GL
+void surface_gl_vertex_apply_skin(gl_quad_vertex *vertices, int length,
+                                  int skin_colour);
+#endif
 void surface_gl_buffer_box(Surface *surface, int x, int y, int width,
                            int height, int colour, int alpha);
 void surface_gl_buffer_character(Surface *surface, char character, int x, int y,
@@ -296,6 +402,10 @@ void surface_fade_to_black_software(Surface *surface, int32_t *dest,
 void surface_fade_to_black(Surface *surface);
 void surface_apply_login_filter(Surface *surface, int background_height);
 void surface_clear(Surface *surface);
+void surface_set_tint_cache(Surface *surface, int size_kb);
+void surface_set_rle_sprites(Surface *surface, int enabled);
+void surface_free_spans(Surface *surface, int sprite_id);
+int surface_sprite_loaded(Surface *surface, int sprite_id);
 void surface_parse_sprite_tga(Surface *surface, int sprite_id,
                               int8_t *sprite_data, size_t len, int columns,
                               int rows);
@@ -392,6 +502,9 @@ void surface_draw_status_bar(Surface *surface, int max, int current,
 #ifdef RENDER_GL
 void surface_gl_create_framebuffer(Surface *surface);
 void surface_gl_update_dynamic_texture(Surface *surface);
+void surface_gl_pack_fonts(Surface *surface);
+void surface_gl_pack_sprites(Surface *surface, int start, int end);
+void surface_gl_finish_atlas(Surface *surface);
 #endif
 #ifdef RENDER_3DS_GL
 int surface_3ds_gl_get_sprite_texture_offsets(Surface *surface, int sprite_id,
@@ -706,6 +706,7 @@ void mudclient_render_login_scene_sprites(mudclient *mud) {
     }
 
     mud->scene->model_count = 0;
+    mud->scene->cull_dirty = 1;
 
 #if defined(RENDER_GL) || defined(RENDER_3DS_GL)
     mud->options->field_of_view = old_fov;
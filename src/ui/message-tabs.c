@@ -401,6 +401,11 @@ void mudclient_handle_message_tabs_input(mudclient *mud) {
                 mudclient_lost_connection(mud);
             } else if (strncasecmp(message + 2, "displayfps", 10) == 0) {
                 mud->options->display_fps = !mud->options->display_fps;
+            } else if (strncasecmp(message + 2, "profiler", 8) == 0) {
+                mud->options->display_profiler =
+                    !mud->options->display_profiler;
+            } else if (strncasecmp(message + 2, "trace", 5) == 0) {
+                mudclient_toggle_trace(mud);
             } else {
                 mudclient_send_command_string(mud, message + 2);
             }
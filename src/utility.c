@@ -6,9 +6,17 @@
 #define OPTIONS_UNIX
 #endif
 
+#ifdef _arch_dreamcast
+#include <arch/timer.h>
+#endif
+
 int sin_cos_512[512] = {0};
 int sin_cos_2048[2048] = {0};
 
+#ifdef JAG_ARCHIVES_LOCKED
+static SDL_mutex *jag_archives_lock = NULL;
+#endif
+
 static const int BITMASK[] = {
     0,          1,          3,         7,         15,        31,
     63,         127,        255,       511,       1023,      2047,
@@ -38,6 +46,12 @@ void init_utility_global(void) {
         sin_cos_2048[i] = (int)(sin((double)i * 0.00613592315) * 32768);
         sin_cos_2048[i + 1024] = (int)(cos((double)i * 0.00613592315) * 32768);
     }
+
+#ifdef JAG_ARCHIVES_LOCKED
+    if (jag_archives_lock == NULL) {
+        jag_archives_lock = SDL_CreateMutex();
+    }
+#endif
 }
 
 void get_config_path(const char *file, char *path) {
@@ -70,6 +84,33 @@ void get_config_path(const char *file, char *path) {
 #endif
 }
 
+/* for files the client can regenerate, like unpacked archives */
+void get_cache_path(const char *file, char *path) {
+#if defined(OPTIONS_UNIX) && !defined(ANDROID) && !defined(EMSCRIPTEN)
+    const char *xdg = getenv("XDG_CACHE_HOME");
+
+    if (xdg != NULL) {
+        snprintf(path, PATH_MAX, "%s/rsc-c", xdg);
+        (void)mkdir(path, S_IRUSR | S_IWUSR | S_IXUSR);
+        snprintf(path, PATH_MAX, "%s/rsc-c/%s", xdg, file);
+    } else {
+        const char *home = getenv("HOME");
+
+        if (home == NULL) {
+            home = "";
+        }
+
+        snprintf(path, PATH_MAX, "%s/.cache", home);
+        (void)mkdir(path, S_IRUSR | S_IWUSR | S_IXUSR);
+        snprintf(path, PATH_MAX, "%s/.cache/rsc-c", home);
+        (void)mkdir(path, S_IRUSR | S_IWUSR | S_IXUSR);
+        snprintf(path, PATH_MAX, "%s/.cache/rsc-c/%s", home, file);
+    }
+#else
+    get_config_path(file, path);
+#endif
+}
+
 #ifdef RENDER_3DS_GL
 int _3ds_gl_framebuffer_offsets_x[] = {
     0,     2,     8,     10,    32,    34,    40,    42,    1920,  1922,  1928,
@@ -505,79 +546,231 @@ static uint32_t get_archive_size(void *b, int entry) {
            (uint32_t)(buffer[entry * 10 + 11] & 0xff);
 }
 
-uint32_t get_data_file_offset(const char *file_name, void *buffer) {
-    /* FIXME: unsafe, need to know buffer size */
-    uint16_t num_entries = get_unsigned_short(buffer, 0, SIZE_MAX);
-    uint32_t wanted_hash = hash_file_name(file_name);
-    size_t offset = 2 + num_entries * 10;
+static JagArchive jag_archives[JAG_ARCHIVES_MAX] = {0};
+
+static void jag_archives_lock_enter(void) {
+#ifdef JAG_ARCHIVES_LOCKED
+    if (jag_archives_lock != NULL) {
+        SDL_LockMutex(jag_archives_lock);
+    }
+#endif
+}
+
+static void jag_archives_lock_leave(void) {
+#ifdef JAG_ARCHIVES_LOCKED
+    if (jag_archives_lock != NULL) {
+        SDL_UnlockMutex(jag_archives_lock);
+    }
+#endif
+}
+
+static uint32_t jag_archive_slot(uint32_t hash, uint32_t mask) {
+    /* file name hashes are clustered for similar names, so mix before masking
+     * (fibonacci hashing) */
+    return (hash * 2654435761u >> 7) & mask;
+}
+
+static void jag_archive_build(JagArchive *archive, void *archive_data) {
+    uint16_t num_entries = get_unsigned_short(archive_data, 0, SIZE_MAX);
+
+    /* keep the load factor at or below one half */
+    uint32_t table_size = 16;
+
+    while (table_size < (uint32_t)num_entries * 2) {
+        table_size *= 2;
+    }
+
+    JagArchiveEntry *table = calloc(table_size, sizeof(JagArchiveEntry));
+
+    if (table == NULL) {
+        return;
+    }
+
+    uint32_t mask = table_size - 1;
+    uint32_t offset = 2 + num_entries * 10;
 
     for (int entry = 0; entry < num_entries; entry++) {
-        uint32_t file_hash = get_file_hash(buffer, entry);
-        uint32_t archive_size = get_archive_size(buffer, entry);
+        uint32_t file_hash = get_file_hash(archive_data, entry);
+        uint32_t archive_size = get_archive_size(archive_data, entry);
+        uint32_t slot = jag_archive_slot(file_hash, mask);
+
+        /* offset is never 0 for a real entry, so it marks empty slots */
+        while (table[slot].offset != 0 && table[slot].hash != file_hash) {
+            slot = (slot + 1) & mask;
+        }
 
-        if (file_hash == wanted_hash) {
-            return offset;
+        /* the first entry with a given hash wins, same as the linear scan */
+        if (table[slot].offset == 0) {
+            table[slot].hash = file_hash;
+            table[slot].offset = offset;
+            table[slot].size = get_file_size(archive_data, entry);
+            table[slot].archive_size = archive_size;
         }
 
         offset += archive_size;
     }
 
-    return 0;
+    archive->data = archive_data;
+    archive->entry_count = num_entries;
+    archive->table_mask = mask;
+    archive->table = table;
 }
 
-uint32_t get_data_file_length(const char *file_name, void *buffer) {
-    /* FIXME: unsafe, need to know buffer size */
-    uint16_t num_entries = get_unsigned_short(buffer, 0, SIZE_MAX);
-    uint32_t wanted_hash = hash_file_name(file_name);
+void jag_archive_index(void *archive_data) {
+    if (archive_data == NULL) {
+        return;
+    }
 
-    for (int entry = 0; entry < num_entries; entry++) {
-        uint32_t file_hash = get_file_hash(buffer, entry);
-        uint32_t file_size = get_file_size(buffer, entry);
+    jag_archives_lock_enter();
+
+    JagArchive *archive = NULL;
+
+    for (int i = 0; i < JAG_ARCHIVES_MAX; i++) {
+        if (jag_archives[i].data == archive_data) {
+            jag_archives_lock_leave();
+            return;
+        }
 
-        if (file_hash == wanted_hash) {
-            return file_size;
+        if (archive == NULL && jag_archives[i].data == NULL) {
+            archive = &jag_archives[i];
         }
     }
 
-    return 0;
+    if (archive == NULL) {
+        /* lookups will fall back to scanning the header */
+        mud_error("too many archives to index\n");
+    } else {
+        jag_archive_build(archive, archive_data);
+    }
+
+    jag_archives_lock_leave();
 }
 
-void *unpack_data(const char *file_name, size_t extra_size, void *archive_data,
-                  void *data_out, size_t *size_out) {
-    /* FIXME: unsafe, need to know buffer size */
-    uint16_t num_entries = get_unsigned_short(archive_data, 0, SIZE_MAX);
+void jag_archive_release(void *archive_data) {
+    if (archive_data == NULL) {
+        return;
+    }
+
+    jag_archives_lock_enter();
+
+    for (int i = 0; i < JAG_ARCHIVES_MAX; i++) {
+        if (jag_archives[i].data == archive_data) {
+            free(jag_archives[i].table);
+            memset(&jag_archives[i], 0, sizeof(JagArchive));
+            break;
+        }
+    }
+
+    jag_archives_lock_leave();
+}
+
+/* call with the lock held. the entry is only valid until it's released */
+static JagArchive *jag_archive_get(void *archive_data) {
+    for (int i = 0; i < JAG_ARCHIVES_MAX; i++) {
+        if (jag_archives[i].data == archive_data) {
+            return &jag_archives[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* find the header entry for file_name, using the archive's index if it has
+ * one. entry is filled in and 1 returned if found */
+static int jag_archive_find(void *archive_data, const char *file_name,
+                            JagArchiveEntry *entry) {
     uint32_t wanted_hash = hash_file_name(file_name);
 
-    uint32_t offset = 2 + num_entries * 10;
+    jag_archives_lock_enter();
 
-    for (int entry = 0; entry < num_entries; entry++) {
-        uint32_t file_hash = get_file_hash(archive_data, entry);
-        uint32_t file_size = get_file_size(archive_data, entry);
-        uint32_t archive_size = get_archive_size(archive_data, entry);
+    JagArchive *archive = jag_archive_get(archive_data);
 
-        if (file_hash == wanted_hash) {
-            if (data_out == NULL) {
-                data_out = malloc(file_size + extra_size);
-                /* FIXME: does not check malloc return value */
-            }
+    if (archive != NULL) {
+        uint32_t slot = jag_archive_slot(wanted_hash, archive->table_mask);
+        int found = 0;
 
-            if (file_size != archive_size) {
-                bzip_decompress(data_out, (int8_t *)archive_data, archive_size,
-                                offset);
-            } else {
-                memcpy(data_out, ((uint8_t *)archive_data + offset), file_size);
+        while (archive->table[slot].offset != 0) {
+            if (archive->table[slot].hash == wanted_hash) {
+                *entry = archive->table[slot];
+                found = 1;
+                break;
             }
 
-            if (size_out != NULL) {
-                *size_out = file_size;
-            }
-            return data_out;
+            slot = (slot + 1) & archive->table_mask;
+        }
+
+        jag_archives_lock_leave();
+        return found;
+    }
+
+    jag_archives_lock_leave();
+
+    /* FIXME: unsafe, need to know buffer size */
+    uint16_t num_entries = get_unsigned_short(archive_data, 0, SIZE_MAX);
+    uint32_t offset = 2 + num_entries * 10;
+
+    for (int i = 0; i < num_entries; i++) {
+        uint32_t archive_size = get_archive_size(archive_data, i);
+
+        if (get_file_hash(archive_data, i) == wanted_hash) {
+            entry->hash = wanted_hash;
+            entry->offset = offset;
+            entry->size = get_file_size(archive_data, i);
+            entry->archive_size = archive_size;
+            return 1;
         }
 
         offset += archive_size;
     }
 
-    return NULL;
+    return 0;
+}
+
+uint32_t get_data_file_offset(const char *file_name, void *buffer) {
+    JagArchiveEntry entry = {0};
+
+    if (!jag_archive_find(buffer, file_name, &entry)) {
+        return 0;
+    }
+
+    return entry.offset;
+}
+
+uint32_t get_data_file_length(const char *file_name, void *buffer) {
+    JagArchiveEntry entry = {0};
+
+    if (!jag_archive_find(buffer, file_name, &entry)) {
+        return 0;
+    }
+
+    return entry.size;
+}
+
+void *unpack_data(const char *file_name, size_t extra_size, void *archive_data,
+                  void *data_out, size_t *size_out) {
+    JagArchiveEntry entry = {0};
+
+    if (!jag_archive_find(archive_data, file_name, &entry)) {
+        return NULL;
+    }
+
+    if (data_out == NULL) {
+        data_out = malloc(entry.size + extra_size);
+        /* FIXME: does not check malloc return value */
+    }
+
+    if (entry.size != entry.archive_size) {
+        bzip_decompress(data_out, (int8_t *)archive_data, entry.archive_size,
+                        entry.offset);
+    } else {
+        memcpy(data_out, ((uint8_t *)archive_data + entry.offset), entry.size);
+    }
+
+    if (size_out != NULL) {
+        *size_out = entry.size;
+    }
+
+    return data_out;
 }
 
 void *load_data(const char *file_name, size_t extra_size, void *archive_data,
@@ -653,6 +846,30 @@ int get_ticks(void) {
 #endif
 }
 
+/* microseconds since an arbitrary point, for timing within a frame */
+int64_t get_ticks_us(void) {
+#ifdef _arch_dreamcast
+    return (int64_t)timer_us_gettime64();
+#elif defined(_3DS)
+    return (int64_t)(svcGetSystemTick() / (CPU_TICKS_PER_MSEC / 1000));
+#elif defined(WII)
+    return (int64_t)ticks_to_microsecs(gettime());
+#elif defined(SDL2)
+    static uint64_t frequency = 0;
+
+    if (frequency == 0) {
+        frequency = SDL_GetPerformanceFrequency();
+    }
+
+    uint64_t counter = SDL_GetPerformanceCounter();
+
+    return (int64_t)((counter / frequency) * 1000000 +
+                     ((counter % frequency) * 1000000) / frequency);
+#else
+    return (int64_t)SDL_GetTicks() * 1000;
+#endif
+}
+
 void delay_ticks(int ticks) {
 #if !defined(WII) && !defined(_3DS)
 #ifdef EMSCRIPTEN
@@ -92,6 +92,32 @@
 #define FLOAT_TO_VERTEX(f) (int)(f * VERTEX_SCALE)
 #endif
 
+/* max number of .jag/.mem archives that can be indexed at once */
+#define JAG_ARCHIVES_MAX 16
+
+/* archives are looked up from the world prefetch thread as well as the main
+ * thread, so the index is behind a lock where there are threads */
+#if !defined(WII) && !defined(_3DS)
+#define JAG_ARCHIVES_LOCKED
+#endif
+
+typedef struct JagArchiveEntry {
+    uint32_t hash;
+    uint32_t offset;
+    uint32_t size;
+    uint32_t archive_size;
+} JagArchiveEntry;
+
+/* parsed header of a loaded archive buffer, with an open-addressed table from
+ * file name hash to entry. built once by jag_archive_index so lookups by name
+ * don't rescan the header */
+typedef struct JagArchive {
+    void *data;
+    uint16_t entry_count;
+    uint32_t table_mask;
+    JagArchiveEntry *table;
+} JagArchive;
+
 typedef struct CertificateItem {
     int certificate_id;
     int item_id;
@@ -116,6 +142,7 @@ void strtrim(char *s);
 void strtolower(char *s);
 
 void get_config_path(const char *file, char *path);
+void get_cache_path(const char *file, char *path);
 
 int get_signed_byte(void *, size_t, size_t);
 int get_unsigned_byte(void *, size_t, size_t);
@@ -131,6 +158,8 @@ void format_auth_string(char *raw, int max_length, char *formatted);
 void ip_to_string(int32_t ip, char *ip_string);
 int64_t encode_username(char *username);
 void decode_username(int64_t encoded, char *decoded);
+void jag_archive_index(void *archive_data);
+void jag_archive_release(void *archive_data);
 uint32_t get_data_file_offset(const char *file_name, void *buffer);
 uint32_t get_data_file_length(const char *file_name, void *buffer);
 void *unpack_data(const char *file_name, size_t extra_size, void *archive_data,
@@ -139,6 +168,7 @@ void *load_data(const char *file_name, size_t extra_size, void *archive_data,
                 size_t *size_out);
 void format_confirm_amount(int amount, char *formatted);
 int get_ticks(void);
+int64_t get_ticks_us(void);
 void delay_ticks(int ticks);
 void get_level_difference_colour(int level_difference, char *colour);
 void ulaw_to_linear(long size, uint8_t *u_ptr, int16_t *out_ptr);
@@ -5,7 +5,7 @@ static void world_set_unblocked(World *, int, int, int);
 static int world_get_wall_east_west(World *, int, int);
 static int world_get_wall_diagonal(World *, int, int);
 static void world_map_set_pixel(World *, int, int, int);
-static void world_load_section_jm(World *, uint8_t *, size_t, int);
+static void world_load_section_jm(WorldSection *, uint8_t *, size_t);
 static int world_get_object_adjacency(World *, int, int);
 static int world_has_roof(World *, int, int);
 static int world_get_terrain_colour(World *, int, int);
@@ -21,7 +21,10 @@ static void world_create_wall(World *, GameModel *, int, int, int, int, int);
 static void world_update_shadow_rect(World *, int, int, int, int);
 static void world_vertex_shadow(World *, int, int, int);
 static int world_get_tile_type(World *, int, int);
-static void world_clear_region(World *world, int plane, int chunk);
+static void world_clear_section(WorldSection *section);
+static void world_route_reset(World *);
+static void world_free_models(World *);
+static void world_build_region(World *, int, int, int);
 
 int16_t terrain_colours[TERRAIN_COLOUR_COUNT];
 
@@ -217,6 +220,7 @@ void world_register_object(World *world, int x, int y, int id) {
         }
 
         world_update_shadow_rect(world, x, y, model_width, model_height);
+        world_route_reset(world);
     }
 }
 
@@ -245,6 +249,7 @@ void world_remove_wall_object(World *world, int x, int y, int k, int id) {
         }
 
         world_update_shadow_rect(world, x, y, 1, 1);
+        world_route_reset(world);
     }
 }
 
@@ -325,74 +330,141 @@ static void world_draw_map_tile(World *world, int x, int y, int direction,
     }
 }
 
-static void world_load_section_jm(World *world, uint8_t *map_data, size_t len,
-                                  int chunk) {
+/* keep a minimap drawing call for world_draw_map */
+static void world_record_map(World *world, int type, int x, int y, int size,
+                             int colour, int colour_2) {
+    if (world->map_op_count >= world->map_op_length) {
+        int length =
+            world->map_op_length == 0 ? 4096 : world->map_op_length * 2;
+
+        WorldMapOp *map_ops =
+            realloc(world->map_ops, length * sizeof(WorldMapOp));
+
+        if (map_ops == NULL) {
+            return;
+        }
+
+        world->map_ops = map_ops;
+        world->map_op_length = length;
+    }
+
+    WorldMapOp *map_op = &world->map_ops[world->map_op_count++];
+
+    map_op->type = type;
+    map_op->size = size;
+    map_op->x = x;
+    map_op->y = y;
+    map_op->colour = colour;
+    map_op->colour_2 = colour_2;
+}
+
+/* draw the minimap recorded while the region was built into its sprite */
+static void world_draw_map(World *world) {
+    surface_black_screen(world->surface);
+
+    for (int i = 0; i < world->map_op_count; i++) {
+        WorldMapOp *map_op = &world->map_ops[i];
+
+        switch (map_op->type) {
+        case WORLD_MAP_TILE:
+            world_draw_map_tile(world, map_op->x, map_op->y, map_op->size,
+                                map_op->colour, map_op->colour_2);
+            break;
+        case WORLD_MAP_LINE_HORIZONTAL:
+            world_map_line_horizontal(world, map_op->x, map_op->y,
+                                      map_op->size, map_op->colour);
+            break;
+        case WORLD_MAP_LINE_VERTICAL:
+            world_map_line_vertical(world, map_op->x, map_op->y, map_op->size,
+                                    map_op->colour);
+            break;
+        case WORLD_MAP_PIXEL:
+            world_map_set_pixel(world, map_op->x, map_op->y, map_op->colour);
+            break;
+        }
+    }
+
+#ifdef RENDER_GL
+    surface_gl_update_dynamic_texture(world->surface);
+#endif
+
+    surface_draw_sprite_reversed(world->surface, world->base_media_sprite - 1,
+                                 0, 0, MINIMAP_SPRITE_WIDTH,
+                                 MINIMAP_SPRITE_WIDTH);
+}
+
+static void world_load_section_jm(WorldSection *section, uint8_t *map_data,
+                                  size_t len) {
     size_t offset = 0;
     int prev = 0;
 
     for (int tile = 0; tile < TILE_COUNT;) {
         prev += get_signed_byte(map_data, offset++, len);
-        world->terrain_height[chunk][tile++] = prev & 0xff;
+        section->terrain_height[tile++] = prev & 0xff;
     }
 
     prev = 0;
 
     for (int tile = 0; tile < TILE_COUNT;) {
         prev += get_signed_byte(map_data, offset++, len);
-        world->terrain_colour[chunk][tile++] = prev & 0xff;
+        section->terrain_colour[tile++] = prev & 0xff;
     }
 
     for (int tile = 0; tile < TILE_COUNT;) {
-        world->walls_north_south[chunk][tile++] =
+        section->walls_north_south[tile++] =
             get_signed_byte(map_data, offset++, len);
     }
 
     for (int tile = 0; tile < TILE_COUNT;) {
-        world->walls_east_west[chunk][tile++] =
+        section->walls_east_west[tile++] =
             get_signed_byte(map_data, offset++, len);
     }
 
     for (int tile = 0; tile < TILE_COUNT;) {
-        world->walls_diagonal[chunk][tile++] =
+        section->walls_diagonal[tile++] =
             get_unsigned_short(map_data, offset, len);
         offset += 2;
     }
 
     for (int tile = 0; tile < TILE_COUNT;) {
-        world->walls_roof[chunk][tile++] =
+        section->walls_roof[tile++] =
             get_signed_byte(map_data, offset++, len);
     }
 
     for (int tile = 0; tile < TILE_COUNT;) {
-        world->tile_decoration[chunk][tile++] =
+        section->tile_decoration[tile++] =
             get_signed_byte(map_data, offset++, len);
     }
 
     for (int tile = 0; tile < TILE_COUNT;) {
-        world->tile_direction[chunk][tile++] =
+        section->tile_direction[tile++] =
             get_signed_byte(map_data, offset++, len);
     }
 }
 
-static void world_clear_region(World *world, int plane, int chunk) {
-    memset(world->terrain_height[chunk], 0, TILE_COUNT);
-    memset(world->terrain_colour[chunk], 0, TILE_COUNT);
-    memset(world->walls_north_south[chunk], 0, TILE_COUNT);
-    memset(world->walls_east_west[chunk], 0, TILE_COUNT);
-    memset(world->walls_diagonal[chunk], 0, TILE_COUNT * sizeof(uint16_t));
-    memset(world->walls_roof[chunk], 0, TILE_COUNT);
-    if (plane == 0) {
-        memset(world->tile_decoration[chunk], -6, TILE_COUNT);
-    } else if (plane == 3) {
-        memset(world->tile_decoration[chunk], 8, TILE_COUNT);
+static void world_clear_section(WorldSection *section) {
+    memset(section->terrain_height, 0, TILE_COUNT);
+    memset(section->terrain_colour, 0, TILE_COUNT);
+    memset(section->walls_north_south, 0, TILE_COUNT);
+    memset(section->walls_east_west, 0, TILE_COUNT);
+    memset(section->walls_diagonal, 0, TILE_COUNT * sizeof(uint16_t));
+    memset(section->walls_roof, 0, TILE_COUNT);
+    if (section->plane == 0) {
+        memset(section->tile_decoration, -6, TILE_COUNT);
+    } else if (section->plane == 3) {
+        memset(section->tile_decoration, 8, TILE_COUNT);
     } else {
-        memset(world->tile_decoration[chunk], 0, TILE_COUNT);
+        memset(section->tile_decoration, 0, TILE_COUNT);
     }
-    memset(world->tile_direction[chunk], 0, TILE_COUNT);
+    memset(section->tile_direction, 0, TILE_COUNT);
 }
 
-static void world_load_section_files(World *world, int x, int y, int plane,
-                                     int chunk) {
+/* only reads the map archives, so is safe to run on the prefetch thread */
+static void world_decode_section(World *world, WorldSection *section) {
+    int x = section->x;
+    int y = section->y;
+    int plane = section->plane;
+
     char map_name[64];
     snprintf(map_name, sizeof(map_name), "m%d%d%d%d%d",
              plane, x / 10, x % 10, y / 10, y % 10);
@@ -405,10 +477,10 @@ static void world_load_section_files(World *world, int x, int y, int plane,
         strcpy(map_name + map_name_length, ".jm");
         map_data = load_data(map_name, 0, world->map_pack, &len);
         if (map_data != NULL) {
-            world_load_section_jm(world, map_data, len, chunk);
+            world_load_section_jm(section, map_data, len);
             free(map_data);
         } else {
-            world_clear_region(world, plane, chunk);
+            world_clear_section(section);
         }
         return;
     }
@@ -430,13 +502,13 @@ static void world_load_section_files(World *world, int x, int y, int plane,
             int val = get_unsigned_byte(map_data, offset++, len);
 
             if (val < 128) {
-                world->terrain_height[chunk][tile++] = (int8_t)val;
+                section->terrain_height[tile++] = (int8_t)val;
                 last_val = val;
             }
 
             if (val >= 128) {
                 for (int i = 0; i < val - 128; i++)
-                    world->terrain_height[chunk][tile++] = (int8_t)last_val;
+                    section->terrain_height[tile++] = (int8_t)last_val;
             }
         }
 
@@ -444,11 +516,11 @@ static void world_load_section_files(World *world, int x, int y, int plane,
 
         for (int tile_y = 0; tile_y < 48; tile_y++) {
             for (int tile_x = 0; tile_x < 48; tile_x++) {
-                last_val = (world->terrain_height[chunk][tile_x * 48 + tile_y] +
+                last_val = (section->terrain_height[tile_x * 48 + tile_y] +
                             last_val) &
                            127;
 
-                world->terrain_height[chunk][tile_x * 48 + tile_y] =
+                section->terrain_height[tile_x * 48 + tile_y] =
                     (int8_t)(last_val * 2);
             }
         }
@@ -459,13 +531,13 @@ static void world_load_section_files(World *world, int x, int y, int plane,
             int val = get_unsigned_byte(map_data, offset++, len);
 
             if (val < 128) {
-                world->terrain_colour[chunk][tile++] = (int8_t)val;
+                section->terrain_colour[tile++] = (int8_t)val;
                 last_val = val;
             }
 
             if (val >= 128) {
                 for (int i = 0; i < val - 128; i++)
-                    world->terrain_colour[chunk][tile++] = (int8_t)last_val;
+                    section->terrain_colour[tile++] = (int8_t)last_val;
             }
         }
 
@@ -473,18 +545,18 @@ static void world_load_section_files(World *world, int x, int y, int plane,
 
         for (int tile_y = 0; tile_y < 48; tile_y++) {
             for (int tile_x = 0; tile_x < 48; tile_x++) {
-                last_val = (world->terrain_colour[chunk][tile_x * 48 + tile_y] +
+                last_val = (section->terrain_colour[tile_x * 48 + tile_y] +
                             last_val) &
                            127;
 
-                world->terrain_colour[chunk][tile_x * 48 + tile_y] =
+                section->terrain_colour[tile_x * 48 + tile_y] =
                     (int8_t)(last_val * 2);
             }
         }
     } else {
         for (int tile = 0; tile < TILE_COUNT; tile++) {
-            world->terrain_height[chunk][tile] = 0;
-            world->terrain_colour[chunk][tile] = 0;
+            section->terrain_height[tile] = 0;
+            section->terrain_colour[tile] = 0;
         }
     }
 
@@ -505,21 +577,21 @@ static void world_load_section_files(World *world, int x, int y, int plane,
             int val = get_unsigned_byte(map_data, offset++, len);
 
 #if VERSION_MAPS > 53
-            world->walls_north_south[chunk][tile++] = val;
+            section->walls_north_south[tile++] = val;
 #elif VERSION_MAPS > 45
             if (val < 192) {
-                world->walls_north_south[chunk][tile++] = val;
+                section->walls_north_south[tile++] = val;
             } else {
                 for (int i = 0; i < val - 192; i++) {
-                    world->walls_north_south[chunk][tile++] = 0;
+                    section->walls_north_south[tile++] = 0;
                 }
             }
 #else
             if (val < 128) {
-                world->walls_north_south[chunk][tile++] = val;
+                section->walls_north_south[tile++] = val;
             } else {
                 for (int i = 0; i < val - 128; i++) {
-                    world->walls_north_south[chunk][tile++] = 0;
+                    section->walls_north_south[tile++] = 0;
                 }
             }
 #endif
@@ -529,21 +601,21 @@ static void world_load_section_files(World *world, int x, int y, int plane,
             int val = get_unsigned_byte(map_data, offset++, len);
 
 #if VERSION_MAPS > 53
-            world->walls_east_west[chunk][tile++] = val;
+            section->walls_east_west[tile++] = val;
 #elif VERSION_MAPS > 45
             if (val < 192) {
-                world->walls_east_west[chunk][tile++] = val;
+                section->walls_east_west[tile++] = val;
             } else {
                 for (int i = 0; i < val - 192; i++) {
-                    world->walls_east_west[chunk][tile++] = 0;
+                    section->walls_east_west[tile++] = 0;
                 }
             }
 #else
             if (val < 128) {
-                world->walls_east_west[chunk][tile++] = val;
+                section->walls_east_west[tile++] = val;
             } else {
                 for (int i = 0; i < val - 128; i++) {
-                    world->walls_east_west[chunk][tile++] = 0;
+                    section->walls_east_west[tile++] = 0;
                 }
             }
 #endif
@@ -553,21 +625,21 @@ static void world_load_section_files(World *world, int x, int y, int plane,
             int val = get_unsigned_byte(map_data, offset++, len);
 
 #if VERSION_MAPS > 53
-            world->walls_diagonal[chunk][tile++] = val;
+            section->walls_diagonal[tile++] = val;
 #elif VERSION_MAPS > 45
             if (val < 192) {
-                world->walls_diagonal[chunk][tile++] = val;
+                section->walls_diagonal[tile++] = val;
             } else {
                 for (int i = 0; i < val - 192; i++) {
-                    world->walls_diagonal[chunk][tile++] = 0;
+                    section->walls_diagonal[tile++] = 0;
                 }
             }
 #else
             if (val < 128) {
-                world->walls_diagonal[chunk][tile++] = val;
+                section->walls_diagonal[tile++] = val;
             } else {
                 for (int i = 0; i < val - 128; i++) {
-                    world->walls_diagonal[chunk][tile++] = 0;
+                    section->walls_diagonal[tile++] = 0;
                 }
             }
 #endif
@@ -578,18 +650,18 @@ static void world_load_section_files(World *world, int x, int y, int plane,
 
 #if VERSION_MAPS > 53
             if (val > 0) {
-                world->walls_diagonal[chunk][tile] = val + 12000;
+                section->walls_diagonal[tile] = val + 12000;
             }
             tile++;
 #elif VERSION_MAPS > 45
             if (val < 192) {
-                world->walls_diagonal[chunk][tile++] = val + 12000;
+                section->walls_diagonal[tile++] = val + 12000;
             } else {
                 tile += (val - 192);
             }
 #else
             if (val < 128) {
-                world->walls_diagonal[chunk][tile++] = val + 12000;
+                section->walls_diagonal[tile++] = val + 12000;
             } else {
                 tile += (val - 128);
             }
@@ -600,10 +672,10 @@ static void world_load_section_files(World *world, int x, int y, int plane,
             int val = get_unsigned_byte(map_data, offset++, len);
 
             if (val < 128) {
-                world->walls_roof[chunk][tile++] = (int8_t)val;
+                section->walls_roof[tile++] = (int8_t)val;
             } else {
                 for (int i = 0; i < val - 128; i++) {
-                    world->walls_roof[chunk][tile++] = 0;
+                    section->walls_roof[tile++] = 0;
                 }
             }
         }
@@ -614,11 +686,11 @@ static void world_load_section_files(World *world, int x, int y, int plane,
             int val = get_unsigned_byte(map_data, offset++, len);
 
             if (val < 128) {
-                world->tile_decoration[chunk][tile++] = (int8_t)val;
+                section->tile_decoration[tile++] = (int8_t)val;
                 last_val = val;
             } else {
                 for (int i = 0; i < val - 128; i++) {
-                    world->tile_decoration[chunk][tile++] = (int8_t)last_val;
+                    section->tile_decoration[tile++] = (int8_t)last_val;
                 }
             }
         }
@@ -627,10 +699,10 @@ static void world_load_section_files(World *world, int x, int y, int plane,
             int val = get_unsigned_byte(map_data, offset++, len);
 
             if (val < 128) {
-                world->tile_direction[chunk][tile++] = (int8_t)val;
+                section->tile_direction[tile++] = (int8_t)val;
             } else {
                 for (int i = 0; i < val - 128; i++) {
-                    world->tile_direction[chunk][tile++] = 0;
+                    section->tile_direction[tile++] = 0;
                 }
             }
         }
@@ -648,7 +720,7 @@ static void world_load_section_files(World *world, int x, int y, int plane,
                 int val = get_unsigned_byte(map_data, offset++, len);
 
                 if (val < 128) {
-                    world->walls_diagonal[chunk][tile++] = val + 48000;
+                    section->walls_diagonal[tile++] = val + 48000;
                 } else {
                     tile += val - 128;
                 }
@@ -657,8 +729,214 @@ static void world_load_section_files(World *world, int x, int y, int plane,
             free(map_data);
         }
     } else {
-        world_clear_region(world, plane, chunk);
+        world_clear_section(section);
+    }
+}
+
+static void world_lock_sections(World *world) {
+#ifdef WORLD_PREFETCH_THREADED
+    if (world->prefetching) {
+        SDL_LockMutex(world->prefetch_lock);
+    }
+#else
+    (void)world;
+#endif
+}
+
+static void world_unlock_sections(World *world) {
+#ifdef WORLD_PREFETCH_THREADED
+    if (world->prefetching) {
+        SDL_UnlockMutex(world->prefetch_lock);
+    }
+#else
+    (void)world;
+#endif
+}
+
+/* sections must be locked */
+static WorldSection *world_find_section(World *world, int x, int y,
+                                        int plane) {
+    for (int i = 0; i < world->section_count; i++) {
+        WorldSection *section = &world->sections[i];
+
+        if (section->state != WORLD_SECTION_EMPTY && section->x == x &&
+            section->y == y && section->plane == plane) {
+            return section;
+        }
+    }
+
+    return NULL;
+}
+
+/* sections must be locked. the least recently used section, but never one
+ * being decoded or already used since the stamp last changed */
+static WorldSection *world_oldest_section(World *world) {
+    WorldSection *oldest = NULL;
+
+    for (int i = 0; i < world->section_count; i++) {
+        WorldSection *section = &world->sections[i];
+
+        if (section->state == WORLD_SECTION_DECODING ||
+            section->stamp == world->section_stamp) {
+            continue;
+        }
+
+        if (oldest == NULL || section->state == WORLD_SECTION_EMPTY ||
+            (oldest->state != WORLD_SECTION_EMPTY &&
+             section->stamp < oldest->stamp)) {
+            oldest = section;
+        }
+    }
+
+    return oldest;
+}
+
+#ifdef WORLD_PREFETCH_THREADED
+/* sections must be locked */
+static void world_prefetch_queue(World *world, int x, int y, int plane) {
+    WorldSection *section = world_find_section(world, x, y, plane);
+
+    if (section != NULL) {
+        section->stamp = world->section_stamp;
+        return;
     }
+
+    section = world_oldest_section(world);
+
+    if (section == NULL) {
+        return;
+    }
+
+    section->x = x;
+    section->y = y;
+    section->plane = plane;
+    section->stamp = world->section_stamp;
+    section->state = WORLD_SECTION_QUEUED;
+
+    SDL_CondSignal(world->prefetch_queued);
+}
+
+static int world_prefetch_thread(void *data) {
+    World *world = data;
+
+    SDL_LockMutex(world->prefetch_lock);
+
+    for (;;) {
+        WorldSection *section = NULL;
+
+        for (int i = 0; i < world->section_count; i++) {
+            if (world->sections[i].state == WORLD_SECTION_QUEUED) {
+                section = &world->sections[i];
+                break;
+            }
+        }
+
+        if (section == NULL &&
+            world->prefetch_region_state == WORLD_SECTION_QUEUED) {
+            World *region = world->prefetch_region;
+            int x = world->prefetch_region_x * REGION_SIZE;
+            int y = world->prefetch_region_y * REGION_SIZE;
+            int plane = world->prefetch_region_plane;
+
+            world->prefetch_region_state = WORLD_SECTION_DECODING;
+
+            SDL_UnlockMutex(world->prefetch_lock);
+            world_free_models(region);
+            world_build_region(region, x, y, plane);
+            SDL_LockMutex(world->prefetch_lock);
+
+            world->prefetch_region_state = WORLD_SECTION_READY;
+
+            SDL_CondBroadcast(world->prefetch_done);
+            continue;
+        }
+
+        if (section == NULL) {
+            SDL_CondWait(world->prefetch_queued, world->prefetch_lock);
+            continue;
+        }
+
+        section->state = WORLD_SECTION_DECODING;
+
+        SDL_UnlockMutex(world->prefetch_lock);
+        world_decode_section(world, section);
+        SDL_LockMutex(world->prefetch_lock);
+
+        section->state = WORLD_SECTION_READY;
+
+        SDL_CondBroadcast(world->prefetch_done);
+    }
+
+    return 0;
+}
+#endif
+
+/* copy a section into one of the four chunks of the loaded region, decoding
+ * its map files unless it's cached */
+static void world_load_section_files(World *world, int x, int y, int plane,
+                                     int chunk) {
+    world_lock_sections(world);
+
+    WorldSection *section = world_find_section(world, x, y, plane);
+
+    /* quicker to decode it here than to wait for the prefetch thread */
+    if (section == NULL || section->state == WORLD_SECTION_QUEUED) {
+        /* the main thread may be copying out of any section the prefetch
+         * region doesn't hold the lock for */
+        if (section == NULL && !world->is_prefetch_region) {
+            section = world_oldest_section(world);
+        }
+
+        if (section == NULL) {
+            section = &world->loaded_section;
+        }
+
+        section->x = x;
+        section->y = y;
+        section->plane = plane;
+        section->state = WORLD_SECTION_DECODING;
+
+        world_unlock_sections(world);
+        world_decode_section(world, section);
+        world_lock_sections(world);
+
+        section->state = WORLD_SECTION_READY;
+
+#ifdef WORLD_PREFETCH_THREADED
+        /* the prefetch region may be waiting for it */
+        if (world->prefetching) {
+            SDL_CondBroadcast(world->prefetch_done);
+        }
+#endif
+    }
+
+#ifdef WORLD_PREFETCH_THREADED
+    while (section->state == WORLD_SECTION_DECODING) {
+        SDL_CondWait(world->prefetch_done, world->prefetch_lock);
+    }
+#endif
+
+    if (!world->is_prefetch_region) {
+        section->stamp = world->section_stamp;
+    }
+
+    memcpy(world->terrain_height[chunk], section->terrain_height, TILE_COUNT);
+    memcpy(world->terrain_colour[chunk], section->terrain_colour, TILE_COUNT);
+
+    memcpy(world->walls_north_south[chunk], section->walls_north_south,
+           TILE_COUNT);
+
+    memcpy(world->walls_east_west[chunk], section->walls_east_west,
+           TILE_COUNT);
+
+    memcpy(world->walls_diagonal[chunk], section->walls_diagonal,
+           TILE_COUNT * sizeof(uint16_t));
+
+    memcpy(world->walls_roof[chunk], section->walls_roof, TILE_COUNT);
+    memcpy(world->tile_decoration[chunk], section->tile_decoration, TILE_COUNT);
+    memcpy(world->tile_direction[chunk], section->tile_direction, TILE_COUNT);
+
+    world_unlock_sections(world);
 }
 
 static void world_update_shadow_rect(World *world, int x, int y, int width,
@@ -702,16 +980,15 @@ static int world_get_terrain_colour(World *world, int x, int y) {
     return get_byte_plane_coord(world->terrain_colour, x, y);
 }
 
-void world_reset(World *world, int dispose) {
+/* free the terrain, wall and roof models, which mustn't be in a scene */
+static void world_free_models(World *world) {
     for (int i = 0; i < TERRAIN_COUNT; i++) {
-        scene_null_model(world->scene, world->terrain_models[i]);
         game_model_destroy(world->terrain_models[i]);
         free(world->terrain_models[i]);
 
         world->terrain_models[i] = NULL;
 
         for (int j = 0; j < PLANE_COUNT; j++) {
-            scene_null_model(world->scene, world->wall_models[j][i]);
             game_model_destroy(world->wall_models[j][i]);
             free(world->wall_models[j][i]);
 
@@ -719,13 +996,25 @@ void world_reset(World *world, int dispose) {
         }
 
         for (int j = 0; j < PLANE_COUNT; j++) {
-            scene_null_model(world->scene, world->roof_models[j][i]);
             game_model_destroy(world->roof_models[j][i]);
             free(world->roof_models[j][i]);
 
             world->roof_models[j][i] = NULL;
         }
     }
+}
+
+void world_reset(World *world, int dispose) {
+    for (int i = 0; i < TERRAIN_COUNT; i++) {
+        scene_null_model(world->scene, world->terrain_models[i]);
+
+        for (int j = 0; j < PLANE_COUNT; j++) {
+            scene_null_model(world->scene, world->wall_models[j][i]);
+            scene_null_model(world->scene, world->roof_models[j][i]);
+        }
+    }
+
+    world_free_models(world);
 
     if (dispose) {
         /* disable dispose for the login-screen models so we can free them */
@@ -800,21 +1089,148 @@ static void world_set_tile_decoration(World *world, int x, int y,
     world->tile_decoration[height][x * REGION_SIZE + y] = (int8_t)decoration;
 }
 
-int world_route(World *world, int start_x, int start_y, int end_x1, int end_y1,
-                int end_x2, int end_y2, int *route_x, int *route_y,
-                int objects) {
-    for (int x = 0; x < REGION_WIDTH; x++) {
-        for (int y = 0; y < REGION_HEIGHT; y++) {
-            world->route_via[x][y] = 0;
+/* steps world_route tries from each tile, in the order it tries them */
+static const int route_step_x[] = {-1, 1, 0, 0, -1, 1, -1, 1};
+static const int route_step_y[] = {0, 0, -1, 1, -1, -1, 1, 1};
+
+/* object_adjacency changed, so forget routes and components built on it */
+static void world_route_reset(World *world) {
+    world->route_cache_length = 0;
+    world->route_components_valid = 0;
+}
+
+/* whether the player can step from x, y by dx, dy. 0x70 is an object or a
+ * diagonal wall on the tile, the low bits are walls on each side of it */
+static int world_route_can_step(World *world, int x, int y, int dx, int dy) {
+    int to_x = x + dx;
+    int to_y = y + dy;
+
+    if (to_x < 0 || to_y < 0 || to_x >= REGION_WIDTH ||
+        to_y >= REGION_HEIGHT) {
+        return 0;
+    }
+
+    int x_side = dx < 0 ? 8 : (dx > 0 ? 2 : 0);
+    int y_side = dy < 0 ? 4 : (dy > 0 ? 1 : 0);
+
+    if ((world->object_adjacency[to_x][to_y] & (0x70 | x_side | y_side)) !=
+        0) {
+        return 0;
+    }
+
+    if (dx != 0 && dy != 0) {
+        /* can't cut the corner past either of the tiles beside it */
+        return (world->object_adjacency[x][to_y] & (0x70 | y_side)) == 0 &&
+               (world->object_adjacency[to_x][y] & (0x70 | x_side)) == 0;
+    }
+
+    return 1;
+}
+
+/* flood fill the region once after each change to object_adjacency */
+static void world_route_find_components(World *world) {
+    memset(world->route_component, 0, sizeof(world->route_component));
+
+    /* every tile is pushed once */
+    uint16_t *stack = world->route_stack;
+    int component = 0;
+
+    for (int tile = 0; tile < ROUTE_TILE_COUNT; tile++) {
+        if (world->route_component[tile] != 0) {
+            continue;
+        }
+
+        int stack_length = 0;
+
+        world->route_component[tile] = ++component;
+        stack[stack_length++] = tile;
+
+        while (stack_length > 0) {
+            int from = stack[--stack_length];
+            int x = from / REGION_HEIGHT;
+            int y = from % REGION_HEIGHT;
+
+            for (int i = 0; i < 8; i++) {
+                int dx = route_step_x[i];
+                int dy = route_step_y[i];
+                int to_x = x + dx;
+                int to_y = y + dy;
+
+                if (to_x < 0 || to_y < 0 || to_x >= REGION_WIDTH ||
+                    to_y >= REGION_HEIGHT) {
+                    continue;
+                }
+
+                int to = to_x * REGION_HEIGHT + to_y;
+
+                if (world->route_component[to] != 0) {
+                    continue;
+                }
+
+                if (world_route_can_step(world, x, y, dx, dy) ||
+                    world_route_can_step(world, to_x, to_y, -dx, -dy)) {
+                    world->route_component[to] = component;
+                    stack[stack_length++] = to;
+                }
+            }
+        }
+    }
+
+    world->route_components_valid = 1;
+}
+
+/* false when no tile the route could finish on is connected to the start.
+ * with objects the end can be reached from the tiles around it */
+static int world_route_is_reachable(World *world, int start_x, int start_y,
+                                    int end_x1, int end_y1, int end_x2,
+                                    int end_y2, int objects) {
+    if (!world->route_components_valid) {
+        world_route_find_components(world);
+    }
+
+    int component = world->route_component[start_x * REGION_HEIGHT + start_y];
+    int margin = objects ? 1 : 0;
+
+    int min_x = end_x1 - margin < 0 ? 0 : end_x1 - margin;
+    int min_y = end_y1 - margin < 0 ? 0 : end_y1 - margin;
+
+    int max_x = end_x2 + margin >= REGION_WIDTH ? REGION_WIDTH - 1
+                                                : end_x2 + margin;
+
+    int max_y = end_y2 + margin >= REGION_HEIGHT ? REGION_HEIGHT - 1
+                                                 : end_y2 + margin;
+
+    for (int x = min_x; x <= max_x; x++) {
+        for (int y = min_y; y <= max_y; y++) {
+            if (world->route_component[x * REGION_HEIGHT + y] == component) {
+                return 1;
+            }
         }
     }
 
+    return 0;
+}
+
+/* breadth first from the start until a tile that reaches the end comes off
+ * the queue, then the route is walked back into waypoints where it turns.
+ * route_x and route_y double as the queue */
+static int world_route_search(World *world, int start_x, int start_y,
+                              int end_x1, int end_y1, int end_x2, int end_y2,
+                              int *route_x, int *route_y, int objects) {
+    if (++world->route_generation > 0xffff) {
+        memset(world->route_visited, 0, sizeof(world->route_visited));
+        world->route_generation = 1;
+    }
+
+    int generation = world->route_generation;
+
     int write_ptr = 0;
     int read_ptr = 0;
     int x = start_x;
     int y = start_y;
 
     world->route_via[start_x][start_y] = 99;
+    world->route_visited[start_x][start_y] = generation;
     route_x[write_ptr] = start_x;
     route_y[write_ptr++] = start_y;
 
@@ -859,79 +1275,89 @@ int world_route(World *world, int start_x, int start_y, int end_x1, int end_y1,
             }
         }
 
-        if (x > 0 && world->route_via[x - 1][y] == 0 &&
+        if (x > 0 && world->route_visited[x - 1][y] != generation &&
             (world->object_adjacency[x - 1][y] & 0x78) == 0) {
             route_x[write_ptr] = x - 1;
             route_y[write_ptr] = y;
             write_ptr = (write_ptr + 1) % PATH_STEPS_MAX;
             world->route_via[x - 1][y] = 2;
+            world->route_visited[x - 1][y] = generation;
         }
 
-        if (x < (REGION_WIDTH - 1) && world->route_via[x + 1][y] == 0 &&
+        if (x < (REGION_WIDTH - 1) &&
+            world->route_visited[x + 1][y] != generation &&
             (world->object_adjacency[x + 1][y] & 0x72) == 0) {
             route_x[write_ptr] = x + 1;
             route_y[write_ptr] = y;
             write_ptr = (write_ptr + 1) % PATH_STEPS_MAX;
             world->route_via[x + 1][y] = 8;
+            world->route_visited[x + 1][y] = generation;
         }
 
-        if (y > 0 && world->route_via[x][y - 1] == 0 &&
+        if (y > 0 && world->route_visited[x][y - 1] != generation &&
             (world->object_adjacency[x][y - 1] & 0x74) == 0) {
             route_x[write_ptr] = x;
             route_y[write_ptr] = y - 1;
             write_ptr = (write_ptr + 1) % PATH_STEPS_MAX;
             world->route_via[x][y - 1] = 1;
+            world->route_visited[x][y - 1] = generation;
         }
 
-        if (y < (REGION_HEIGHT - 1) && world->route_via[x][y + 1] == 0 &&
+        if (y < (REGION_HEIGHT - 1) &&
+            world->route_visited[x][y + 1] != generation &&
             (world->object_adjacency[x][y + 1] & 0x71) == 0) {
             route_x[write_ptr] = x;
             route_y[write_ptr] = y + 1;
             write_ptr = (write_ptr + 1) % PATH_STEPS_MAX;
             world->route_via[x][y + 1] = 4;
+            world->route_visited[x][y + 1] = generation;
         }
 
         if (x > 0 && y > 0 && (world->object_adjacency[x][y - 1] & 0x74) == 0 &&
             (world->object_adjacency[x - 1][y] & 0x78) == 0 &&
             (world->object_adjacency[x - 1][y - 1] & 0x7c) == 0 &&
-            world->route_via[x - 1][y - 1] == 0) {
+            world->route_visited[x - 1][y - 1] != generation) {
             route_x[write_ptr] = x - 1;
             route_y[write_ptr] = y - 1;
             write_ptr = (write_ptr + 1) % PATH_STEPS_MAX;
             world->route_via[x - 1][y - 1] = 3;
+            world->route_visited[x - 1][y - 1] = generation;
         }
 
         if (x < (REGION_WIDTH - 1) && y > 0 &&
             (world->object_adjacency[x][y - 1] & 0x74) == 0 &&
             (world->object_adjacency[x + 1][y] & 0x72) == 0 &&
             (world->object_adjacency[x + 1][y - 1] & 0x76) == 0 &&
-            world->route_via[x + 1][y - 1] == 0) {
+            world->route_visited[x + 1][y - 1] != generation) {
             route_x[write_ptr] = x + 1;
             route_y[write_ptr] = y - 1;
             write_ptr = (write_ptr + 1) % PATH_STEPS_MAX;
             world->route_via[x + 1][y - 1] = 9;
+            world->route_visited[x + 1][y - 1] = generation;
         }
 
         if (x > 0 && y < (REGION_HEIGHT - 1) &&
             (world->object_adjacency[x][y + 1] & 0x71) == 0 &&
             (world->object_adjacency[x - 1][y] & 0x78) == 0 &&
             (world->object_adjacency[x - 1][y + 1] & 0x79) == 0 &&
-            world->route_via[x - 1][y + 1] == 0) {
+            world->route_visited[x - 1][y + 1] != generation) {
             route_x[write_ptr] = x - 1;
             route_y[write_ptr] = y + 1;
             write_ptr = (write_ptr + 1) % PATH_STEPS_MAX;
             world->route_via[x - 1][y + 1] = 6;
+            world->route_visited[x - 1][y + 1] = generation;
         }
 
         if (x < (REGION_WIDTH - 1) && y < (REGION_HEIGHT - 1) &&
             (world->object_adjacency[x][y + 1] & 0x71) == 0 &&
             (world->object_adjacency[x + 1][y] & 0x72) == 0 &&
             (world->object_adjacency[x + 1][y + 1] & 0x73) == 0 &&
-            world->route_via[x + 1][y + 1] == 0) {
+            world->route_visited[x + 1][y + 1] != generation) {
             route_x[write_ptr] = x + 1;
             route_y[write_ptr] = y + 1;
             write_ptr = (write_ptr + 1) % PATH_STEPS_MAX;
             world->route_via[x + 1][y + 1] = 12;
+            world->route_visited[x + 1][y + 1] = generation;
         }
     }
 
@@ -968,6 +1394,82 @@ int world_route(World *world, int start_x, int start_y, int end_x1, int end_y1,
     return read_ptr;
 }
 
+static WorldRoute *world_route_find_cached(World *world, int start_x,
+                                           int start_y, int end_x1, int end_y1,
+                                           int end_x2, int end_y2,
+                                           int objects) {
+    for (int i = 0; i < world->route_cache_length; i++) {
+        WorldRoute *route = &world->route_cache[i];
+
+        if (route->start_x == start_x && route->start_y == start_y &&
+            route->end_x1 == end_x1 && route->end_y1 == end_y1 &&
+            route->end_x2 == end_x2 && route->end_y2 == end_y2 &&
+            route->objects == objects) {
+            return route;
+        }
+    }
+
+    return NULL;
+}
+
+/* route from start to the nearest tile within end_x1, end_y1 to end_x2,
+ * end_y2, or to a tile beside it with objects set. fills route_x and
+ * route_y with waypoints from the end back to the start and returns how
+ * many there are, or -1 if the end can't be reached */
+int world_route(World *world, int start_x, int start_y, int end_x1, int end_y1,
+                int end_x2, int end_y2, int *route_x, int *route_y,
+                int objects) {
+    objects = objects != 0;
+
+    WorldRoute *cached = world_route_find_cached(
+        world, start_x, start_y, end_x1, end_y1, end_x2, end_y2, objects);
+
+    if (cached != NULL) {
+        for (int i = 0; i < cached->length; i++) {
+            route_x[i] = cached->route_x[i];
+            route_y[i] = cached->route_y[i];
+        }
+
+        return cached->length;
+    }
+
+    int length = -1;
+
+    if (world_route_is_reachable(world, start_x, start_y, end_x1, end_y1,
+                                 end_x2, end_y2, objects)) {
+        length = world_route_search(world, start_x, start_y, end_x1, end_y1,
+                                    end_x2, end_y2, route_x, route_y, objects);
+    }
+
+    if (length > ROUTE_CACHE_STEPS) {
+        return length;
+    }
+
+    WorldRoute *route = &world->route_cache[world->route_cache_next];
+
+    world->route_cache_next = (world->route_cache_next + 1) % ROUTE_CACHE_SIZE;
+
+    if (world->route_cache_length < ROUTE_CACHE_SIZE) {
+        world->route_cache_length++;
+    }
+
+    route->start_x = start_x;
+    route->start_y = start_y;
+    route->end_x1 = end_x1;
+    route->end_y1 = end_y1;
+    route->end_x2 = end_x2;
+    route->end_y2 = end_y2;
+    route->objects = objects;
+    route->length = length;
+
+    for (int i = 0; i < length; i++) {
+        route->route_x[i] = route_x[i];
+        route->route_y[i] = route_y[i];
+    }
+
+    return length;
+}
+
 void world_register_wall_object(World *world, int x, int y, int dir, int id) {
     if (x < 0 || y < 0 || x >= 95 || y >= 95) {
         return;
@@ -993,10 +1495,27 @@ void world_register_wall_object(World *world, int x, int y, int dir, int id) {
         }
 
         world_update_shadow_rect(world, x, y, 1, 1);
+        world_route_reset(world);
     }
 }
 
 /* assemble a 3D model from world section */
+/* start an empty model to build terrain, walls or roofs in */
+static void world_new_parent_model(World *world) {
+    if (world->parent_model == NULL) {
+        world->parent_model = malloc(sizeof(GameModel));
+    } else {
+        game_model_destroy(world->parent_model);
+    }
+
+    game_model_new_alloc_flags(world->parent_model, TERRAIN_MAX_VERTICES,
+                               TERRAIN_MAX_FACES, 1, 1, 0, 0, 1);
+
+    if (world->is_prefetch_region) {
+        world->parent_model->light_scratch = &world->light_scratch;
+    }
+}
+
 static void world_load_assemble(World *world, int x, int y, int plane,
                                 int is_current_plane) {
     int section_x = (x + (REGION_SIZE / 2)) / REGION_SIZE;
@@ -1009,19 +1528,12 @@ static void world_load_assemble(World *world, int x, int y, int plane,
 
     world_fill_edges(world);
 
-    if (world->parent_model == NULL) {
-        world->parent_model = malloc(sizeof(GameModel));
-    } else {
-        game_model_destroy(world->parent_model);
-    }
-
-    game_model_new_alloc_flags(world->parent_model, TERRAIN_MAX_VERTICES,
-                               TERRAIN_MAX_FACES, 1, 1, 0, 0, 1);
+    world_new_parent_model(world);
 
     /* create terrain */
 
     if (is_current_plane) {
-        surface_black_screen(world->surface);
+        world->map_op_count = 0;
 
         for (int r_x = 0; r_x < REGION_WIDTH; r_x++) {
             for (int r_y = 0; r_y < REGION_HEIGHT; r_y++) {
@@ -1029,12 +1541,12 @@ static void world_load_assemble(World *world, int x, int y, int plane,
             }
         }
 
-        GameModel *game_model = world->parent_model;
+        world_new_parent_model(world);
 
-        game_model_destroy(game_model);
+        GameModel *game_model = world->parent_model;
 
-        game_model_new_alloc_flags(game_model, TERRAIN_MAX_VERTICES,
-                                   TERRAIN_MAX_FACES, 1, 1, 0, 0, 1);
+        /* every tile corner is shared by up to 4 tiles */
+        game_model_vertex_hash_begin(game_model);
 
         for (int r_x = 0; r_x < REGION_WIDTH; r_x++) {
             for (int r_y = 0; r_y < REGION_HEIGHT; r_y++) {
@@ -1207,8 +1719,8 @@ static void world_load_assemble(World *world, int x, int y, int plane,
                     }
                 }
 
-                world_draw_map_tile(world, r_x, r_y, direction, colour,
-                                    colour_1);
+                world_record_map(world, WORLD_MAP_TILE, r_x, r_y, direction,
+                                 colour, colour_1);
 
                 int i17 = world_get_terrain_height(world, r_x + 1, r_y + 1) -
                           world_get_terrain_height(world, r_x + 1, r_y) +
@@ -1352,8 +1864,8 @@ static void world_load_assemble(World *world, int x, int y, int plane,
 
                     game_model->face_tag[tile_face] = TILE_FACE_TAG + tile_face;
 
-                    world_draw_map_tile(world, r_x, r_y, 0, fill_front,
-                                        fill_front);
+                    world_record_map(world, WORLD_MAP_TILE, r_x, r_y, 0,
+                                     fill_front, fill_front);
                 } else if (decoration == 0 ||
                            game_data.tiles[decoration - 1].type !=
                                LIQUID_TILE_TYPE) {
@@ -1398,8 +1910,8 @@ static void world_load_assemble(World *world, int x, int y, int plane,
                         game_model->face_tag[tile_face] =
                             TILE_FACE_TAG + tile_face;
 
-                        world_draw_map_tile(world, r_x, r_y, 0, fill_front,
-                                            fill_front);
+                        world_record_map(world, WORLD_MAP_TILE, r_x, r_y, 0,
+                                         fill_front, fill_front);
                     }
 
                     int decoration_north =
@@ -1446,8 +1958,8 @@ static void world_load_assemble(World *world, int x, int y, int plane,
                         game_model->face_tag[tile_face] =
                             TILE_FACE_TAG + tile_face;
 
-                        world_draw_map_tile(world, r_x, r_y, 0, fill_front,
-                                            fill_front);
+                        world_record_map(world, WORLD_MAP_TILE, r_x, r_y, 0,
+                                         fill_front, fill_front);
                     }
 
                     int decoration_east =
@@ -1491,8 +2003,8 @@ static void world_load_assemble(World *world, int x, int y, int plane,
                         game_model->face_tag[tile_face] =
                             TILE_FACE_TAG + tile_face;
 
-                        world_draw_map_tile(world, r_x, r_y, 0, fill_front,
-                                            fill_front);
+                        world_record_map(world, WORLD_MAP_TILE, r_x, r_y, 0,
+                                         fill_front, fill_front);
                     }
 
                     int decoration_west =
@@ -1536,8 +2048,8 @@ static void world_load_assemble(World *world, int x, int y, int plane,
                         game_model->face_tag[tile_face] =
                             TILE_FACE_TAG + tile_face;
 
-                        world_draw_map_tile(world, r_x, r_y, 0, fill_front,
-                                            fill_front);
+                        world_record_map(world, WORLD_MAP_TILE, r_x, r_y, 0,
+                                         fill_front, fill_front);
                     }
                 }
             }
@@ -1548,14 +2060,7 @@ static void world_load_assemble(World *world, int x, int y, int plane,
         game_model_split(world->parent_model, world->terrain_models, 1536, 1536,
                          8, 64, 233, 0);
 
-        for (int i = 0; i < TERRAIN_COUNT; i++) {
-            scene_add_model(world->scene, world->terrain_models[i]);
-
-#if defined(RENDER_GL) || defined(RENDER_3DS_GL)
-            world->gl_world_models_buffer[world->gl_world_models_offset++] =
-                world->terrain_models[i];
-#endif
-        }
+        game_model_vertex_hash_end(world->parent_model);
 
         for (int r_x = 0; r_x < REGION_WIDTH; r_x++) {
             for (int r_y = 0; r_y < REGION_HEIGHT; r_y++) {
@@ -1565,9 +2070,8 @@ static void world_load_assemble(World *world, int x, int y, int plane,
         }
     }
 
-    game_model_destroy(world->parent_model);
-    game_model_new_alloc_flags(world->parent_model, TERRAIN_MAX_VERTICES,
-                               TERRAIN_MAX_FACES, 1, 1, 0, 0, 1);
+    world_new_parent_model(world);
+    game_model_vertex_hash_begin(world->parent_model);
 
     int colour = 0x606060;
 
@@ -1591,8 +2095,8 @@ static void world_load_assemble(World *world, int x, int y, int plane,
                 }
 
                 if (is_current_plane) {
-                    world_map_line_horizontal(world, r_x * 3, r_y * 3, 3,
-                                              colour);
+                    world_record_map(world, WORLD_MAP_LINE_HORIZONTAL,
+                                     r_x * 3, r_y * 3, 3, colour, 0);
                 }
             }
 
@@ -1612,7 +2116,8 @@ static void world_load_assemble(World *world, int x, int y, int plane,
                 }
 
                 if (is_current_plane) {
-                    world_map_line_vertical(world, r_x * 3, r_y * 3, 3, colour);
+                    world_record_map(world, WORLD_MAP_LINE_VERTICAL, r_x * 3,
+                                     r_y * 3, 3, colour, 0);
                 }
             }
 
@@ -1629,13 +2134,14 @@ static void world_load_assemble(World *world, int x, int y, int plane,
                 }
 
                 if (is_current_plane) {
-                    world_map_set_pixel(world, r_x * 3, r_y * 3, colour);
+                    world_record_map(world, WORLD_MAP_PIXEL, r_x * 3, r_y * 3,
+                                     0, colour, 0);
 
-                    world_map_set_pixel(world, r_x * 3 + 1, r_y * 3 + 1,
-                                        colour);
+                    world_record_map(world, WORLD_MAP_PIXEL, r_x * 3 + 1,
+                                     r_y * 3 + 1, 0, colour, 0);
 
-                    world_map_set_pixel(world, r_x * 3 + 2, r_y * 3 + 2,
-                                        colour);
+                    world_record_map(world, WORLD_MAP_PIXEL, r_x * 3 + 2,
+                                     r_y * 3 + 2, 0, colour, 0);
                 }
             } else if (wall > 12000 && wall < 24000 &&
                        game_data.wall_objects[wall - 12001].interactive == 0) {
@@ -1648,47 +2154,30 @@ static void world_load_assemble(World *world, int x, int y, int plane,
                 }
 
                 if (is_current_plane) {
-                    world_map_set_pixel(world, r_x * 3 + 2, r_y * 3, colour);
+                    world_record_map(world, WORLD_MAP_PIXEL, r_x * 3 + 2,
+                                     r_y * 3, 0, colour, 0);
 
-                    world_map_set_pixel(world, r_x * 3 + 1, r_y * 3 + 1,
-                                        colour);
+                    world_record_map(world, WORLD_MAP_PIXEL, r_x * 3 + 1,
+                                     r_y * 3 + 1, 0, colour, 0);
 
-                    world_map_set_pixel(world, r_x * 3, r_y * 3 + 2, colour);
+                    world_record_map(world, WORLD_MAP_PIXEL, r_x * 3,
+                                     r_y * 3 + 2, 0, colour, 0);
                 }
             }
         }
     }
 
-    if (is_current_plane) {
-#ifdef RENDER_GL
-        surface_gl_update_dynamic_texture(world->surface);
-#endif
-
-        surface_draw_sprite_reversed(
-            world->surface, world->base_media_sprite - 1, 0, 0,
-            MINIMAP_SPRITE_WIDTH, MINIMAP_SPRITE_WIDTH);
-    }
-
     game_model_set_light(world->parent_model, 0, 60, 24, -50, -10, -50);
 
     // TODO thick walls needs more faces/vertices
     game_model_split(world->parent_model, world->wall_models[plane], 1536, 1536,
                      8, 64, 338, 1);
 
+    game_model_vertex_hash_end(world->parent_model);
+
     /*game_model_split(world->parent_model, world->wall_models[plane], 1536,
        1536, 8, 64, 338 + 100, 1);*/
 
-    /* add walls */
-
-    for (int i = 0; i < TERRAIN_COUNT; i++) {
-        scene_add_model(world->scene, world->wall_models[plane][i]);
-
-#if defined(RENDER_GL) || defined(RENDER_3DS_GL)
-        world->gl_world_models_buffer[world->gl_world_models_offset++] =
-            world->wall_models[plane][i];
-#endif
-    }
-
     for (int r_x = 0; r_x < REGION_WIDTH - 1; r_x++) {
         for (int r_y = 0; r_y < REGION_HEIGHT - 1; r_y++) {
             int wall_object_id = world_get_wall_east_west(world, r_x, r_y);
@@ -1803,10 +2292,9 @@ static void world_load_assemble(World *world, int x, int y, int plane,
         }
     }
 
-    game_model_destroy(world->parent_model);
+    world_new_parent_model(world);
 
-    game_model_new_alloc_flags(world->parent_model, TERRAIN_MAX_VERTICES,
-                               TERRAIN_MAX_FACES, 1, 1, 0, 0, 1);
+    game_model_vertex_hash_begin(world->parent_model);
 
     for (int r_x = 1; r_x < REGION_WIDTH - 1; r_x++) {
         for (int r_y = 1; r_y < REGION_HEIGHT - 1; r_y++) {
@@ -2162,14 +2650,7 @@ static void world_load_assemble(World *world, int x, int y, int plane,
     game_model_split(world->parent_model, world->roof_models[plane], 1536, 1536,
                      8, 64, 169, 1);
 
-    for (int i = 0; i < TERRAIN_COUNT; i++) {
-        scene_add_model(world->scene, world->roof_models[plane][i]);
-
-#if defined(RENDER_GL) || defined(RENDER_3DS_GL)
-        world->gl_world_models_buffer[world->gl_world_models_offset++] =
-            world->roof_models[plane][i];
-#endif
-    }
+    game_model_vertex_hash_end(world->parent_model);
 
     for (int r_x = 0; r_x < REGION_WIDTH; r_x++) {
         for (int r_y = 0; r_y < REGION_HEIGHT; r_y++) {
@@ -2376,22 +2857,13 @@ static int world_get_terrain_height(World *world, int x, int y) {
     return (get_byte_plane_coord(world->terrain_height, x, y) & 0xff) * 3;
 }
 
-void world_load_section(World *world, int x, int y, int plane) {
-    world_reset(world, 1);
-
+/* build the terrain, wall and roof models and the minimap of a region
+ * without adding anything to the scene, so it can be done off the main
+ * thread */
+static void world_build_region(World *world, int x, int y, int plane) {
     int section_x = (x + (REGION_SIZE / 2)) / REGION_SIZE;
     int section_y = (y + (REGION_SIZE / 2)) / REGION_SIZE;
 
-#if defined(RENDER_GL) || defined(RENDER_3DS_GL)
-    int max_models = (TERRAIN_COUNT * 3);
-
-    if (plane == 0) {
-        max_models *= 3;
-    }
-
-    world_gl_create_world_models_buffer(world, max_models);
-#endif
-
     world_load_assemble(world, x, y, plane, 1);
 
     if (plane == 0) {
@@ -2412,6 +2884,389 @@ void world_load_section(World *world, int x, int y, int plane) {
     world->parent_model = NULL;
 }
 
+#ifdef WORLD_PREFETCH_THREADED
+/* move the models and tiles of the region the prefetch thread built into the
+ * world if it's the one being loaded, waiting for it if it's still being
+ * built. returns 0 if it has to be built here instead */
+static int world_take_prefetch_region(World *world, int section_x,
+                                      int section_y, int plane) {
+    World *region = world->prefetch_region;
+
+    if (region == NULL) {
+        return 0;
+    }
+
+    SDL_LockMutex(world->prefetch_lock);
+
+    int is_loading = world->prefetch_region_x == section_x &&
+                     world->prefetch_region_y == section_y &&
+                     world->prefetch_region_plane == plane;
+
+    while (is_loading &&
+           world->prefetch_region_state == WORLD_SECTION_DECODING) {
+        SDL_CondWait(world->prefetch_done, world->prefetch_lock);
+    }
+
+    if (!is_loading || world->prefetch_region_state != WORLD_SECTION_READY) {
+        /* building it here is quicker than waiting for the thread to start */
+        if (is_loading) {
+            world->prefetch_region_state = WORLD_SECTION_EMPTY;
+        }
+
+        SDL_UnlockMutex(world->prefetch_lock);
+        return 0;
+    }
+
+    memcpy(world->terrain_height, region->terrain_height,
+           sizeof(world->terrain_height));
+
+    memcpy(world->terrain_colour, region->terrain_colour,
+           sizeof(world->terrain_colour));
+
+    memcpy(world->walls_north_south, region->walls_north_south,
+           sizeof(world->walls_north_south));
+
+    memcpy(world->walls_east_west, region->walls_east_west,
+           sizeof(world->walls_east_west));
+
+    memcpy(world->walls_diagonal, region->walls_diagonal,
+           sizeof(world->walls_diagonal));
+
+    memcpy(world->walls_roof, region->walls_roof, sizeof(world->walls_roof));
+
+    memcpy(world->tile_decoration, region->tile_decoration,
+           sizeof(world->tile_decoration));
+
+    memcpy(world->tile_direction, region->tile_direction,
+           sizeof(world->tile_direction));
+
+    memcpy(world->object_adjacency, region->object_adjacency,
+           sizeof(world->object_adjacency));
+
+    memcpy(world->terrain_height_local, region->terrain_height_local,
+           sizeof(world->terrain_height_local));
+
+    memcpy(world->local_x, region->local_x, sizeof(world->local_x));
+    memcpy(world->local_y, region->local_y, sizeof(world->local_y));
+
+    for (int i = 0; i < TERRAIN_COUNT; i++) {
+        world->terrain_models[i] = region->terrain_models[i];
+        region->terrain_models[i] = NULL;
+
+        for (int j = 0; j < PLANE_COUNT; j++) {
+            world->wall_models[j][i] = region->wall_models[j][i];
+            region->wall_models[j][i] = NULL;
+
+            world->roof_models[j][i] = region->roof_models[j][i];
+            region->roof_models[j][i] = NULL;
+        }
+    }
+
+    WorldMapOp *map_ops = world->map_ops;
+    int map_op_length = world->map_op_length;
+
+    world->map_ops = region->map_ops;
+    world->map_op_count = region->map_op_count;
+    world->map_op_length = region->map_op_length;
+
+    region->map_ops = map_ops;
+    region->map_op_count = 0;
+    region->map_op_length = map_op_length;
+
+    world->prefetch_region_state = WORLD_SECTION_EMPTY;
+
+    SDL_UnlockMutex(world->prefetch_lock);
+
+    return 1;
+}
+#endif
+
+/* add one plane's walls and roofs to the scene, in the order they were built
+ * before being moved off the main thread */
+static void world_add_plane_models(World *world, int plane, int with_terrain) {
+    if (with_terrain) {
+        for (int i = 0; i < TERRAIN_COUNT; i++) {
+            scene_add_model(world->scene, world->terrain_models[i]);
+
+#if defined(RENDER_GL) || defined(RENDER_3DS_GL)
+            world->gl_world_models_buffer[world->gl_world_models_offset++] =
+                world->terrain_models[i];
+#endif
+        }
+    }
+
+    for (int i = 0; i < TERRAIN_COUNT; i++) {
+        scene_add_model(world->scene, world->wall_models[plane][i]);
+
+#if defined(RENDER_GL) || defined(RENDER_3DS_GL)
+        world->gl_world_models_buffer[world->gl_world_models_offset++] =
+            world->wall_models[plane][i];
+#endif
+    }
+
+    for (int i = 0; i < TERRAIN_COUNT; i++) {
+        scene_add_model(world->scene, world->roof_models[plane][i]);
+
+#if defined(RENDER_GL) || defined(RENDER_3DS_GL)
+        world->gl_world_models_buffer[world->gl_world_models_offset++] =
+            world->roof_models[plane][i];
+#endif
+    }
+}
+
+void world_load_section(World *world, int x, int y, int plane) {
+    world_reset(world, 1);
+    world_route_reset(world);
+
+    /* sections used by this load aren't replaced until the next one */
+    world->section_stamp++;
+
+#if defined(RENDER_GL) || defined(RENDER_3DS_GL)
+    int max_models = (TERRAIN_COUNT * 3);
+
+    if (plane == 0) {
+        max_models *= 3;
+    }
+
+    world_gl_create_world_models_buffer(world, max_models);
+#endif
+
+    int section_x = (x + (REGION_SIZE / 2)) / REGION_SIZE;
+    int section_y = (y + (REGION_SIZE / 2)) / REGION_SIZE;
+
+    world->prefetch_section_x = section_x;
+    world->prefetch_section_y = section_y;
+
+#ifdef WORLD_PREFETCH_THREADED
+    if (!world_take_prefetch_region(world, section_x, section_y, plane)) {
+        world_build_region(world, x, y, plane);
+    }
+#else
+    world_build_region(world, x, y, plane);
+#endif
+
+    world_add_plane_models(world, plane, 1);
+
+    if (plane == 0) {
+        world_add_plane_models(world, 1, 0);
+        world_add_plane_models(world, 2, 0);
+    }
+
+    world_draw_map(world);
+}
+
+/* keep up to size_kb of decoded sections so walking back and forth across a
+ * region boundary doesn't decode the same map files again */
+void world_set_section_cache(World *world, int size_kb) {
+    if (world->sections != NULL || world->prefetching) {
+        return;
+    }
+
+    int section_count = (size_kb * 1024) / (int)sizeof(WorldSection);
+
+    if (section_count <= 0) {
+        return;
+    }
+
+    world->sections = calloc(section_count, sizeof(WorldSection));
+
+    if (world->sections == NULL) {
+        mud_error("unable to allocate %d map sections\n", section_count);
+        return;
+    }
+
+    world->section_count = section_count;
+}
+
+/* start a thread which decodes the sections of the next region into the
+ * section cache while the player walks towards it, then builds its models
+ * for world_load_section to take. it lasts as long as the world */
+void world_set_prefetch(World *world, int enabled) {
+#ifdef WORLD_PREFETCH_THREADED
+    if (world->prefetching || world->sections == NULL || !enabled) {
+        return;
+    }
+
+    world->prefetch_lock = SDL_CreateMutex();
+    world->prefetch_queued = SDL_CreateCond();
+    world->prefetch_done = SDL_CreateCond();
+
+    /* the next region is built in a world of its own, reading from this
+     * one's sections */
+    World *region = calloc(1, sizeof(World));
+
+    if (region != NULL) {
+        region->landscape_pack = world->landscape_pack;
+        region->map_pack = world->map_pack;
+        region->member_landscape_pack = world->member_landscape_pack;
+        region->member_map_pack = world->member_map_pack;
+        region->thick_walls = world->thick_walls;
+        region->sections = world->sections;
+        region->section_count = world->section_count;
+        region->prefetching = 1;
+        region->prefetch_lock = world->prefetch_lock;
+        region->prefetch_queued = world->prefetch_queued;
+        region->prefetch_done = world->prefetch_done;
+        region->is_prefetch_region = 1;
+    }
+
+    world->prefetch_region = region;
+
+#ifdef SDL12
+    SDL_Thread *thread = SDL_CreateThread(world_prefetch_thread, world);
+#else
+    SDL_Thread *thread =
+        SDL_CreateThread(world_prefetch_thread, "world_prefetch", world);
+#endif
+
+    if (thread == NULL) {
+        mud_error("unable to create prefetch thread: %s\n", SDL_GetError());
+
+        SDL_DestroyCond(world->prefetch_done);
+        SDL_DestroyCond(world->prefetch_queued);
+        SDL_DestroyMutex(world->prefetch_lock);
+
+        free(world->prefetch_region);
+        world->prefetch_region = NULL;
+
+        world->prefetch_done = NULL;
+        world->prefetch_queued = NULL;
+        world->prefetch_lock = NULL;
+        return;
+    }
+
+    world->prefetching = 1;
+#else
+    (void)world;
+    (void)enabled;
+#endif
+}
+
+/* called with the player's position (in the same coordinates as
+ * world_load_section) whenever it changes. the direction they've been
+ * walking in predicts the next region to load */
+void world_prefetch(World *world, int x, int y, int plane) {
+#ifdef WORLD_PREFETCH_THREADED
+    if (!world->prefetching) {
+        return;
+    }
+
+    int delta_x = x - world->prefetch_x;
+    int delta_y = y - world->prefetch_y;
+
+    world->prefetch_x = x;
+    world->prefetch_y = y;
+
+    /* teleports and plane changes aren't a direction */
+    if (abs(delta_x) > 8 || abs(delta_y) > 8) {
+        world->prefetch_heading_x = 0;
+        world->prefetch_heading_y = 0;
+        return;
+    }
+
+    if (delta_x != 0 || delta_y != 0) {
+        world->prefetch_heading_x = (delta_x > 0) - (delta_x < 0);
+        world->prefetch_heading_y = (delta_y > 0) - (delta_y < 0);
+    }
+
+    if (world->prefetch_heading_x == 0 && world->prefetch_heading_y == 0) {
+        return;
+    }
+
+    int heading_x = world->prefetch_heading_x;
+    int heading_y = world->prefetch_heading_y;
+    int section_x = world->prefetch_section_x;
+    int section_y = world->prefetch_section_y;
+
+    /* mudclient loads the next region 32 tiles from the centre of this one,
+     * so it's the neighbour across whichever edge is reached first */
+    int distance_x = 32 - (x - section_x * REGION_SIZE) * heading_x;
+    int distance_y = 32 - (y - section_y * REGION_SIZE) * heading_y;
+
+    if (heading_y == 0 || distance_x <= distance_y) {
+        section_x += heading_x;
+    }
+
+    if (heading_x == 0 || distance_y <= distance_x) {
+        section_y += heading_y;
+    }
+
+    /* the same sections world_load_section reads, current plane first */
+    int last_plane = plane == 0 ? 2 : plane;
+
+    SDL_LockMutex(world->prefetch_lock);
+
+    world->section_stamp++;
+
+    for (int i = plane; i <= last_plane; i++) {
+        world_prefetch_queue(world, section_x - 1, section_y - 1, i);
+        world_prefetch_queue(world, section_x, section_y - 1, i);
+        world_prefetch_queue(world, section_x - 1, section_y, i);
+        world_prefetch_queue(world, section_x, section_y, i);
+    }
+
+    /* then the models, once those are decoded. one being built for another
+     * region is left to finish, and a later call queues this one */
+    int is_queued = world->prefetch_region_state != WORLD_SECTION_EMPTY &&
+                    world->prefetch_region_x == section_x &&
+                    world->prefetch_region_y == section_y &&
+                    world->prefetch_region_plane == plane;
+
+    if (world->prefetch_region != NULL && !is_queued &&
+        world->prefetch_region_state != WORLD_SECTION_DECODING) {
+        world->prefetch_region_x = section_x;
+        world->prefetch_region_y = section_y;
+        world->prefetch_region_plane = plane;
+        world->prefetch_region_state = WORLD_SECTION_QUEUED;
+
+        SDL_CondSignal(world->prefetch_queued);
+    }
+
+    SDL_UnlockMutex(world->prefetch_lock);
+#else
+    (void)world;
+    (void)x;
+    (void)y;
+    (void)plane;
+#endif
+}
+
+/* whether the region for this position has already been built, or every
+ * section world_load_section needs for it has been decoded */
+int world_is_prefetched(World *world, int x, int y, int plane) {
+    int section_x = (x + (REGION_SIZE / 2)) / REGION_SIZE;
+    int section_y = (y + (REGION_SIZE / 2)) / REGION_SIZE;
+    int last_plane = plane == 0 ? 2 : plane;
+    int prefetched = world->sections != NULL;
+
+    world_lock_sections(world);
+
+    if (world->prefetch_region != NULL &&
+        world->prefetch_region_state == WORLD_SECTION_READY &&
+        world->prefetch_region_x == section_x &&
+        world->prefetch_region_y == section_y &&
+        world->prefetch_region_plane == plane) {
+        world_unlock_sections(world);
+        return 1;
+    }
+
+    for (int i = plane; i <= last_plane && prefetched; i++) {
+        for (int j = 0; j < 4; j++) {
+            WorldSection *section = world_find_section(
+                world, section_x - 1 + (j & 1), section_y - 1 + (j >> 1), i);
+
+            if (section == NULL || section->state != WORLD_SECTION_READY) {
+                prefetched = 0;
+                break;
+            }
+        }
+    }
+
+    world_unlock_sections(world);
+
+    return prefetched;
+}
+
 static void world_vertex_shadow(World *world, int vertex_x, int vertex_z,
                                 int ambience) {
     int terrain_x = vertex_x / 12;
@@ -2488,6 +3343,7 @@ void world_remove_object(World *world, int x, int y, int id) {
         }
 
         world_update_shadow_rect(world, x, y, width, height);
+        world_route_reset(world);
     }
 }
 
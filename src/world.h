@@ -20,6 +20,10 @@
 #include <cglm/cglm.h>
 #endif
 
+#if !defined(WII) && !defined(_3DS) && !defined(EMSCRIPTEN)
+#define WORLD_PREFETCH_THREADED
+#endif
+
 typedef struct World World;
 
 #include "mudclient.h"
@@ -59,6 +63,79 @@ typedef enum TILE_TIPE {
 /* https://github.com/2003scape/rsc-config/blob/master/config-json/tiles.json */
 #define BRIDGE_TILE_DECORATION 12
 
+typedef enum {
+    WORLD_SECTION_EMPTY = 0,
+    WORLD_SECTION_QUEUED = 1,
+    WORLD_SECTION_DECODING = 2,
+    WORLD_SECTION_READY = 3
+} WORLD_SECTION_STATE;
+
+#define ROUTE_TILE_COUNT (REGION_WIDTH * REGION_HEIGHT)
+
+typedef enum {
+    WORLD_MAP_TILE = 0,
+    WORLD_MAP_LINE_HORIZONTAL = 1,
+    WORLD_MAP_LINE_VERTICAL = 2,
+    WORLD_MAP_PIXEL = 3
+} WORLD_MAP_OP_TYPE;
+
+/* a minimap drawing call made while the region was built. tiles keep their
+ * face fills, since turning those into colours touches the scene's
+ * textures, so the calls are only drawn on the main thread */
+typedef struct WorldMapOp {
+    int8_t type;
+
+    /* tile direction or line length */
+    int8_t size;
+
+    int16_t x;
+    int16_t y;
+    int colour;
+    int colour_2;
+} WorldMapOp;
+
+/* recent world_route results kept until object_adjacency changes. routes
+ * with more waypoints than ROUTE_CACHE_STEPS aren't kept */
+#define ROUTE_CACHE_SIZE 8
+#define ROUTE_CACHE_STEPS 32
+
+typedef struct WorldRoute {
+    int start_x;
+    int start_y;
+    int end_x1;
+    int end_y1;
+    int end_x2;
+    int end_y2;
+    int objects;
+
+    /* number of waypoints, or -1 if the end can't be reached */
+    int length;
+    int8_t route_x[ROUTE_CACHE_STEPS];
+    int8_t route_y[ROUTE_CACHE_STEPS];
+} WorldRoute;
+
+/* the tile arrays of one 48x48 map section on one plane, decoded from the
+ * .hei/.dat/.loc (or .jm) files */
+typedef struct WorldSection {
+    int x;
+    int y;
+    int plane;
+
+    WORLD_SECTION_STATE state;
+
+    /* when the section was last used, to pick which one to replace */
+    int stamp;
+
+    int8_t terrain_height[TILE_COUNT];
+    int8_t terrain_colour[TILE_COUNT];
+    int8_t walls_north_south[TILE_COUNT];
+    int8_t walls_east_west[TILE_COUNT];
+    uint16_t walls_diagonal[TILE_COUNT];
+    int8_t walls_roof[TILE_COUNT];
+    int8_t tile_decoration[TILE_COUNT];
+    int8_t tile_direction[TILE_COUNT];
+} WorldSection;
+
 extern int16_t terrain_colours[TERRAIN_COLOUR_COUNT];
 
 int rgb_to_texture_colour(int r, int g, int b);
@@ -76,6 +153,21 @@ struct World {
     GameModel *parent_model;
     int object_adjacency[REGION_WIDTH][REGION_HEIGHT];
     int route_via[REGION_WIDTH][REGION_HEIGHT];
+
+    /* tiles reached by world_route are stamped with route_generation rather
+     * than clearing route_via for every route */
+    uint16_t route_visited[REGION_WIDTH][REGION_HEIGHT];
+    int route_generation;
+
+    /* tiles joined by a step in either direction share a component, so ends
+     * in another one are rejected without searching */
+    uint16_t route_component[ROUTE_TILE_COUNT];
+    uint16_t route_stack[ROUTE_TILE_COUNT];
+    int8_t route_components_valid;
+
+    WorldRoute route_cache[ROUTE_CACHE_SIZE];
+    int route_cache_length;
+    int route_cache_next;
     int terrain_height_local[REGION_WIDTH][REGION_HEIGHT];
     uint16_t walls_diagonal[PLANE_COUNT][TILE_COUNT];
     GameModel *terrain_models[TERRAIN_COUNT];
@@ -100,6 +192,53 @@ struct World {
 #endif
 
     int8_t thick_walls;
+
+    /* decoded on the main thread when the cache is too small to hold it */
+    WorldSection loaded_section;
+
+    /* recently used sections, including the ones decoded ahead of time for
+     * the region the player is heading towards */
+    WorldSection *sections;
+    int section_count;
+    int section_stamp;
+
+    /* last position passed to world_prefetch and the direction of travel */
+    int prefetch_x;
+    int prefetch_y;
+    int prefetch_heading_x;
+    int prefetch_heading_y;
+
+    /* section of the region last loaded, which the next one neighbours */
+    int prefetch_section_x;
+    int prefetch_section_y;
+
+    /* a worker thread is decoding sections, so they have to be locked */
+    int8_t prefetching;
+
+    /* minimap drawing recorded by the last region built, for world_draw_map */
+    WorldMapOp *map_ops;
+    int map_op_count;
+    int map_op_length;
+
+    /* the region world_prefetch expects to be loaded next, built by the
+     * prefetch thread. it goes through the same states as a section, with
+     * DECODING while it's built */
+    World *prefetch_region;
+    WORLD_SECTION_STATE prefetch_region_state;
+    int prefetch_region_x;
+    int prefetch_region_y;
+    int prefetch_region_plane;
+
+    /* set on prefetch_region, which shares this world's sections without
+     * ever replacing one and lights its models off the main thread */
+    int8_t is_prefetch_region;
+    GameModelLightScratch light_scratch;
+
+#ifdef WORLD_PREFETCH_THREADED
+    SDL_mutex *prefetch_lock;
+    SDL_cond *prefetch_queued;
+    SDL_cond *prefetch_done;
+#endif
 };
 
 #if defined(RENDER_GL) || defined(RENDER_3DS_GL)
@@ -110,6 +249,10 @@ void world_gl_update_terrain_buffers(World *world);
 
 void world_new(World *world, Scene *scene, Surface *surface);
 void world_load_section(World *world, int x, int y, int plane);
+void world_set_section_cache(World *world, int size_kb);
+void world_set_prefetch(World *world, int enabled);
+void world_prefetch(World *world, int x, int y, int plane);
+int world_is_prefetched(World *world, int x, int y, int plane);
 int world_route(World *world, int start_x, int start_y, int end_x1, int end_y1,
                 int end_x2, int end_y2, int *route_x, int *route_y,
                 int objects);